@@ -1,12 +1,23 @@
 #include "AiAgent.h"
-#include <fstream>
 #include <sstream>
 #include <vector>
 #include <cstring>
 #include <iostream>
 #include <algorithm>
 #include <regex>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
 #include <curl/curl.h>
+#include "SessionArchive.h"
+#include "AnswerExtractor.h"
+#include "JsonWriter.h"
+#include "AnalysisReport.h"
+#include "WorkStealingPool.h"
+#include "LanguageDetector.h"
+#include "StructuredReport.h"
+#include "FileView.h"
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -23,6 +34,26 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::stri
     return total_size;
 }
 
+// Флаг отмены запросов текущего потока (RequestCancelScope)
+static thread_local const std::atomic<bool>* t_cancel = nullptr;
+
+RequestCancelScope::RequestCancelScope(const std::atomic<bool>* flag) : prev_(t_cancel) {
+    t_cancel = flag;
+}
+
+RequestCancelScope::~RequestCancelScope() {
+    t_cancel = prev_;
+}
+
+bool RequestCancelScope::cancelled() {
+    return t_cancel && t_cancel->load(std::memory_order_relaxed);
+}
+
+// curl зовет его и во время ожидания ответа; ненулевой результат обрывает запрос
+static int CancelCallback(void*, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    return RequestCancelScope::cancelled() ? 1 : 0;
+}
+
 // Конструктор и деструктор
 AiAgent::AiAgent() : db_(nullptr), context_enabled_(false) {
     char cwd[1024];
@@ -37,15 +68,7 @@ AiAgent::~AiAgent() {
 
 // --------- utils IO ----------
 bool AiAgent::readWholeFile(const std::string& path, std::string& out, std::string* err) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) { 
-        if (err) *err = "Cannot open file: " + path; 
-        return false; 
-    }
-    std::ostringstream ss; 
-    ss << f.rdbuf();
-    out = ss.str();
-    return true;
+    return FileView::readAll(path, out, err);
 }
 
 // --------- JSON loaders ----------
@@ -74,6 +97,36 @@ bool AiAgent::loadConfig(const std::string& path, std::string* err) {
             if (local.contains("model_path")) cfg_.local_model_path = local.at("model_path").get<std::string>();
         }
         
+        // Деление больших файлов на фрагменты
+        if (j.contains("chunking")) {
+            auto chunking = j["chunking"];
+            if (chunking.contains("max_chars")) cfg_.chunk_max_chars = chunking.at("max_chars").get<size_t>();
+            if (chunking.contains("overlap_lines")) cfg_.chunk_overlap_lines = chunking.at("overlap_lines").get<size_t>();
+            if (chunking.contains("jobs")) cfg_.chunk_jobs = std::max(1u, chunking.at("jobs").get<unsigned>());
+        }
+
+        if (j.contains("structured_output")) {
+            cfg_.structured_output = j.at("structured_output").get<std::string>();
+            if (cfg_.structured_output != "json_schema" && cfg_.structured_output != "grammar" &&
+                cfg_.structured_output != "off") {
+                if (err) *err = "structured_output: json_schema, grammar или off";
+                return false;
+            }
+        }
+
+        // Локальный проход перед запросом к модели
+        if (j.contains("prepass")) {
+            auto prepass = j["prepass"];
+            PrepassRules& rules = cfg_.prepass;
+            if (prepass.contains("enabled")) rules.enabled = prepass.at("enabled").get<bool>();
+            if (prepass.contains("min_code_lines")) rules.min_code_lines = prepass.at("min_code_lines").get<size_t>();
+            if (prepass.contains("skip_generated")) rules.skip_generated = prepass.at("skip_generated").get<bool>();
+            if (prepass.contains("skip_include_only")) rules.skip_include_only = prepass.at("skip_include_only").get<bool>();
+            if (prepass.contains("skip_globs")) rules.skip_globs = prepass.at("skip_globs").get<std::vector<std::string>>();
+            if (prepass.contains("low_priority_complexity")) rules.low_priority_complexity = prepass.at("low_priority_complexity").get<int>();
+            if (prepass.contains("low_priority_lines")) rules.low_priority_lines = prepass.at("low_priority_lines").get<size_t>();
+        }
+        
         return true;
     } catch (const std::exception& e) {
         if (err) *err = std::string("Config parse error: ") + e.what();
@@ -101,77 +154,115 @@ bool AiAgent::loadPrompt(const std::string& path, std::string* err) {
     }
 }
 
-// Определение языка программирования
-std::string AiAgent::detectLanguage(const std::string& code) const {
-    std::string lower_code = code;
-    std::transform(lower_code.begin(), lower_code.end(), lower_code.begin(), ::tolower);
-    
-    // Эвристики для C++
-    if (lower_code.find("#include") != std::string::npos ||
-        lower_code.find("using namespace") != std::string::npos ||
-        lower_code.find("std::") != std::string::npos ||
-        lower_code.find("int main()") != std::string::npos ||
-        lower_code.find("cout") != std::string::npos ||
-        lower_code.find("cin") != std::string::npos) {
-        return "cpp";
+// Определение языка программирования (LanguageDetector.h)
+std::string AiAgent::detectLanguage(std::string_view code) const {
+    return detectSourceLanguage(code).language;
+}
+
+// Формат ответа — общий для файла целиком и для фрагмента
+static void appendAnswerFormat(std::ostringstream& prompt, bool structured) {
+    if (structured) {
+        prompt << structuredFormatHint();
+        return;
     }
+    prompt << "ФОРМАТ ОТВЕТА (СТРОГО СОБЛЮДАЙ):\n\n";
+    prompt << "=== ОШИБКИ ===\n";
+    prompt << "1. [Тип ошибки] [Строка]: Описание\n";
+    prompt << "2. ...\n\n";
     
-    // Эвристики для Python
-    if (lower_code.find("def ") != std::string::npos ||
-        lower_code.find("import ") != std::string::npos ||
-        lower_code.find("from ") != std::string::npos ||
-        lower_code.find("print(") != std::string::npos ||
-        (lower_code.find("class ") != std::string::npos && 
-         lower_code.find(":") != std::string::npos) ||
-        lower_code.find("__init__") != std::string::npos) {
-        return "python";
-    }
+    prompt << "=== РЕКОМЕНДАЦИИ ===\n";
+    prompt << "1. [Категория]: Рекомендация\n";
+    prompt << "2. ...\n\n";
     
-    return "auto";
+    prompt << "=== ОБЩАЯ ОЦЕНКА ===\n";
+    prompt << "[Краткая оценка качества кода, 1-2 предложения]\n\n";
 }
 
 // Построение промпта для анализа
-std::string AiAgent::buildAnalysisPrompt(const std::string& code, 
+std::string AiAgent::buildAnalysisPrompt(std::string_view code, 
                                         const std::string& language,
                                         bool is_complete_code) const {
     std::ostringstream prompt;
     
     prompt << "Ты - опытный программист-аналитик. Проанализируй код и выдай результат в ЧЕТКОМ ФОРМАТЕ:\n\n";
     
-    std::string lang = language;
-    if (lang == "auto") {
-        lang = detectLanguage(code);
-    }
+    const std::string lang = resolveLanguage(code, language);
     
-    prompt << "ЯЗЫК: " << (lang == "cpp" ? "C++" : "Python") << "\n\n";
+    prompt << "ЯЗЫК: " << languageDisplayName(lang) << "\n\n";
     
     if (is_complete_code) {
         prompt << "ВНИМАНИЕ: Анализируй код как ЕДИНОЕ ЦЕЛОЕ, не комментируй каждую строку отдельно.\n\n";
     }
     
-    prompt << "ФОРМАТ ОТВЕТА (СТРОГО СОБЛЮДАЙ):\n\n";
-    prompt << "=== ОШИБКИ ===\n";
-    prompt << "1. [Тип ошибки] [Строка]: Описание\n";
-    prompt << "2. ...\n\n";
+    appendAnswerFormat(prompt, structuredOutput());
     
-    prompt << "=== РЕКОМЕНДАЦИИ ===\n";
-    prompt << "1. [Категория]: Рекомендация\n";
-    prompt << "2. ...\n\n";
+    prompt << "КОД ДЛЯ АНАЛИЗА:\n```" << lang << "\n";
     
-    prompt << "=== ОБЩАЯ ОЦЕНКА ===\n";
-    prompt << "[Краткая оценка качества кода, 1-2 предложения]\n\n";
+    // Код дописывается в строку заранее известного размера: через поток он
+    // копировался бы дважды (в буфер потока и в str())
+    const char* tail = "\n```\n\nВАЖНО: Отвечай ТОЛЬКО в указанном формате, без лишних объяснений и без комментариев к каждой строке.";
+    std::string out = std::move(prompt).str();
+    out.reserve(out.size() + code.size() + std::strlen(tail));
+    out += code;
+    out += tail;
+    return out;
+}
+
+// Промпт для фрагмента большого файла: строки пронумерованы номерами
+// исходного файла, чтобы ответы по фрагментам можно было склеить
+std::string AiAgent::buildChunkPrompt(std::string_view code,
+                                      const SourceChunk& chunk,
+                                      size_t total_lines,
+                                      const std::string& language,
+                                      const std::vector<LineSpan>* changed) const {
+    std::ostringstream prompt;
     
-    prompt << "КОД ДЛЯ АНАЛИЗА:\n```" << lang << "\n" << code << "\n```\n\n";
+    prompt << "Ты - опытный программист-аналитик. Проанализируй фрагмент файла и выдай результат в ЧЕТКОМ ФОРМАТЕ:\n\n";
+    prompt << "ЯЗЫК: " << languageDisplayName(language) << "\n\n";
+    prompt << "ФРАГМЕНТ: строки " << chunk.first_line << "-" << chunk.last_line
+           << " из " << total_lines << ". В начале каждой строки стоит ее номер в файле (\"  12| \"), "
+           << "в поле [Строка] указывай именно его.";
+    if (chunk.own_first > chunk.first_line) {
+        prompt << " Строки " << chunk.first_line << "-" << (chunk.own_first - 1)
+               << " даны только для контекста, замечания к ним не пиши.";
+    }
+    if (changed) {
+        prompt << " Остальная часть файла не изменялась: не считай ошибкой то, что объявлено вне фрагмента.\n\n";
+        prompt << "ИЗМЕНЕНЫ СТРОКИ:";
+        for (const LineSpan& span : *changed) {
+            if (span.last < span.first) prompt << " удаление после " << span.first << ";";
+            else if (span.last == span.first) prompt << " " << span.first << ";";
+            else prompt << " " << span.first << "-" << span.last << ";";
+        }
+        prompt << " Проверь прежде всего их; к неизмененным строкам пиши замечания, только если изменение их ломает.\n\n";
+    } else {
+        prompt << " Остальная часть файла проверяется отдельно: не считай ошибкой то, что объявлено вне фрагмента.\n\n";
+    }
+    
+    appendAnswerFormat(prompt, structuredOutput());
+    
+    prompt << "КОД ДЛЯ АНАЛИЗА:\n```" << language << "\n" << numberLines(code, chunk) << "```\n\n";
     prompt << "ВАЖНО: Отвечай ТОЛЬКО в указанном формате, без лишних объяснений и без комментариев к каждой строке.";
     
     return prompt.str();
 }
 
+// Глобальная инициализация OpenSSL и curl — один раз на процесс:
+// запросы идут из нескольких потоков (analyze-dir)
+static void initNetworkOnce() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        SSL_library_init();
+        SSL_load_error_strings();
+        OpenSSL_add_all_algorithms();
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        std::atexit(curl_global_cleanup);
+    });
+}
+
 // -------- Низкоуровневый HTTPS POST на /api/generate --------
-std::optional<std::string> AiAgent::httpsPostGenerate(const std::string& jsonBody, std::string* err) {
-    SSL_library_init();
-    SSL_load_error_strings();
-    OpenSSL_add_all_algorithms();
+std::optional<std::string> AiAgent::httpsPostGenerate(const std::string& jsonBody, std::string* err) const {
+    initNetworkOnce();
 
     SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
     if (!ctx) { 
@@ -216,18 +307,19 @@ std::optional<std::string> AiAgent::httpsPostGenerate(const std::string& jsonBod
         return std::nullopt;
     }
 
-    // HTTP запрос
+    // HTTP запрос: заголовки и тело уходят отдельными SSL_write,
+    // чтобы не склеивать (и не копировать) большое тело с заголовками
     std::ostringstream req;
     req << "POST /api/generate HTTP/1.1\r\n"
         << "Host: " << cfg_.host << "\r\n"
         << "Content-Type: application/json\r\n"
         << "Connection: close\r\n";
     if (!cfg_.api_key.empty()) req << "x-api-key: " << cfg_.api_key << "\r\n";
-    req << "Content-Length: " << jsonBody.size() << "\r\n\r\n"
-        << jsonBody;
+    req << "Content-Length: " << jsonBody.size() << "\r\n\r\n";
 
-    const std::string request_str = req.str();
-    if (SSL_write(ssl, request_str.c_str(), (int)request_str.size()) <= 0) {
+    const std::string request_head = req.str();
+    if (SSL_write(ssl, request_head.data(), (int)request_head.size()) <= 0 ||
+        (!jsonBody.empty() && SSL_write(ssl, jsonBody.data(), (int)jsonBody.size()) <= 0)) {
         if (err) *err = "SSL_write failed";
         SSL_free(ssl); 
         close(sock); 
@@ -235,40 +327,54 @@ std::optional<std::string> AiAgent::httpsPostGenerate(const std::string& jsonBod
         return std::nullopt;
     }
 
+    // Если запрос можно отменить, чтение просыпается раз в 200 мс и проверяет флаг
+    if (t_cancel) {
+        timeval tv{0, 200 * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
     char buf[4096];
     std::string response;
     int bytes;
-    while ((bytes = SSL_read(ssl, buf, sizeof(buf)-1)) > 0) {
-        buf[bytes] = '\0';
-        response += buf;
+    bool cancelled = false;
+    for (;;) {
+        bytes = SSL_read(ssl, buf, sizeof(buf)-1);
+        if (bytes > 0) {
+            buf[bytes] = '\0';
+            response += buf;
+            continue;
+        }
+        if (t_cancel && SSL_get_error(ssl, bytes) == SSL_ERROR_WANT_READ) {
+            if (!(cancelled = RequestCancelScope::cancelled())) continue;
+        }
+        break;
     }
 
     SSL_free(ssl);
     close(sock);
     SSL_CTX_free(ctx);
+    if (cancelled) {
+        if (err) *err = "запрос отменен";
+        return std::nullopt;
+    }
 
-    // Извлечение текста из JSON ответа
-    auto p = response.find("\r\n\r\n");
-    std::string json_part = (p != std::string::npos) ? response.substr(p + 4) : response;
-
-    try {
-        auto j = json::parse(json_part);
-        if (j.contains("text")) {
-            return j["text"].get<std::string>();
-        }
-    } catch (...) {}
+    // Извлечение текста из JSON ответа (заголовки отрезаем без копирования тела)
+    std::string_view json_part = response;
+    auto p = json_part.find("\r\n\r\n");
+    if (p != std::string_view::npos) json_part.remove_prefix(p + 4);
 
-    if (err) *err = "Cannot extract text from JSON response";
-    return std::nullopt;
+    std::string text;
+    if (!extractAnswer(json_part, text, err)) return std::nullopt;
+    return text;
 }
 
 // Запрос к локальной LLM через libcurl
-std::optional<std::string> AiAgent::sendLocalRequest(const std::string& prompt, std::string* err) {
+std::optional<std::string> AiAgent::sendLocalRequest(const std::string& prompt, std::string* err,
+                                                     bool constrained) const {
     CURL* curl;
     CURLcode res;
     std::string response;
     
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    initNetworkOnce();
     curl = curl_easy_init();
     
     if(!curl) {
@@ -280,20 +386,39 @@ std::optional<std::string> AiAgent::sendLocalRequest(const std::string& prompt,
     std::string url = "http://" + cfg_.local_host + ":" + 
                      std::to_string(cfg_.local_port) + "/v1/chat/completions";
     
-    // Формируем JSON-запрос в формате OpenAI API
-    json payload = {
-        {"model", cfg_.local_model_path.empty() ? "local-model" : cfg_.local_model_path},
-        {"messages", {
-            {{"role", "system"}, {"content", "You are a helpful coding assistant that analyzes code."}},
-            {{"role", "user"}, {"content", prompt}}
-        }},
-        {"max_tokens", 800},
-        {"temperature", 0.2},
-        {"top_p", 0.9},
-        {"stream", false}
-    };
-    
-    std::string jsonBody = payload.dump();
+    // Формируем JSON-запрос в формате OpenAI API. Промпт с исходником
+    // экранируется прямо в буфер, без json-дерева и лишних копий
+    thread_local std::string jsonBody;
+    json_writer::Writer w(jsonBody, prompt.size() + 512);
+    w.beginObject()
+        .field("model", cfg_.local_model_path.empty() ? std::string_view("local-model") : cfg_.local_model_path)
+        .beginArray("messages")
+            .beginObject()
+                .field("role", "system")
+                .field("content", "You are a helpful coding assistant that analyzes code.")
+            .endObject()
+            .beginObject()
+                .field("role", "user")
+                .field("content", prompt)
+            .endObject()
+        .endArray()
+        .field("max_tokens", 800)
+        .field("temperature", 0.2)
+        .field("top_p", 0.9)
+        .field("stream", false);
+    // Ограничение декодирования: модель не может выдать ответ не по схеме
+    if (constrained && cfg_.structured_output == "grammar") {
+        w.field("grammar", analysisGrammar());
+    } else if (constrained) {
+        w.beginObject("response_format")
+            .field("type", "json_schema")
+            .beginObject("json_schema")
+                .field("name", "code_analysis")
+                .rawField("schema", analysisJsonSchema())
+            .endObject()
+        .endObject();
+    }
+    w.endObject();
     
     // Настраиваем curl
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
@@ -309,6 +434,11 @@ std::optional<std::string> AiAgent::sendLocalRequest(const std::string& prompt,
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
     curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);  // таймауты без сигналов — безопасно в потоках
+    if (t_cancel) {
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelCallback);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    }
     
     // Выполняем запрос
     res = curl_easy_perform(curl);
@@ -316,8 +446,11 @@ std::optional<std::string> AiAgent::sendLocalRequest(const std::string& prompt,
     // Очистка
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
-    curl_global_cleanup();
     
+    if (res == CURLE_ABORTED_BY_CALLBACK) {
+        if (err) *err = "запрос отменен";
+        return std::nullopt;
+    }
     if(res != CURLE_OK) {
         if (err) *err = std::string("curl_easy_perform() failed: ") + 
                        curl_easy_strerror(res) + 
@@ -325,59 +458,122 @@ std::optional<std::string> AiAgent::sendLocalRequest(const std::string& prompt,
         return std::nullopt;
     }
     
-    // Парсим JSON ответ
-    try {
-        auto j = json::parse(response);
-        
-        // Проверяем наличие ошибки
-        if (j.contains("error")) {
-            if (err) *err = "Server error: " + j["error"].dump();
-            return std::nullopt;
-        }
-        
-        // Извлекаем текст ответа
-        if (j.contains("choices") && j["choices"].is_array() && 
-            !j["choices"].empty()) {
-            auto choice = j["choices"][0];
-            if (choice.contains("message") && 
-                choice["message"].contains("content")) {
-                return choice["message"]["content"].get<std::string>();
-            }
-        }
-        
-        // Альтернативный формат ответа (если сервер возвращает другой формат)
-        if (j.contains("text")) {
-            return j["text"].get<std::string>();
-        }
-        
-        if (err) *err = "Unexpected response format. Expected 'choices[0].message.content' or 'text' field.";
-        return std::nullopt;
-        
-    } catch (const std::exception& e) {
-        if (err) *err = std::string("JSON parse error: ") + e.what();
-        return std::nullopt;
-    }
+    // choices[0].message.content (или text) одним проходом, без дерева JSON
+    std::string content;
+    if (!extractAnswer(response, content, err)) return std::nullopt;
+    return content;
 }
 
-// Основной метод отправки запроса
-std::optional<std::string> AiAgent::sendRequest(const std::string& prompt, std::string* err) {
+// Сообщение о выбранном источнике модели
+void AiAgent::printBackend() const {
     if (cfg_.inference_source == "local") {
         std::cout << "Использую локальную модель..." << std::endl;
         std::cout << "URL: http://" << cfg_.local_host << ":" << cfg_.local_port << "/v1/chat/completions" << std::endl;
-        return sendLocalRequest(prompt, err);
     } else {
         std::cout << "Использую удаленный API..." << std::endl;
-        json payload = {{"prompt", prompt}};
-        std::string body = payload.dump();
-        return httpsPostGenerate(body, err);
     }
 }
 
+// Отправка без вывода в консоль; не меняет агента, можно звать из разных потоков
+std::optional<std::string> AiAgent::postPrompt(const std::string& prompt, std::string* err,
+                                               bool constrained) const {
+    if (RequestCancelScope::cancelled()) {
+        if (err) *err = "запрос отменен";
+        return std::nullopt;
+    }
+    if (cfg_.inference_source == "local") {
+        return sendLocalRequest(prompt, err, constrained);
+    }
+    thread_local std::string body;
+    json_writer::Writer w(body, prompt.size() + 32);
+    w.beginObject().field("prompt", prompt).endObject();
+    return httpsPostGenerate(body, err);
+}
+
+std::optional<std::string> AiAgent::postAnalysisPrompt(const std::string& prompt, std::string* err) const {
+    if (!structuredOutput()) return postPrompt(prompt, err);
+    auto raw = postPrompt(prompt, err, true);
+    if (!raw) return raw;
+
+    AnalysisReport report;
+    std::string parse_err;
+    if (parseStructuredReport(extractJsonObject(*raw), report, &parse_err)) {
+        return formatAnalysisReport(report);
+    }
+    // Удаленный API (или сервер без поддержки схем) ответил не по схеме:
+    // одна попытка исправить формат, код повторно не отправляется
+    std::string repair_err;
+    if (auto fixed = postPrompt(buildRepairPrompt(*raw, parse_err), &repair_err, true)) {
+        if (parseStructuredReport(extractJsonObject(*fixed), report)) return formatAnalysisReport(report);
+    }
+    // Модель могла ответить и прежним текстовым форматом
+    if (parseAnalysisReport(*raw, report)) return formatAnalysisReport(report);
+    return raw;
+}
+
 //МЕТОДЫ ДЛЯ РАБОТЫ С БАЗОЙ ДАННЫХ
 
+namespace {
+// Размер словаря и сколько последних ответов брать для обучения
+constexpr size_t kDictSize = 16 * 1024;
+constexpr int kDictSamples = 1000;
+const char* kResponsesTable = "saved_responses";
+
+int64_t queryInt(sqlite3* db, const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    int64_t value = 0;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+std::string columnBytes(sqlite3_stmt* stmt, int col) {
+    const void* data = sqlite3_column_blob(stmt, col);
+    const int size = sqlite3_column_bytes(stmt, col);
+    return data ? std::string(static_cast<const char*>(data), size) : std::string();
+}
+
+// decoded_text(codec, response) — текст ответа для фильтров в SQL
+void decodedTextFunc(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    const Codec codec = static_cast<Codec>(sqlite3_value_int(argv[0]));
+    if (codec == Codec::Plain) {
+        sqlite3_result_value(ctx, argv[1]);
+        return;
+    }
+
+    const auto* impl = static_cast<const ContentCodec*>(sqlite3_user_data(ctx));
+    const char* data = static_cast<const char*>(sqlite3_value_blob(argv[1]));
+    std::string out, err;
+    if (!impl->decode(codec, std::string_view(data ? data : "", sqlite3_value_bytes(argv[1])), out, &err)) {
+        sqlite3_result_error(ctx, err.c_str(), -1);
+        return;
+    }
+    sqlite3_result_text(ctx, out.data(), (int)out.size(), SQLITE_TRANSIENT);
+}
+}
+
+const std::string& SavedResponse::text() const {
+    if (codec == Codec::Plain) return stored;
+    if (!decoded_) {
+        std::string out, err;
+        if (!codec_impl || !codec_impl->decode(codec, stored, out, &err)) {
+            out = "[не удалось распаковать ответ: " + (codec_impl ? err : std::string("нет кодека")) + "]";
+        }
+        decoded_ = std::move(out);
+    }
+    return *decoded_;
+}
+
 bool AiAgent::initResponseDatabase() {
+    if (db_) return true;
+
     if (sqlite3_open(db_path_.c_str(), &db_) != SQLITE_OK) {
         std::cerr << "Не удалось открыть базу данных: " << sqlite3_errmsg(db_) << std::endl;
+        sqlite3_close(db_);
+        db_ = nullptr;
         return false;
     }
     
@@ -386,18 +582,162 @@ bool AiAgent::initResponseDatabase() {
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "response TEXT NOT NULL,"
         "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP"
-        ");";
+        ");"
+        "CREATE TABLE IF NOT EXISTS codec_dicts ("
+        "table_name TEXT NOT NULL,"
+        "dict_id INTEGER NOT NULL,"
+        "dict BLOB NOT NULL,"
+        "created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+        "PRIMARY KEY (table_name, dict_id)"
+        ");"
+        "CREATE INDEX IF NOT EXISTS idx_saved_timestamp ON saved_responses(timestamp);";
     
     char* err_msg = nullptr;
     if (sqlite3_exec(db_, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
         std::cerr << "Ошибка SQL: " << err_msg << std::endl;
         sqlite3_free(err_msg);
+        closeDatabase();
         return false;
     }
-    
+
+    if (!migrateResponseDatabase() || !loadDictionaries()) {
+        closeDatabase();
+        return false;
+    }
+
+    sqlite3_create_function_v2(db_, "decoded_text", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                               codec_.get(), decodedTextFunc, nullptr, nullptr, nullptr);
+    row_count_ = queryInt(db_, "SELECT COUNT(*) FROM saved_responses;");
     return true;
 }
 
+// Версия 2: колонки codec (способ хранения) и raw_len (исходный размер в байтах)
+bool AiAgent::migrateResponseDatabase() {
+    if (queryInt(db_, "PRAGMA user_version;") >= 2) return true;
+
+    const char* sql =
+        "BEGIN;"
+        "ALTER TABLE saved_responses ADD COLUMN codec INTEGER NOT NULL DEFAULT 0;"
+        "ALTER TABLE saved_responses ADD COLUMN raw_len INTEGER;"
+        "UPDATE saved_responses SET raw_len = length(CAST(response AS BLOB));"
+        "PRAGMA user_version = 2;"
+        "COMMIT;";
+
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db_, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::cerr << "Ошибка миграции базы ответов: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+bool AiAgent::loadDictionaries() {
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "SELECT dict FROM codec_dicts WHERE table_name = ? ORDER BY created_at, rowid;";
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Ошибка подготовки SQL: " << sqlite3_errmsg(db_) << std::endl;
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, kResponsesTable, -1, SQLITE_STATIC);
+
+    // Последний загруженный словарь становится словарём для записи
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string err;
+        if (!codec_->addDictionary(columnBytes(stmt, 0), &err)) {
+            std::cerr << "Словарь сжатия пропущен: " << err << std::endl;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+// Когда ответов набралось достаточно, обучаем словарь на последних из них,
+// сохраняем его в codec_dicts и пережимаем им уже сохранённые строки
+void AiAgent::trainDictionaryIfNeeded() {
+    if (!ContentCodec::available() || codec_->hasDictionary() || row_count_ < train_threshold_) return;
+
+    std::vector<std::string> samples;
+    sqlite3_stmt* stmt = nullptr;
+    const char* select_sql = "SELECT id, codec, response FROM saved_responses ORDER BY id DESC LIMIT ?;";
+    if (sqlite3_prepare_v2(db_, select_sql, -1, &stmt, nullptr) != SQLITE_OK) return;
+    sqlite3_bind_int(stmt, 1, kDictSamples);
+
+    std::vector<std::pair<int64_t, std::string>> rows;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string text;
+        if (codec_->decode(static_cast<Codec>(sqlite3_column_int(stmt, 1)), columnBytes(stmt, 2), text)) {
+            rows.emplace_back(sqlite3_column_int64(stmt, 0), text);
+            samples.push_back(std::move(text));
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    std::string err;
+    auto dict = ContentCodec::trainDictionary(samples, kDictSize, &err);
+    const uint32_t dict_id = dict ? ContentCodec::dictionaryId(*dict) : 0;
+    if (!dict_id) {
+        // Образцов мало или они слишком однообразны — попробуем позже
+        train_threshold_ *= 2;
+        return;
+    }
+
+    // Словарь сохраняется до того, как им начнут сжимать,
+    // иначе после перезапуска новые ответы будет нечем распаковать
+    bool saved = false;
+    const char* insert_sql = "INSERT OR REPLACE INTO codec_dicts (table_name, dict_id, dict) VALUES (?, ?, ?);";
+    if (sqlite3_prepare_v2(db_, insert_sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, kResponsesTable, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, dict_id);
+        sqlite3_bind_blob(stmt, 3, dict->data(), (int)dict->size(), SQLITE_STATIC);
+        saved = (sqlite3_step(stmt) == SQLITE_DONE);
+    }
+    sqlite3_finalize(stmt);
+    if (!saved || !codec_->addDictionary(*dict, &err)) {
+        std::cerr << "Словарь сжатия не сохранен: "
+                  << (saved ? err : std::string(sqlite3_errmsg(db_))) << std::endl;
+        train_threshold_ *= 2;
+        return;
+    }
+
+    // Пережатие последних ответов словарем — одна транзакция; при первой
+    // ошибке откат: строки остаются в прежнем сжатии и читаются как раньше,
+    // а словарь уже сохранен и сжимает новые ответы
+    bool ok = sqlite3_exec(db_, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    bool in_transaction = ok;
+    stmt = nullptr;
+    const char* update_sql = "UPDATE saved_responses SET codec = ?, response = ? WHERE id = ?;";
+    ok = ok && sqlite3_prepare_v2(db_, update_sql, -1, &stmt, nullptr) == SQLITE_OK;
+    for (size_t i = 0; ok && i < rows.size(); ++i) {
+        std::string packed;
+        const Codec codec = codec_->encode(rows[i].second, packed);
+        sqlite3_bind_int(stmt, 1, static_cast<int>(codec));
+        if (codec == Codec::Plain) {
+            sqlite3_bind_text(stmt, 2, packed.data(), (int)packed.size(), SQLITE_STATIC);
+        } else {
+            sqlite3_bind_blob(stmt, 2, packed.data(), (int)packed.size(), SQLITE_STATIC);
+        }
+        sqlite3_bind_int64(stmt, 3, rows[i].first);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (ok) {
+        ok = sqlite3_exec(db_, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        in_transaction = !ok;
+    }
+    if (!ok) {
+        // errmsg — до ROLLBACK, иначе он его перезапишет
+        std::cerr << "✗ Ответы не пережаты словарем: " << sqlite3_errmsg(db_) << std::endl;
+        if (in_transaction) sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return;
+    }
+
+    std::cout << "✓ Обучен словарь сжатия (" << dict->size() << " байт, "
+              << samples.size() << " образцов)" << std::endl;
+}
+
 void AiAgent::closeDatabase() {
     if (db_) {
         sqlite3_close(db_);
@@ -411,21 +751,32 @@ bool AiAgent::saveResponse(const std::string& response) {
         return false;
     }
     
-    const char* sql = "INSERT INTO saved_responses (response) VALUES (?);";
+    const char* sql = "INSERT INTO saved_responses (response, codec, raw_len) VALUES (?, ?, ?);";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         std::cerr << "Ошибка подготовки SQL: " << sqlite3_errmsg(db_) << std::endl;
         return false;
     }
-    
-    sqlite3_bind_text(stmt, 1, response.c_str(), -1, SQLITE_STATIC);
+
+    // Сжатые ответы хранятся как BLOB, короткие и несжимаемые — как TEXT
+    std::string packed;
+    const Codec codec = codec_->encode(response, packed);
+    if (codec == Codec::Plain) {
+        sqlite3_bind_text(stmt, 1, packed.data(), (int)packed.size(), SQLITE_STATIC);
+    } else {
+        sqlite3_bind_blob(stmt, 1, packed.data(), (int)packed.size(), SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, 2, static_cast<int>(codec));
+    sqlite3_bind_int64(stmt, 3, (sqlite3_int64)response.size());
     
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
     
     if (success) {
+        ++row_count_;
         std::cout << "✓ Ответ сохранен" << std::endl;
+        trainDictionaryIfNeeded();
     } else {
         std::cerr << "✗ Ошибка сохранения ответа: " << sqlite3_errmsg(db_) << std::endl;
     }
@@ -450,35 +801,139 @@ bool AiAgent::disableContext() {
     return true;
 }
 
-std::vector<SavedResponse> AiAgent::getSavedResponses() const {
-    std::vector<SavedResponse> responses;
-    
-    if (!db_) return responses;
-    
-    const char* sql = "SELECT response, timestamp FROM saved_responses ORDER BY timestamp DESC LIMIT 10;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return responses;
+SavedResponseCursor::SavedResponseCursor(sqlite3* db, std::shared_ptr<const ContentCodec> codec,
+                                         SavedQuery query)
+    : codec_(std::move(codec)), query_(std::move(query)) {
+    if (query_.page_size <= 0) query_.page_size = 100;
+    if (query_.oldest_first) last_id_ = 0;
+
+    // Условия добавляются только заданные, чтобы индексы по id и timestamp
+    // оставались применимы; текст фильтруется уже распакованным
+    std::string sql = "SELECT id, codec, response, timestamp FROM saved_responses WHERE id ";
+    sql += query_.oldest_first ? "> :last_id" : "< :last_id";
+    if (!query_.since.empty()) sql += " AND timestamp >= :since";
+    if (!query_.until.empty()) sql += " AND timestamp < :until";
+    if (!query_.keyword.empty()) sql += " AND instr(decoded_text(codec, response), :keyword) > 0";
+    sql += query_.oldest_first ? " ORDER BY id" : " ORDER BY id DESC";
+    sql += " LIMIT :limit OFFSET :offset;";
+
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt_, nullptr) != SQLITE_OK) {
+        error_ = std::string("Ошибка подготовки SQL: ") + sqlite3_errmsg(db);
+        sqlite3_finalize(stmt_);
+        stmt_ = nullptr;
+        exhausted_ = true;
+        return;
     }
-    
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+
+    auto bindText = [this](const char* name, const std::string& value) {
+        const int idx = sqlite3_bind_parameter_index(stmt_, name);
+        if (idx) sqlite3_bind_text(stmt_, idx, value.c_str(), (int)value.size(), SQLITE_TRANSIENT);
+    };
+    bindText(":since", query_.since);
+    bindText(":until", query_.until);
+    bindText(":keyword", query_.keyword);
+}
+
+SavedResponseCursor::~SavedResponseCursor() {
+    sqlite3_finalize(stmt_);
+}
+
+SavedResponseCursor::SavedResponseCursor(SavedResponseCursor&& other) noexcept {
+    *this = std::move(other);
+}
+
+SavedResponseCursor& SavedResponseCursor::operator=(SavedResponseCursor&& other) noexcept {
+    if (this != &other) {
+        sqlite3_finalize(stmt_);
+        stmt_ = other.stmt_;
+        other.stmt_ = nullptr;
+        codec_ = std::move(other.codec_);
+        query_ = std::move(other.query_);
+        page_ = std::move(other.page_);
+        page_pos_ = other.page_pos_;
+        last_id_ = other.last_id_;
+        delivered_ = other.delivered_;
+        first_page_ = other.first_page_;
+        exhausted_ = other.exhausted_;
+        error_ = std::move(other.error_);
+    }
+    return *this;
+}
+
+bool SavedResponseCursor::fetchPage() {
+    page_.clear();
+    page_pos_ = 0;
+    if (exhausted_ || !stmt_) return false;
+
+    int64_t page_limit = query_.page_size;
+    if (query_.limit >= 0) page_limit = std::min(page_limit, query_.limit - delivered_);
+    if (page_limit <= 0) {
+        exhausted_ = true;
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt_, sqlite3_bind_parameter_index(stmt_, ":last_id"), last_id_);
+    sqlite3_bind_int64(stmt_, sqlite3_bind_parameter_index(stmt_, ":limit"), page_limit);
+    // offset пропускается один раз, дальше страницы продолжаются по id
+    sqlite3_bind_int64(stmt_, sqlite3_bind_parameter_index(stmt_, ":offset"),
+                       first_page_ ? std::max<int64_t>(query_.offset, 0) : 0);
+    first_page_ = false;
+
+    int rc;
+    while ((rc = sqlite3_step(stmt_)) == SQLITE_ROW) {
         SavedResponse resp;
-        const char* response_text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        const char* timestamp_text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        
-        if (response_text) resp.response = response_text;
+        resp.id = sqlite3_column_int64(stmt_, 0);
+        resp.codec = static_cast<Codec>(sqlite3_column_int(stmt_, 1));
+        resp.stored = columnBytes(stmt_, 2);
+        resp.codec_impl = codec_;
+        const char* timestamp_text = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, 3));
         if (timestamp_text) resp.timestamp = timestamp_text;
-        
-        responses.push_back(resp);
+        page_.push_back(std::move(resp));
+    }
+    if (rc != SQLITE_DONE) {
+        error_ = std::string("Ошибка чтения ответов: ") + sqlite3_errmsg(sqlite3_db_handle(stmt_));
+        page_.clear();
+    }
+    // reset снимает блокировку чтения до следующей страницы
+    sqlite3_reset(stmt_);
+
+    if ((int64_t)page_.size() < page_limit) exhausted_ = true;
+    if (!page_.empty()) last_id_ = page_.back().id;
+    return !page_.empty();
+}
+
+bool SavedResponseCursor::next(SavedResponse& out) {
+    if (page_pos_ >= page_.size() && !fetchPage()) return false;
+    out = std::move(page_[page_pos_++]);
+    ++delivered_;
+    return true;
+}
+
+SavedResponseCursor AiAgent::querySavedResponses(const SavedQuery& query, std::string* err) {
+    if (!db_ && !initResponseDatabase()) {
+        if (err) *err = "Не удалось открыть базу ответов";
+        return {};
+    }
+    SavedResponseCursor cursor(db_, codec_, query);
+    if (err && !cursor.error().empty()) *err = cursor.error();
+    return cursor;
+}
+
+std::vector<SavedResponse> AiAgent::getSavedResponses() {
+    std::vector<SavedResponse> responses;
+
+    SavedQuery query;
+    query.limit = 10;
+    auto cursor = querySavedResponses(query);
+    SavedResponse resp;
+    while (cursor.next(resp)) {
+        responses.push_back(std::move(resp));
     }
-    
-    sqlite3_finalize(stmt);
     return responses;
 }
 
 bool AiAgent::clearSavedResponses() {
-    if (!db_) return false;
+    if (!db_ && !initResponseDatabase()) return false;
     
     const char* sql = "DELETE FROM saved_responses;";
     char* err_msg = nullptr;
@@ -491,28 +946,189 @@ bool AiAgent::clearSavedResponses() {
     }
     
     if (success) {
+        row_count_ = 0;
         std::cout << "✓ Сохраненные ответы очищены" << std::endl;
     }
     
     return success;
 }
 
+bool AiAgent::exportResponses(const std::string& path, const SavedQuery& query, std::string* err) {
+    // От старых к новым: при импорте id снова пойдут по времени
+    SavedQuery ordered = query;
+    ordered.oldest_first = true;
+    auto cursor = querySavedResponses(ordered, err);
+    if (!cursor.error().empty()) return false;
+
+    const auto started = std::chrono::steady_clock::now();
+    session_archive::Writer writer;
+    if (!writer.open(path, {{"kind", "saved_responses"}}, err)) return false;
+
+    // В файл идет исходный текст: словари сжатия на другой машине свои
+    SavedResponse resp;
+    bool ok = true;
+    while (ok && cursor.next(resp)) {
+        ok = writer.add({{"timestamp", resp.timestamp}, {"text", resp.text()}}, err);
+    }
+    if (ok && !cursor.error().empty()) {
+        if (err) *err = cursor.error();
+        ok = false;
+    }
+    if (!ok || !writer.finish(err)) {
+        std::remove(path.c_str());
+        return false;
+    }
+
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "✓ Экспортировано ответов: " << writer.count() << " в " << path << " ("
+              << writer.bytes() / 1024 << " КБ, " << static_cast<int64_t>(secs * 1000) << " мс)" << std::endl;
+    return true;
+}
+
+bool AiAgent::importResponses(const std::string& path, std::string* err) {
+    if (!db_ && !initResponseDatabase()) {
+        if (err) *err = "Не удалось открыть базу ответов";
+        return false;
+    }
+
+    // Файл проверяется целиком до начала импорта
+    uint64_t expected = 0;
+    if (!session_archive::Reader::verify(path, err, &expected)) return false;
+
+    session_archive::Reader reader;
+    if (!reader.open(path, err)) return false;
+    if (reader.header().value("kind", "") != "saved_responses") {
+        if (err) *err = "Файл не содержит сохраненных ответов: " + path;
+        return false;
+    }
+
+    const char* sql = "INSERT INTO saved_responses (response, codec, raw_len, timestamp) VALUES (?, ?, ?, ?);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        if (err) *err = std::string("Ошибка подготовки SQL: ") + sqlite3_errmsg(db_);
+        return false;
+    }
+
+    // Импорт — одна транзакция: при любой ошибке база остается как была
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<nlohmann::json> records;
+    std::string read_err;
+    uint64_t imported = 0;
+    bool ok = true;
+    sqlite3_exec(db_, "BEGIN;", nullptr, nullptr, nullptr);
+    while (ok && reader.next(records, &read_err)) {
+        for (const auto& r : records) {
+            std::string timestamp, text;
+            try {
+                timestamp = r.at("timestamp").get<std::string>();
+                text = r.at("text").get<std::string>();
+            } catch (const std::exception& e) {
+                if (err) *err = std::string("Поврежденная запись в файле: ") + e.what();
+                ok = false;
+                break;
+            }
+
+            std::string packed;
+            const Codec codec = codec_->encode(text, packed);
+            if (codec == Codec::Plain) {
+                sqlite3_bind_text(stmt, 1, packed.data(), (int)packed.size(), SQLITE_STATIC);
+            } else {
+                sqlite3_bind_blob(stmt, 1, packed.data(), (int)packed.size(), SQLITE_STATIC);
+            }
+            sqlite3_bind_int(stmt, 2, static_cast<int>(codec));
+            sqlite3_bind_int64(stmt, 3, (sqlite3_int64)text.size());
+            sqlite3_bind_text(stmt, 4, timestamp.c_str(), (int)timestamp.size(), SQLITE_STATIC);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                if (err) *err = std::string("Ошибка записи ответа: ") + sqlite3_errmsg(db_);
+                ok = false;
+            }
+            sqlite3_reset(stmt);
+            if (!ok) break;
+            ++imported;
+        }
+    }
+    if (ok && !read_err.empty()) {
+        if (err) *err = read_err;
+        ok = false;
+    }
+    if (ok && imported != expected) {
+        if (err) *err = "В файле объявлено " + std::to_string(expected) + " ответов, прочитано " +
+                        std::to_string(imported);
+        ok = false;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db_, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (!ok) return false;
+
+    row_count_ += (int64_t)imported;
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    trainDictionaryIfNeeded();
+
+    std::cout << "✓ Импортировано ответов: " << imported << " за "
+              << static_cast<int64_t>(secs * 1000) << " мс ("
+              << static_cast<int64_t>(secs > 0 ? imported / secs : 0) << " ответов/с)" << std::endl;
+    return true;
+}
+
+std::string AiAgent::getStorageStats() {
+    if (!db_ && !initResponseDatabase()) return "База ответов недоступна";
+
+    std::ostringstream out;
+    out << "=== ХРАНЕНИЕ ОТВЕТОВ ===\n";
+    out << "Сжатие: " << (ContentCodec::available() ? "zstd" : "выключено (собрано без zstd)")
+        << (codec_->hasDictionary() ? ", со словарём" : ", без словаря") << "\n";
+
+    const char* sql =
+        "SELECT codec, COUNT(*), SUM(raw_len), SUM(length(CAST(response AS BLOB))) "
+        "FROM saved_responses GROUP BY codec ORDER BY codec;";
+    sqlite3_stmt* stmt;
+    int64_t raw_total = 0, stored_total = 0;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        static const char* names[] = {"plain", "zstd", "zstd+dict"};
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const int codec = sqlite3_column_int(stmt, 0);
+            const int64_t raw = sqlite3_column_int64(stmt, 2);
+            const int64_t stored = sqlite3_column_int64(stmt, 3);
+            raw_total += raw;
+            stored_total += stored;
+            out << "  " << (codec >= 0 && codec <= 2 ? names[codec] : "?") << ": "
+                << sqlite3_column_int64(stmt, 1) << " ответов, " << raw << " -> " << stored << " байт\n";
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (stored_total > 0) {
+        out << "Итого: " << raw_total << " -> " << stored_total << " байт (x"
+            << static_cast<double>(raw_total) / stored_total << ")\n";
+    }
+
+    const auto st = codec_->stats();
+    out << "В этом запуске: сжато " << st.encoded << " (x" << st.ratio() << ", "
+        << st.compress_ns / 1000 << " мкс CPU), распаковано " << st.decoded
+        << " (" << st.decompress_ns / 1000 << " мкс CPU)";
+    return out.str();
+}
+
 //ОСНОВНЫЕ МЕТОДЫ АНАЛИЗА КОДА
 
 std::optional<std::string> AiAgent::analyzeCodeFile(const std::string& filepath, 
                                                    const std::string& language,
                                                    std::string* err) {
-    std::string code;
-    if (!readWholeFile(filepath, code, err)) {
+    // Большой файл отображается в память: код из него сразу попадает в
+    // промпт, без копий через потоки
+    FileView file;
+    if (!file.open(filepath, err)) {
         return std::nullopt;
     }
     
-    if (code.empty()) {
+    if (file.empty()) {
         if (err) *err = "Файл пустой: " + filepath;
         return std::nullopt;
     }
     
-    return analyzeCodeString(code, language, err);
+    // У файла есть расширение и, может быть, #! — подсказки определителю языка
+    std::string lang = language;
+    if (lang == "auto") lang = detectSourceLanguage(file.view(), filepath).language;
+    return analyzeAndSave(file.view(), lang, filepath, err);
 }
 
 std::optional<std::string> AiAgent::analyzeCodeString(const std::string& code,
@@ -522,13 +1138,25 @@ std::optional<std::string> AiAgent::analyzeCodeString(const std::string& code,
         if (err) *err = "Код пустой";
         return std::nullopt;
     }
-    
-    // Определяем, является ли это полным кодом (более 3 строк)
-    int line_count = std::count(code.begin(), code.end(), '\n') + 1;
-    bool is_complete_code = line_count > 3;
-    
-    std::string prompt = buildAnalysisPrompt(code, language, is_complete_code);
-    auto result = sendRequest(prompt, err);
+    return analyzeAndSave(code, language, {}, err);
+}
+
+std::optional<std::string> AiAgent::analyzeAndSave(std::string_view code,
+                                                  const std::string& language,
+                                                  const std::string& path,
+                                                  std::string* err) {
+    const std::string lang = resolveLanguage(code, language);
+    const PrepassResult prepass = runPrepass(code, lang, path, cfg_.prepass);
+
+    std::optional<std::string> result;
+    if (prepass.decision == PrepassDecision::Skip && !path.empty()) {
+        std::cout << "Запрос к модели пропущен: " << prepass.reason << std::endl;
+        result = localOnlyReport(prepass);
+    } else {
+        printBackend();
+        result = analyzeSource(code, lang, err);
+        if (result) *result = addLocalFindings(*result, prepass.findings);
+    }
     
     if (result && context_enabled_) {
         saveResponse(*result);
@@ -537,6 +1165,106 @@ std::optional<std::string> AiAgent::analyzeCodeString(const std::string& code,
     return result;
 }
 
+std::optional<std::string> AiAgent::analyzeSource(std::string_view code,
+                                                 const std::string& language,
+                                                 std::string* err) const {
+    if (code.empty()) {
+        if (err) *err = "Код пустой";
+        return std::nullopt;
+    }
+    const std::string lang = resolveLanguage(code, language);
+    const std::vector<SourceChunk> chunks = planChunks(code, lang);
+    if (chunks.size() <= 1) {
+        return postAnalysisPrompt(buildAnalysisPrompt(code, lang, isCompleteCode(code)), err);
+    }
+
+    // Фрагменты анализируются одновременно, ответы склеиваются в один отчет
+    std::vector<std::string> responses(chunks.size());
+    std::vector<std::string> errors(chunks.size());
+    {
+        WorkStealingPool pool((unsigned)std::min<size_t>(cfg_.chunk_jobs, chunks.size()));
+        const std::atomic<bool>* cancel = t_cancel;   // отмена действует и на фрагменты
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            pool.submit([&, k, cancel] {
+                RequestCancelScope scope(cancel);
+                if (auto r = analyzeChunk(code, chunks, k, lang, &errors[k])) responses[k] = std::move(*r);
+            });
+        }
+        pool.wait();
+    }
+    return finishChunks(chunks, responses, errors, err);
+}
+
+std::string AiAgent::resolveLanguage(std::string_view code, const std::string& language) const {
+    std::string lang = language == "auto" ? detectLanguage(code) : language;
+    return lang == "auto" ? "python" : lang;  // так было до появления других языков
+}
+
+std::vector<SourceChunk> AiAgent::planChunks(std::string_view code, const std::string& language) const {
+    ChunkingOptions opts;
+    opts.max_chars = cfg_.chunk_max_chars;
+    opts.overlap_lines = cfg_.chunk_overlap_lines;
+    return splitSource(code, language, opts);
+}
+
+std::optional<std::string> AiAgent::analyzeChunk(std::string_view code,
+                                                 const std::vector<SourceChunk>& chunks,
+                                                 size_t index,
+                                                 const std::string& language,
+                                                 std::string* err) const {
+    if (chunks.size() == 1) {
+        return postAnalysisPrompt(buildAnalysisPrompt(code, language, isCompleteCode(code)), err);
+    }
+    return postAnalysisPrompt(buildChunkPrompt(code, chunks[index], countLines(code), language), err);
+}
+
+std::vector<SourceChunk> AiAgent::planRegions(std::string_view code, const std::string& language,
+                                              const std::vector<LineSpan>& changed,
+                                              size_t context_lines) const {
+    RegionOptions opts;
+    opts.max_chars = cfg_.chunk_max_chars;
+    opts.context_lines = context_lines;
+    return enclosingRegions(code, language, changed, opts);
+}
+
+std::optional<std::string> AiAgent::analyzeRegion(std::string_view code,
+                                                  const SourceChunk& region,
+                                                  const std::vector<LineSpan>& changed,
+                                                  const std::string& language,
+                                                  std::string* err) const {
+    // Только изменения внутри фрагмента
+    std::vector<LineSpan> inside;
+    for (const LineSpan& span : changed) {
+        if (span.first >= region.first_line && span.first <= region.last_line) inside.push_back(span);
+    }
+    return postAnalysisPrompt(buildChunkPrompt(code, region, countLines(code), language, &inside), err);
+}
+
+std::optional<std::string> AiAgent::finishChunks(const std::vector<SourceChunk>& chunks,
+                                                 const std::vector<std::string>& responses,
+                                                 const std::vector<std::string>& errors,
+                                                 std::string* err) {
+    if (chunks.size() == 1) {
+        if (responses[0].empty()) {
+            if (err) *err = errors[0];
+            return std::nullopt;
+        }
+        return responses[0];
+    }
+    // Хотя бы один фрагмент проанализирован — отчет с пометкой о пропущенных
+    for (const auto& r : responses) {
+        if (!r.empty()) return mergeChunkReports(chunks, responses);
+    }
+    if (err) *err = errors.empty() ? "" : errors[0];
+    return std::nullopt;
+}
+
+// Полный код (более 3 строк) анализируется как единое целое
+bool AiAgent::isCompleteCode(std::string_view code) {
+    int line_count = std::count(code.begin(), code.end(), '\n') + 1;
+    return line_count > 3;
+}
+
 //ИНТЕРАКТИВНЫЙ РЕЖИМ
 
 void AiAgent::runInteractiveMode() {
@@ -588,7 +1316,8 @@ void AiAgent::runInteractiveMode() {
                 std::cout << "  /context       - Включить/выключить сохранение ответов\n";
                 std::cout << "  /saved         - Показать сохраненные ответы\n";
                 std::cout << "  /clear         - Очистить сохраненные ответы\n";
-                std::cout << "  /lang <язык>   - Установить язык (cpp/python/auto)\n";
+                std::cout << "  /stats         - Сжатие сохраненных ответов\n";
+                std::cout << "  /lang <язык>   - Установить язык (cpp/c/python/java/javascript/typescript/go/rust/shell/auto)\n";
                 std::cout << "  /file <путь>   - Проанализировать файл\n";
                 std::cout << "  /local         - Переключиться на локальную модель\n";
                 std::cout << "  /remote        - Переключиться на удаленный API\n";
@@ -610,13 +1339,16 @@ void AiAgent::runInteractiveMode() {
                     std::cout << "\n=== СОХРАНЕННЫЕ ОТВЕТЫ (" << responses.size() << ") ===\n";
                     for (size_t i = 0; i < responses.size(); ++i) {
                         std::cout << "[" << (i+1) << "] " << responses[i].timestamp << "\n";
-                        std::cout << responses[i].response << "\n---\n";
+                        std::cout << responses[i].text() << "\n---\n";
                     }
                 }
                 continue;
             } else if (line == "/clear") {
                 clearSavedResponses();
                 continue;
+            } else if (line == "/stats") {
+                std::cout << getStorageStats() << "\n";
+                continue;
             } else if (line.substr(0, 6) == "/lang ") {
                 std::string lang = line.substr(6);
                 std::cout << "Язык установлен: " << lang << "\n";
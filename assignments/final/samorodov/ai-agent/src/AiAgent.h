@@ -1,9 +1,16 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <optional>
 #include <nlohmann/json.hpp>
 #include <sqlite3.h>
 #include <vector>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+#include "ContentCodec.h"
+#include "SourceChunker.h"
+#include "StaticPrepass.h"
 
 struct AiConfig {
     std::string inference_source = "remote"; // "remote" или "local"
@@ -14,12 +21,96 @@ struct AiConfig {
     std::string local_host = "127.0.0.1";
     int local_port = 8080;
     std::string local_model_path;
+    // Файл больше chunk_max_chars анализируется по фрагментам (SourceChunker.h),
+    // до chunk_jobs запросов одновременно
+    size_t chunk_max_chars = 8000;
+    size_t chunk_overlap_lines = 3;
+    unsigned chunk_jobs = 4;
+    // Ответ модели — JSON по схеме (StructuredReport.h): "json_schema"
+    // (response_format), "grammar" (GBNF, только llama-server) или "off" —
+    // прежний текстовый формат. Удаленный API схему не понимает: его ответ
+    // проверяется и при ошибке отправляется на исправление
+    std::string structured_output = "json_schema";
+    // Локальный проход перед запросом к модели (StaticPrepass.h)
+    PrepassRules prepass;
 };
 
-// Структура только для сохранения ответов ИИ
+// Структура только для сохранения ответов ИИ.
+// Текст хранится в том виде, в каком лежит в базе, и распаковывается
+// только при первом обращении к text()
 struct SavedResponse {
-    std::string response;
+    int64_t id = 0;
     std::string timestamp;
+    Codec codec = Codec::Plain;
+    std::string stored;
+    std::shared_ptr<const ContentCodec> codec_impl;
+
+    const std::string& text() const;
+
+private:
+    mutable std::optional<std::string> decoded_;
+};
+
+// Фильтр и окно выборки сохраненных ответов. Время — в формате базы
+// ("YYYY-MM-DD" или "YYYY-MM-DD HH:MM:SS", UTC)
+struct SavedQuery {
+    std::string since;    // включительно; пусто — без ограничения
+    std::string until;    // не включая
+    std::string keyword;  // подстрока текста ответа (с учетом регистра)
+    int64_t offset = 0;
+    int64_t limit = -1;   // -1 — все подходящие
+    int page_size = 100;  // сколько строк читать из базы за раз
+    bool oldest_first = false;
+};
+
+// Курсор по сохраненным ответам, от новых к старым (или наоборот).
+// Читает страницами по id (WHERE id < последний_прочитанный), поэтому
+// в памяти не больше одной страницы и между страницами база не заблокирована.
+// Действителен, пока открыта база агента.
+class SavedResponseCursor {
+public:
+    SavedResponseCursor() = default;
+    SavedResponseCursor(sqlite3* db, std::shared_ptr<const ContentCodec> codec, SavedQuery query);
+    ~SavedResponseCursor();
+
+    SavedResponseCursor(SavedResponseCursor&& other) noexcept;
+    SavedResponseCursor& operator=(SavedResponseCursor&& other) noexcept;
+    SavedResponseCursor(const SavedResponseCursor&) = delete;
+    SavedResponseCursor& operator=(const SavedResponseCursor&) = delete;
+
+    // Следующий ответ; false — выборка закончилась или ошибка (см. error())
+    bool next(SavedResponse& out);
+    const std::string& error() const { return error_; }
+
+private:
+    bool fetchPage();
+
+    sqlite3_stmt* stmt_ = nullptr;
+    std::shared_ptr<const ContentCodec> codec_;
+    SavedQuery query_;
+    std::vector<SavedResponse> page_;
+    size_t page_pos_ = 0;
+    int64_t last_id_ = INT64_MAX;
+    int64_t delivered_ = 0;
+    bool first_page_ = true;
+    bool exhausted_ = false;
+    std::string error_;
+};
+
+// Отмена запросов к модели из текущего потока: пока объект жив, запросы
+// проверяют флаг и обрываются, как только он поднят (analyze --watch).
+// Прерванный запрос возвращает nullopt с err "запрос отменен"
+class RequestCancelScope {
+public:
+    explicit RequestCancelScope(const std::atomic<bool>* flag);
+    ~RequestCancelScope();
+    RequestCancelScope(const RequestCancelScope&) = delete;
+    RequestCancelScope& operator=(const RequestCancelScope&) = delete;
+
+    static bool cancelled();
+
+private:
+    const std::atomic<bool>* prev_;
 };
 
 class AiAgent {
@@ -41,6 +132,45 @@ public:
     std::optional<std::string> analyzeCodeString(const std::string& code,
                                                 const std::string& language = "auto",
                                                 std::string* err = nullptr);
+
+    // Анализ без вывода в консоль и без сохранения ответа. Агент не
+    // меняется, поэтому вызов можно делать из нескольких потоков (analyze-dir)
+    std::optional<std::string> analyzeSource(std::string_view code,
+                                             const std::string& language = "auto",
+                                             std::string* err = nullptr) const;
+    
+    const PrepassRules& prepassRules() const { return cfg_.prepass; }
+
+    // Определение языка по содержимому (LanguageDetector.h); "auto" — не определен
+    std::string detectLanguage(std::string_view code) const;
+    // "auto" -> язык по содержимому; неопределенный анализируется как Python
+    std::string resolveLanguage(std::string_view code, const std::string& language) const;
+
+    // Анализ по фрагментам для тех, кто сам распределяет запросы по потокам
+    // (analyze-dir): план фрагментов, запрос по одному фрагменту и склейка.
+    // Один фрагмент — это весь файл и обычный промпт
+    std::vector<SourceChunk> planChunks(std::string_view code, const std::string& language) const;
+    std::optional<std::string> analyzeChunk(std::string_view code,
+                                            const std::vector<SourceChunk>& chunks,
+                                            size_t index,
+                                            const std::string& language,
+                                            std::string* err = nullptr) const;
+    // Объемлющие функции измененных строк, не больше chunk_max_chars каждая
+    std::vector<SourceChunk> planRegions(std::string_view code, const std::string& language,
+                                         const std::vector<LineSpan>& changed,
+                                         size_t context_lines) const;
+    // Фрагмент вокруг изменений (analyze --diff): в промпте перечислены
+    // измененные строки из changed, попавшие в region
+    std::optional<std::string> analyzeRegion(std::string_view code,
+                                             const SourceChunk& region,
+                                             const std::vector<LineSpan>& changed,
+                                             const std::string& language,
+                                             std::string* err = nullptr) const;
+    // responses[i] пустой — фрагмент не удался, причина в errors[i]
+    static std::optional<std::string> finishChunks(const std::vector<SourceChunk>& chunks,
+                                                   const std::vector<std::string>& responses,
+                                                   const std::vector<std::string>& errors,
+                                                   std::string* err = nullptr);
     
     // Интерактивный режим анализа кода
     void runInteractiveMode();
@@ -48,29 +178,58 @@ public:
     // Управление контекстом (только ответы ИИ)
     bool enableContext();
     bool disableContext();
-    std::vector<SavedResponse> getSavedResponses() const;
+    // Последние 10 ответов
+    std::vector<SavedResponse> getSavedResponses();
+    // Потоковая выборка с фильтрами; база открывается при необходимости
+    SavedResponseCursor querySavedResponses(const SavedQuery& query, std::string* err = nullptr);
     bool clearSavedResponses();
+    // Перенос сохраненных ответов между машинами (см. SessionArchive.h)
+    bool exportResponses(const std::string& path, const SavedQuery& query, std::string* err = nullptr);
+    bool importResponses(const std::string& path, std::string* err = nullptr);
+    // Степень сжатия сохранённых ответов и CPU-время кодека
+    std::string getStorageStats();
     
-    // Вспомогательные методы
+    // Вспомогательные методы. Файл читается одним read() (FileView.h)
     static bool readWholeFile(const std::string& path, std::string& out, std::string* err);
     void setPrompt(const std::string& p) { prompt_ = p; }
 
 private:
     // Низкоуровневые методы запросов
-    std::optional<std::string> httpsPostGenerate(const std::string& jsonBody, std::string* err);
-    std::optional<std::string> sendLocalRequest(const std::string& prompt, std::string* err);
-    std::optional<std::string> sendRequest(const std::string& prompt, std::string* err);
+    std::optional<std::string> httpsPostGenerate(const std::string& jsonBody, std::string* err) const;
+    // constrained — ограничить ответ схемой или грамматикой (structured_output)
+    std::optional<std::string> sendLocalRequest(const std::string& prompt, std::string* err,
+                                                bool constrained = false) const;
+    std::optional<std::string> postPrompt(const std::string& prompt, std::string* err,
+                                          bool constrained = false) const;
+    // Запрос анализа: JSON-ответ проверяется (при ошибке — один запрос на
+    // исправление) и возвращается в текстовом формате formatAnalysisReport
+    std::optional<std::string> postAnalysisPrompt(const std::string& prompt, std::string* err) const;
+    bool structuredOutput() const { return cfg_.structured_output != "off"; }
+    void printBackend() const;
+    // Общая часть analyzeCodeFile/analyzeCodeString: локальный проход,
+    // запрос к модели (если нужен) и сохранение ответа. path пустой —
+    // код введен вручную и всегда отправляется модели
+    std::optional<std::string> analyzeAndSave(std::string_view code,
+                                              const std::string& language,
+                                              const std::string& path,
+                                              std::string* err);
     
     // Обработка промптов
-    std::string buildAnalysisPrompt(const std::string& code, 
+    std::string buildAnalysisPrompt(std::string_view code, 
                                    const std::string& language,
                                    bool is_complete_code = false) const;
-    
-    // Определение языка программирования
-    std::string detectLanguage(const std::string& code) const;
+    std::string buildChunkPrompt(std::string_view code,
+                                 const SourceChunk& chunk,
+                                 size_t total_lines,
+                                 const std::string& language,
+                                 const std::vector<LineSpan>* changed = nullptr) const;
+    static bool isCompleteCode(std::string_view code);
     
     // Работа с SQLite (только для сохранения ответов)
     bool initResponseDatabase();
+    bool migrateResponseDatabase();
+    bool loadDictionaries();
+    void trainDictionaryIfNeeded();
     bool saveResponse(const std::string& response);
     void closeDatabase();
 
@@ -80,4 +239,9 @@ private:
     bool context_enabled_ = false;
     sqlite3* db_ = nullptr;
     std::string db_path_ = "ai_responses.db";
+
+    // Сжатие сохранённых ответов
+    std::shared_ptr<ContentCodec> codec_ = std::make_shared<ContentCodec>();
+    int64_t row_count_ = 0;
+    int64_t train_threshold_ = 64;  // после скольких строк обучать словарь
 };
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "AnalysisReport.h"
+#include "SourceChunker.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+bool contains(const std::string& s, const char* what) {
+    return s.find(what) != std::string::npos;
+}
+
+// Строчные буквы (латиница и кириллица), пунктуация -> один пробел.
+// Так "Утечка памяти!" и "утечка  памяти" считаются одним замечанием
+std::string normalize(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    auto space = [&out] {
+        if (!out.empty() && out.back() != ' ') out += ' ';
+    };
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c < 0x80) {
+            if (std::isalnum(c)) out += (char)std::tolower(c);
+            else space();
+            continue;
+        }
+        if (c == 0xD0 && i + 1 < s.size()) {
+            unsigned char d = (unsigned char)s[i + 1];
+            if (d >= 0x90 && d <= 0x9F) { out += (char)0xD0; out += (char)(d + 0x20); ++i; continue; }
+            if (d >= 0xA0 && d <= 0xAF) { out += (char)0xD1; out += (char)(d - 0x20); ++i; continue; }
+            if (d == 0x81) { out += (char)0xD1; out += (char)0x91; ++i; continue; }  // Ё
+        }
+        out += (char)c;
+    }
+    if (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+enum Section { NONE, ERRORS, RECOMMENDATIONS, ASSESSMENT };
+
+// Номер пункта "1." / "1)" или маркер списка "-" / "*"; возвращает длину маркера
+size_t itemMarker(const std::string& line) {
+    size_t i = 0;
+    while (i < line.size() && std::isdigit((unsigned char)line[i])) ++i;
+    if (i > 0 && i < line.size() && (line[i] == '.' || line[i] == ')')) return i + 1;
+    if (line.size() > 1 && (line[0] == '-' || line[0] == '*') && line[1] == ' ') return 1;
+    return 0;
+}
+
+Section sectionHeader(const std::string& line) {
+    if (itemMarker(line) || line.size() > 80) return NONE;
+    const bool decorated = contains(line, "===") || line[0] == '#' || contains(line, "**") ||
+                           line.back() == ':';
+    if (!decorated) return NONE;
+    if (contains(line, "ОШИБК") || contains(line, "Ошибк")) return ERRORS;
+    if (contains(line, "РЕКОМЕНДАЦ") || contains(line, "Рекомендац")) return RECOMMENDATIONS;
+    if (contains(line, "ОЦЕНК") || contains(line, "Оценк")) return ASSESSMENT;
+    return NONE;
+}
+
+// "[Строка 12]", "[12]", "[строки 12-14]", "[line 7]" -> 12/12/12/7
+int lineNumberIn(const std::string& group) {
+    const bool numeric = group.find_first_not_of("0123456789 -,–") == std::string::npos;
+    if (!numeric && !contains(group, "трок") && !contains(group, "line") && !contains(group, "Line")) {
+        return 0;
+    }
+    size_t d = group.find_first_of("0123456789");
+    if (d == std::string::npos) return 0;
+    return std::atoi(group.c_str() + d);
+}
+
+CodeIssue parseItem(const std::string& line, size_t marker) {
+    CodeIssue issue;
+    std::string rest = trim(line.substr(marker));
+    while (!rest.empty() && rest[0] == '[') {
+        size_t close = rest.find(']');
+        if (close == std::string::npos) break;
+        std::string group = trim(rest.substr(1, close - 1));
+        rest = trim(rest.substr(close + 1));
+        int n = lineNumberIn(group);
+        if (n > 0 && issue.line == 0) issue.line = n;
+        else if (issue.category.empty()) issue.category = group;
+    }
+    size_t b = rest.find_first_not_of(":-— \t");
+    issue.message = b == std::string::npos ? "" : rest.substr(b);
+    return issue;
+}
+
+// "1. Нет" и подобное вместо пустого списка
+bool isNothing(const CodeIssue& issue) {
+    const std::string m = normalize(issue.message.empty() ? issue.category : issue.message);
+    return m.empty() || m == "нет" || m == "ошибок нет" || m == "нет ошибок" ||
+           m == "не найдено" || m == "не обнаружено" || m == "отсутствуют";
+}
+
+bool sameText(const std::string& a, const std::string& b) {
+    if (a == b) return true;
+    const std::string& shorter = a.size() < b.size() ? a : b;
+    const std::string& longer = a.size() < b.size() ? b : a;
+    return shorter.size() >= 16 && longer.find(shorter) != std::string::npos;
+}
+
+bool isDuplicate(const std::vector<CodeIssue>& list, const CodeIssue& issue, bool by_line) {
+    const std::string norm = normalize(issue.message);
+    for (const auto& other : list) {
+        if (by_line && other.line != issue.line) continue;
+        if (sameText(normalize(other.message), norm)) return true;
+    }
+    return false;
+}
+
+void formatIssues(std::ostringstream& out, const std::vector<CodeIssue>& issues) {
+    if (issues.empty()) {
+        out << "Не найдено\n";
+        return;
+    }
+    int n = 0;
+    for (const auto& i : issues) {
+        out << ++n << ".";
+        if (!i.category.empty()) out << " [" << i.category << "]";
+        if (i.line > 0) out << " [Строка " << i.line << "]";
+        out << ": " << i.message << "\n";
+    }
+}
+
+std::string lineRange(const SourceChunk& c) {
+    return "Строки " + std::to_string(c.own_first) + "–" + std::to_string(c.last_line);
+}
+
+}
+
+bool parseAnalysisReport(const std::string& text, AnalysisReport& out) {
+    Section section = NONE;
+    bool found = false;
+    std::string assessment;
+    std::istringstream in(text);
+    std::string raw;
+    while (std::getline(in, raw)) {
+        const std::string line = trim(raw);
+        if (line.empty()) continue;
+
+        Section header = sectionHeader(line);
+        if (header != NONE) {
+            section = header;
+            found = true;
+            continue;
+        }
+        if (section == ASSESSMENT) {
+            if (line.find_first_not_of("`") == std::string::npos) continue;
+            if (!assessment.empty()) assessment += ' ';
+            assessment += line;
+            continue;
+        }
+        if (section != ERRORS && section != RECOMMENDATIONS) continue;
+
+        auto& list = section == ERRORS ? out.errors : out.recommendations;
+        if (size_t marker = itemMarker(line)) {
+            CodeIssue issue = parseItem(line, marker);
+            if (!isNothing(issue)) list.push_back(std::move(issue));
+        } else if (!list.empty()) {
+            list.back().message += " " + line;   // продолжение пункта
+        }
+    }
+    if (!assessment.empty()) out.assessments.push_back(assessment);
+    return found;
+}
+
+std::string formatAnalysisReport(const AnalysisReport& report) {
+    std::ostringstream out;
+    out << "=== ОШИБКИ ===\n";
+    formatIssues(out, report.errors);
+    out << "\n=== РЕКОМЕНДАЦИИ ===\n";
+    formatIssues(out, report.recommendations);
+    out << "\n=== ОБЩАЯ ОЦЕНКА ===\n";
+    for (const auto& a : report.assessments) out << a << "\n";
+    return out.str();
+}
+
+void mergeReports(AnalysisReport& into, AnalysisReport part) {
+    for (auto& issue : part.errors) {
+        if (!isDuplicate(into.errors, issue, true)) into.errors.push_back(std::move(issue));
+    }
+    for (auto& issue : part.recommendations) {
+        if (!isDuplicate(into.recommendations, issue, false)) into.recommendations.push_back(std::move(issue));
+    }
+    for (auto& a : part.assessments) into.assessments.push_back(std::move(a));
+
+    // Ошибки по порядку строк, без номера — в конце
+    std::stable_sort(into.errors.begin(), into.errors.end(), [](const CodeIssue& a, const CodeIssue& b) {
+        return (a.line ? a.line : INT32_MAX) < (b.line ? b.line : INT32_MAX);
+    });
+}
+
+void anchorToChunk(AnalysisReport& part, const SourceChunk& chunk) {
+    // Номер вне фрагмента, но не больше его длины — модель считала от начала фрагмента
+    const int first = (int)chunk.first_line, last = (int)chunk.last_line;
+    auto remap = [&](CodeIssue& issue) {
+        if (issue.line > 0 && (issue.line < first || issue.line > last) &&
+            issue.line <= last - first + 1) {
+            issue.line += first - 1;
+        }
+    };
+    for (auto& issue : part.errors) remap(issue);
+    for (auto& issue : part.recommendations) remap(issue);
+    for (auto& a : part.assessments) a = lineRange(chunk) + ": " + a;
+}
+
+std::string mergeChunkReports(const std::vector<SourceChunk>& chunks,
+                              const std::vector<std::string>& responses) {
+    AnalysisReport merged;
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        const SourceChunk& chunk = chunks[k];
+        if (k >= responses.size() || responses[k].empty()) {
+            merged.assessments.push_back(lineRange(chunk) + ": не проанализированы");
+            continue;
+        }
+        AnalysisReport part;
+        if (!parseAnalysisReport(responses[k], part)) {
+            merged.assessments.push_back(lineRange(chunk) + " (ответ не по формату): " + trim(responses[k]));
+            continue;
+        }
+
+        anchorToChunk(part, chunk);
+        mergeReports(merged, std::move(part));
+    }
+
+    return "Файл проанализирован по частям (" + std::to_string(chunks.size()) +
+           " фрагментов)\n\n" + formatAnalysisReport(merged);
+}
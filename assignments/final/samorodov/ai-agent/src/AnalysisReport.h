@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct SourceChunk;
+
+// Замечание из ответа модели
+struct CodeIssue {
+    std::string category;   // "[Тип ошибки]" / "[Категория]"
+    int line = 0;           // строка исходника; 0 — без привязки к строке
+    std::string message;
+};
+
+// Ответ модели в формате из buildAnalysisPrompt:
+// === ОШИБКИ === / === РЕКОМЕНДАЦИИ === / === ОБЩАЯ ОЦЕНКА ===
+struct AnalysisReport {
+    std::vector<CodeIssue> errors;
+    std::vector<CodeIssue> recommendations;
+    std::vector<std::string> assessments;
+};
+
+// Разбор ответа; false — в тексте нет ни одного раздела формата
+bool parseAnalysisReport(const std::string& text, AnalysisReport& out);
+
+std::string formatAnalysisReport(const AnalysisReport& report);
+
+// Добавить part к into: повторы (та же строка и тот же текст без учета
+// регистра и пунктуации) выбрасываются, ошибки сортируются по строкам
+void mergeReports(AnalysisReport& into, AnalysisReport part);
+
+// Номера строк из ответа по фрагменту — в номера строк файла, оценки
+// помечаются диапазоном строк фрагмента
+void anchorToChunk(AnalysisReport& part, const SourceChunk& chunk);
+
+// Склейка ответов по фрагментам одного файла (responses[i] — для chunks[i],
+// пустой — фрагмент не проанализирован). Номера строк, которые модель
+// посчитала от начала фрагмента, переводятся в номера строк файла,
+// повторы из перекрытий и соседних фрагментов выбрасываются.
+std::string mergeChunkReports(const std::vector<SourceChunk>& chunks,
+                              const std::vector<std::string>& responses);
@@ -0,0 +1,132 @@
+#include "AnswerExtractor.h"
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using nlohmann::json;
+
+namespace {
+
+// Обработчик SAX: следит только за путём до текущего значения
+class AnswerSax : public nlohmann::json_sax<json> {
+public:
+    explicit AnswerSax(std::string& out) : out_(out) {}
+
+    bool found() const { return found_; }
+    bool hasError() const { return has_error_; }
+    const std::string& error() const { return error_; }
+    const std::string& parseError() const { return parse_error_; }
+
+    bool null() override { return scalar(); }
+    bool boolean(bool) override { return scalar(); }
+    bool number_integer(number_integer_t) override { return scalar(); }
+    bool number_unsigned(number_unsigned_t) override { return scalar(); }
+    bool number_float(number_float_t, const string_t&) override { return scalar(); }
+    bool binary(binary_t&) override { return scalar(); }
+
+    bool string(string_t& val) override {
+        enterValue();
+        if (isAnswer()) {
+            out_ = std::move(val);
+            found_ = true;
+            return false;  // остальное тело не нужно
+        }
+        if (isErrorString()) {
+            has_error_ = true;
+            error_ = std::move(val);
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        enterValue();
+        if (stack_.size() == 1 && stack_[0].key == "error") has_error_ = true;
+        stack_.push_back({false, 0, {}});
+        return true;
+    }
+
+    bool key(string_t& val) override {
+        // Ключи на глубине больше 4 нас не интересуют — не копируем их
+        if (stack_.size() <= 4) stack_.back().key = std::move(val);
+        else stack_.back().key.clear();
+        return true;
+    }
+
+    bool end_object() override {
+        stack_.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        enterValue();
+        stack_.push_back({true, 0, {}});
+        return true;
+    }
+
+    bool end_array() override {
+        stack_.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        parse_error_ = ex.what();
+        return false;
+    }
+
+private:
+    struct Frame {
+        bool array;
+        size_t next_index;   // для массивов: индекс следующего элемента
+        std::string key;     // для объектов: последний ключ
+    };
+
+    // Элемент массива получает свой индекс в момент начала
+    void enterValue() {
+        if (!stack_.empty() && stack_.back().array) ++stack_.back().next_index;
+    }
+
+    bool scalar() {
+        enterValue();
+        return true;
+    }
+
+    // {"text": ...} | {"choices":[{"message":{"content": ...}}]} | {"choices":[{"text": ...}]}
+    bool isAnswer() const {
+        if (stack_.size() == 1) return stack_[0].key == "text";
+        if (stack_.size() < 3 || stack_[0].key != "choices" || !stack_[1].array) return false;
+        if (stack_[1].next_index != 1) return false;  // только choices[0]
+        if (stack_.size() == 3) return stack_[2].key == "text";
+        return stack_.size() == 4 && stack_[2].key == "message" && stack_[3].key == "content";
+    }
+
+    // {"error": "..."} | {"error": {"message": "..."}}
+    bool isErrorString() const {
+        if (stack_.empty() || stack_[0].key != "error") return false;
+        return stack_.size() == 1 || (stack_.size() == 2 && stack_[1].key == "message");
+    }
+
+    std::string& out_;
+    std::vector<Frame> stack_;
+    bool found_ = false;
+    bool has_error_ = false;
+    std::string error_;
+    std::string parse_error_;
+};
+
+}
+
+bool extractAnswer(std::string_view body, std::string& out, std::string* err) {
+    AnswerSax sax(out);
+    json::sax_parse(body.data(), body.data() + body.size(), &sax);
+
+    if (sax.found()) return true;
+    if (sax.hasError()) {
+        if (err) *err = "Server error: " + (sax.error().empty() ? std::string("unknown") : sax.error());
+        return false;
+    }
+    if (err) {
+        *err = sax.parseError().empty()
+            ? "Unexpected response format: expected 'text' or 'choices[0].message.content'"
+            : "JSON parse error: " + sax.parseError();
+    }
+    return false;
+}
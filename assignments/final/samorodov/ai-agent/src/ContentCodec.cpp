@@ -0,0 +1,260 @@
+#include "ContentCodec.h"
+#include <ctime>
+
+#ifndef NO_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+
+namespace {
+// CPU-время текущего потока: сжатие не должно учитывать ожидание мьютекса
+uint64_t threadCpuNs() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+// Размер из заголовка кадра — только заявка: испорченная строка может
+// заявить гигабайты. До этого предела строка выделяется сразу по заявке,
+// больше — растет по мере распаковки, но не дальше kMaxDecodedSize
+constexpr size_t kDirectDecodeLimit = 4u << 20;
+constexpr size_t kMaxDecodedSize = 256u << 20;
+}
+#endif
+
+ContentCodec::ContentCodec(int level, size_t min_size) : level_(level), min_size_(min_size) {
+#ifndef NO_ZSTD
+    cctx_ = ZSTD_createCCtx();
+    dctx_ = ZSTD_createDCtx();
+#endif
+}
+
+ContentCodec::~ContentCodec() {
+#ifndef NO_ZSTD
+    ZSTD_freeCCtx(cctx_);
+    ZSTD_freeDCtx(dctx_);
+    ZSTD_freeCDict(cdict_);
+    for (auto& kv : ddicts_) ZSTD_freeDDict(kv.second);
+#endif
+}
+
+bool ContentCodec::available() {
+#ifdef NO_ZSTD
+    return false;
+#else
+    return true;
+#endif
+}
+
+std::optional<std::string> ContentCodec::trainDictionary(const std::vector<std::string>& samples,
+                                                         size_t dict_size, std::string* err) {
+#ifdef NO_ZSTD
+    (void)samples; (void)dict_size;
+    if (err) *err = "built without zstd";
+    return std::nullopt;
+#else
+    std::string buffer;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto& s : samples) {
+        buffer += s;
+        sizes.push_back(s.size());
+    }
+
+    std::string dict(dict_size, '\0');
+    const size_t n = ZDICT_trainFromBuffer(&dict[0], dict.size(), buffer.data(),
+                                           sizes.data(), (unsigned)sizes.size());
+    if (ZDICT_isError(n)) {
+        if (err) *err = std::string("Dictionary training failed: ") + ZDICT_getErrorName(n);
+        return std::nullopt;
+    }
+    dict.resize(n);
+    return dict;
+#endif
+}
+
+uint32_t ContentCodec::dictionaryId(const std::string& dict) {
+#ifdef NO_ZSTD
+    (void)dict;
+    return 0;
+#else
+    return ZSTD_getDictID_fromDict(dict.data(), dict.size());
+#endif
+}
+
+uint32_t ContentCodec::addDictionary(const std::string& dict, std::string* err) {
+#ifdef NO_ZSTD
+    (void)dict;
+    if (err) *err = "built without zstd";
+    return 0;
+#else
+    const uint32_t id = dictionaryId(dict);
+    if (id == 0) {
+        if (err) *err = "Not a zstd dictionary";
+        return 0;
+    }
+
+    ZSTD_DDict* ddict = ZSTD_createDDict(dict.data(), dict.size());
+    ZSTD_CDict* cdict = ZSTD_createCDict(dict.data(), dict.size(), level_);
+    if (!ddict || !cdict) {
+        ZSTD_freeDDict(ddict);
+        ZSTD_freeCDict(cdict);
+        if (err) *err = "Cannot load zstd dictionary";
+        return 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(dec_mutex_);
+        auto& slot = ddicts_[id];
+        ZSTD_freeDDict(slot);
+        slot = ddict;
+    }
+    {
+        std::lock_guard<std::mutex> lock(enc_mutex_);
+        ZSTD_freeCDict(cdict_);
+        cdict_ = cdict;
+    }
+    return id;
+#endif
+}
+
+bool ContentCodec::hasDictionary() const {
+    std::lock_guard<std::mutex> lock(enc_mutex_);
+    return cdict_ != nullptr;
+}
+
+Codec ContentCodec::encode(std::string_view text, std::string& out) {
+    Codec codec = Codec::Plain;
+#ifndef NO_ZSTD
+    if (text.size() >= min_size_) {
+        std::lock_guard<std::mutex> lock(enc_mutex_);
+        const uint64_t started = threadCpuNs();
+
+        out.resize(ZSTD_compressBound(text.size()));
+        const size_t n = cdict_
+            ? ZSTD_compress_usingCDict(cctx_, &out[0], out.size(), text.data(), text.size(), cdict_)
+            : ZSTD_compressCCtx(cctx_, &out[0], out.size(), text.data(), text.size(), level_);
+
+        if (!ZSTD_isError(n) && n < text.size()) {
+            out.resize(n);
+            codec = cdict_ ? Codec::ZstdDict : Codec::Zstd;
+        }
+
+        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+        stats_.compress_ns += threadCpuNs() - started;
+    }
+#endif
+    if (codec == Codec::Plain) out.assign(text.data(), text.size());
+
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+    stats_.raw_bytes += text.size();
+    stats_.stored_bytes += out.size();
+    ++stats_.encoded;
+    return codec;
+}
+
+#ifndef NO_ZSTD
+bool ContentCodec::decodeStream(const ZSTD_DDict_s* ddict, std::string_view data, std::string& out,
+                                std::string* err) const {
+    ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_and_parameters);
+    ZSTD_DCtx_refDDict(dctx_, ddict);
+    ZSTD_inBuffer in{data.data(), data.size(), 0};
+    size_t used = 0;
+    bool ok = false;
+    out.clear();
+    for (;;) {
+        if (out.size() - used < (64u << 10)) {
+            if (out.size() >= kMaxDecodedSize) {
+                if (err) *err = "zstd frame is larger than " + std::to_string(kMaxDecodedSize) + " bytes";
+                break;
+            }
+            out.resize(std::min(kMaxDecodedSize, std::max<size_t>(out.size() * 2, 1u << 20)));
+        }
+        ZSTD_outBuffer o{&out[0], out.size(), used};
+        const size_t ret = ZSTD_decompressStream(dctx_, &o, &in);
+        used = o.pos;
+        if (ZSTD_isError(ret)) {
+            if (err) *err = std::string("zstd: ") + ZSTD_getErrorName(ret);
+            break;
+        }
+        if (ret == 0) {
+            ok = true;
+            break;
+        }
+        // Вход кончился, а кадр нет — обрезан
+        if (in.pos == in.size && o.pos < o.size) {
+            if (err) *err = "Truncated zstd frame";
+            break;
+        }
+    }
+    // Словарь не должен остаться на контексте для следующих кадров
+    ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_and_parameters);
+    out.resize(ok ? used : 0);
+    return ok;
+}
+#endif
+
+bool ContentCodec::decode(Codec codec, std::string_view data, std::string& out,
+                          std::string* err) const {
+    if (codec == Codec::Plain) {
+        out.assign(data.data(), data.size());
+        return true;
+    }
+#ifdef NO_ZSTD
+    if (err) *err = "Record is zstd-compressed but the program was built without zstd";
+    return false;
+#else
+    const unsigned long long size = ZSTD_getFrameContentSize(data.data(), data.size());
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) {
+        if (err) *err = "Corrupted zstd frame";
+        return false;
+    }
+
+    if (size > kMaxDecodedSize) {
+        if (err) *err = "zstd frame declares " + std::to_string(size) + " bytes, limit " +
+                        std::to_string(kMaxDecodedSize);
+        return false;
+    }
+
+    size_t n;
+    uint64_t started;
+    {
+        std::lock_guard<std::mutex> lock(dec_mutex_);
+        started = threadCpuNs();
+        const ZSTD_DDict* ddict = nullptr;
+        if (codec == Codec::ZstdDict) {
+            const uint32_t id = ZSTD_getDictID_fromFrame(data.data(), data.size());
+            auto it = ddicts_.find(id);
+            if (it == ddicts_.end()) {
+                if (err) *err = "Missing zstd dictionary " + std::to_string(id);
+                return false;
+            }
+            ddict = it->second;
+        }
+        if (size <= kDirectDecodeLimit) {
+            out.resize(size);
+            n = ddict ? ZSTD_decompress_usingDDict(dctx_, &out[0], out.size(), data.data(), data.size(), ddict)
+                      : ZSTD_decompressDCtx(dctx_, &out[0], out.size(), data.data(), data.size());
+        } else if (decodeStream(ddict, data, out, err)) {
+            n = out.size();
+        } else {
+            return false;
+        }
+    }
+
+    if (ZSTD_isError(n)) {
+        if (err) *err = std::string("zstd: ") + ZSTD_getErrorName(n);
+        return false;
+    }
+    out.resize(n);
+
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+    stats_.decompress_ns += threadCpuNs() - started;
+    ++stats_.decoded;
+    return true;
+#endif
+}
+
+ContentCodec::Stats ContentCodec::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
@@ -0,0 +1,298 @@
+#include "DiffAnalyzer.h"
+#include "AiAgent.h"
+#include "AnalysisReport.h"
+#include "LanguageDetector.h"
+#include "StaticPrepass.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sys/wait.h>
+
+namespace {
+
+std::string shellQuote(const std::string& s) {
+    std::string out = "'";
+    for (char c : s) {
+        if (c == '\'') out += "'\\''";
+        else out += c;
+    }
+    return out + "'";
+}
+
+// Запуск git и весь его stdout; stderr git уходит в наш stderr
+bool runGit(const std::string& repo, const std::string& args, std::string& out, std::string* err) {
+    const std::string cmd = "git -C " + shellQuote(repo) + " " + args;
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) {
+        if (err) *err = "Не удалось запустить git";
+        return false;
+    }
+    out.clear();
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) out.append(buf, n);
+    const int status = pclose(pipe);
+    if (status != 0) {
+        if (err) *err = "git " + args + ": код выхода " +
+                        std::to_string(WIFEXITED(status) ? WEXITSTATUS(status) : status);
+        return false;
+    }
+    return true;
+}
+
+// Путь из заголовка "+++ b/path"; кавычки git ставит вокруг путей с
+// необычными символами
+std::string diffPath(std::string_view s) {
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') s = s.substr(1, s.size() - 2);
+    return std::string(s);
+}
+
+// Вторая ревизия диапазона: "a..b" и "a...b" -> b ("a.." -> HEAD);
+// пусто — сравнение с рабочим каталогом
+std::string newSideRevision(const std::string& range) {
+    const size_t dots = range.find("..");
+    if (dots == std::string::npos) return {};
+    size_t pos = dots + 2;
+    if (pos < range.size() && range[pos] == '.') ++pos;
+    const std::string rev = range.substr(pos);
+    return rev.empty() ? "HEAD" : rev;
+}
+
+size_t changedLineCount(const std::vector<LineSpan>& spans) {
+    size_t n = 0;
+    for (const LineSpan& s : spans) n += s.last >= s.first ? s.last - s.first + 1 : 0;
+    return n;
+}
+
+bool onChangedLine(int line, const std::vector<LineSpan>& spans) {
+    for (const LineSpan& s : spans) {
+        if (line >= (int)s.first && line <= (int)std::max(s.first, s.last)) return true;
+    }
+    return false;
+}
+
+// Файл диффа, подготовленный к запросам
+struct DiffJob {
+    FileDiff diff;
+    std::string code;
+    std::string language;
+    PrepassResult prepass;
+    std::vector<SourceChunk> regions;
+    std::vector<std::string> responses;
+    std::vector<std::string> errors;
+    std::string skipped;   // причина, если модель не спрашиваем
+    size_t sent_lines = 0;
+    size_t sent_bytes = 0;
+};
+
+}
+
+std::vector<FileDiff> parseUnifiedDiff(std::string_view diff) {
+    std::vector<FileDiff> files;
+    FileDiff* current = nullptr;
+    bool prefixed = false;   // пути с a/ и b/ (без --no-prefix)
+    size_t pos = 0;
+    while (pos < diff.size()) {
+        size_t nl = diff.find('\n', pos);
+        if (nl == std::string_view::npos) nl = diff.size();
+        std::string_view line = diff.substr(pos, nl - pos);
+        pos = nl + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        if (line.compare(0, 11, "diff --git ") == 0) {
+            current = nullptr;
+            prefixed = line.compare(11, 2, "a/") == 0 && line.find(" b/") != std::string_view::npos;
+        } else if (line.compare(0, 4, "+++ ") == 0) {
+            std::string_view path = line.substr(4);
+            const size_t tab = path.find('\t');
+            if (tab != std::string_view::npos) path = path.substr(0, tab);
+            if (path == "/dev/null") {
+                current = nullptr;   // файл удален
+                continue;
+            }
+            std::string p = diffPath(path);
+            if (prefixed && p.compare(0, 2, "b/") == 0) p.erase(0, 2);
+            files.push_back({p, {}});
+            current = &files.back();
+        } else if (current && line.compare(0, 3, "@@ ") == 0) {
+            // @@ -a[,b] +c[,d] @@
+            const size_t plus = line.find(" +");
+            if (plus == std::string_view::npos) continue;
+            unsigned long start = 0, count = 1;
+            const std::string spec(line.substr(plus + 2, line.find(' ', plus + 2) - plus - 2));
+            if (std::sscanf(spec.c_str(), "%lu,%lu", &start, &count) < 1) continue;
+            // Только удаление (d = 0): строки удалены после строки c
+            LineSpan span;
+            span.first = std::max(1ul, start);
+            span.last = count == 0 ? span.first - 1 : start + count - 1;
+            current->changed.push_back(span);
+        }
+    }
+    files.erase(std::remove_if(files.begin(), files.end(),
+                               [](const FileDiff& f) { return f.changed.empty(); }),
+                files.end());
+    return files;
+}
+
+bool analyzeDiff(const AiAgent& agent, const DiffAnalysisOptions& opts,
+                 std::ostream& out, std::string* err) {
+    std::string top;
+    if (!runGit(opts.repo, "rev-parse --show-toplevel", top, err)) return false;
+    while (!top.empty() && (top.back() == '\n' || top.back() == '\r')) top.pop_back();
+
+    std::string diff_text;
+    std::string args = "-c core.quotePath=false diff -U0 --no-color --no-ext-diff --no-prefix --diff-filter=d";
+    if (!opts.range.empty()) args += " " + shellQuote(opts.range);
+    args += " --";
+    if (!runGit(top, args, diff_text, err)) return false;
+
+    const std::vector<FileDiff> files = parseUnifiedDiff(diff_text);
+    if (files.empty()) {
+        out << "Изменений нет" << (opts.range.empty() ? "" : " в " + opts.range) << "\n";
+        return true;
+    }
+    const std::string new_rev = newSideRevision(opts.range);
+
+    // Новая версия каждого файла, язык, локальный проход и фрагменты
+    std::vector<DiffJob> jobs(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        DiffJob& job = jobs[i];
+        job.diff = files[i];
+        std::string read_err;
+        const bool ok = new_rev.empty()
+            ? AiAgent::readWholeFile(top + "/" + job.diff.path, job.code, &read_err)
+            : runGit(top, "show " + shellQuote(new_rev + ":" + job.diff.path), job.code, &read_err);
+        if (!ok) {
+            job.skipped = "не прочитан: " + read_err;
+            continue;
+        }
+        if (std::memchr(job.code.data(), '\0', std::min<size_t>(job.code.size(), 8192))) {
+            job.skipped = "двоичный файл";
+            continue;
+        }
+        job.language = opts.language == "auto" ? detectSourceLanguage(job.code, job.diff.path).language
+                                               : opts.language;
+        if (job.language == "auto") {
+            job.skipped = "не исходный код";
+            continue;
+        }
+        job.prepass = runPrepass(job.code, job.language, job.diff.path, agent.prepassRules());
+        if (job.prepass.decision == PrepassDecision::Skip) {
+            job.skipped = job.prepass.reason;
+            continue;
+        }
+        job.regions = agent.planRegions(job.code, job.language, job.diff.changed, opts.context_lines);
+        job.responses.resize(job.regions.size());
+        job.errors.resize(job.regions.size());
+        for (const SourceChunk& r : job.regions) {
+            job.sent_lines += r.last_line - r.first_line + 1;
+            job.sent_bytes += r.end - r.begin;
+        }
+    }
+
+    // Фрагменты всех файлов — в общий пул
+    const auto started = std::chrono::steady_clock::now();
+    size_t total_regions = 0;
+    for (const auto& job : jobs) total_regions += job.regions.size();
+    const unsigned threads = (unsigned)std::max<size_t>(1, std::min<size_t>(opts.jobs, total_regions));
+    {
+        WorkStealingPool pool(threads);
+        for (auto& job : jobs) {
+            for (size_t k = 0; k < job.regions.size(); ++k) {
+                pool.submit([&agent, &job, k] {
+                    try {
+                        if (auto r = agent.analyzeRegion(job.code, job.regions[k], job.diff.changed,
+                                                         job.language, &job.errors[k])) {
+                            job.responses[k] = std::move(*r);
+                        }
+                    } catch (const std::exception& e) {
+                        job.errors[k] = e.what();
+                    }
+                });
+            }
+        }
+        pool.wait();
+    }
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    size_t analyzed = 0, failed = 0, skipped = 0;
+    size_t sent_lines = 0, total_lines = 0, sent_bytes = 0, total_bytes = 0;
+    for (const auto& job : jobs) {
+        // Локальные замечания — только к измененным строкам
+        AnalysisReport report;
+        for (const auto& issue : job.prepass.findings.errors) {
+            if (onChangedLine(issue.line, job.diff.changed)) report.errors.push_back(issue);
+        }
+        for (const auto& issue : job.prepass.findings.recommendations) {
+            if (onChangedLine(issue.line, job.diff.changed)) report.recommendations.push_back(issue);
+        }
+
+        out << "=== " << job.diff.path;
+        if (!job.skipped.empty()) {
+            ++skipped;
+            out << " (пропущен: " << job.skipped << ") ===\n";
+            if (!report.errors.empty() || !report.recommendations.empty()) {
+                out << formatAnalysisReport(report);
+            }
+            out << "\n";
+            continue;
+        }
+
+        const size_t lines = countLines(job.code);
+        sent_lines += job.sent_lines;
+        total_lines += lines;
+        sent_bytes += job.sent_bytes;
+        total_bytes += job.code.size();
+        out << " (" << languageDisplayName(job.language) << ", изменено строк: "
+            << changedLineCount(job.diff.changed) << ", фрагментов: " << job.regions.size()
+            << ", отправлено строк: " << job.sent_lines << " из " << lines << ") ===\n";
+
+        bool any = false;
+        for (size_t k = 0; k < job.regions.size(); ++k) {
+            const SourceChunk& region = job.regions[k];
+            AnalysisReport part;
+            if (job.responses[k].empty()) {
+                report.assessments.push_back("Строки " + std::to_string(region.first_line) + "–" +
+                                             std::to_string(region.last_line) + ": не проанализированы (" +
+                                             job.errors[k] + ")");
+                continue;
+            }
+            any = true;
+            if (!parseAnalysisReport(job.responses[k], part)) {
+                part.assessments.push_back(job.responses[k]);
+            }
+            anchorToChunk(part, region);
+            // Модели показан только фрагмент: строки вне него — ошибка нумерации
+            auto outside = [&region](const CodeIssue& issue) {
+                return issue.line > 0 && ((size_t)issue.line < region.first_line ||
+                                          (size_t)issue.line > region.last_line);
+            };
+            part.errors.erase(std::remove_if(part.errors.begin(), part.errors.end(), outside),
+                              part.errors.end());
+            part.recommendations.erase(std::remove_if(part.recommendations.begin(),
+                                                      part.recommendations.end(), outside),
+                                       part.recommendations.end());
+            mergeReports(report, std::move(part));
+        }
+        if (any) ++analyzed;
+        else ++failed;
+        out << formatAnalysisReport(report) << "\n";
+        out.flush();
+    }
+
+    out << "=== ИТОГ ===\n";
+    out << "Измененных файлов: " << jobs.size() << ", проанализировано: " << analyzed
+        << ", с ошибкой: " << failed << ", пропущено: " << skipped << "\n";
+    out << std::fixed << std::setprecision(1);
+    if (total_bytes > 0) {
+        out << "Отправлено модели: " << sent_lines << " из " << total_lines << " строк, "
+            << sent_bytes << " из " << total_bytes << " байт ("
+            << 100.0 * sent_bytes / total_bytes << "%), фрагментов: " << total_regions << "\n";
+    }
+    out << std::setprecision(2) << "Время: " << wall << " с, параллельных запросов: " << threads << "\n";
+    out << std::defaultfloat;
+    return failed == 0;
+}
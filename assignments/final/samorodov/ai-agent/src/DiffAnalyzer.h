@@ -0,0 +1,35 @@
+#pragma once
+#include "SourceChunker.h"
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class AiAgent;
+
+// Изменения одного файла из `git diff -U0`, в номерах строк новой версии
+struct FileDiff {
+    std::string path;               // путь от корня репозитория
+    std::vector<LineSpan> changed;  // по порядку строк
+};
+
+// Разбор unified diff (лучше с -U0 и --no-prefix; префиксы a/ b/ тоже
+// понимаются). Удаленные и двоичные файлы пропускаются
+std::vector<FileDiff> parseUnifiedDiff(std::string_view diff);
+
+// Параметры analyze --diff
+struct DiffAnalysisOptions {
+    std::string range;              // "main..HEAD", "HEAD~3", пусто — незакоммиченные изменения
+    std::string repo = ".";         // каталог внутри репозитория
+    std::string language = "auto";
+    unsigned jobs = 4;              // одновременных запросов к модели
+    size_t context_lines = 3;       // окно вокруг изменения внутри огромной функции
+};
+
+// Анализ только измененного кода: для каждого изменения модели отправляется
+// объемлющая функция (SourceChunker.h), а не весь файл. Новая версия файла
+// берется из второй ревизии диапазона, а без ".." — из рабочего каталога.
+// Номера строк в отчетах — строки новой версии файла.
+// false — git не отработал (err) или хотя бы один файл не проанализирован
+bool analyzeDiff(const AiAgent& agent, const DiffAnalysisOptions& opts,
+                 std::ostream& out, std::string* err = nullptr);
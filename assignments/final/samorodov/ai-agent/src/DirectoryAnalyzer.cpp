@@ -0,0 +1,369 @@
+#include "DirectoryAnalyzer.h"
+#include "AiAgent.h"
+#include "WorkStealingPool.h"
+#include "LanguageDetector.h"
+#include <fnmatch.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::vector<std::string> kDefaultInclude = {
+    "*.cpp", "*.cc", "*.cxx", "*.c", "*.hpp", "*.hh", "*.hxx", "*.h", "*.py",
+    "*.java", "*.js", "*.mjs", "*.jsx", "*.ts", "*.tsx", "*.go", "*.rs", "*.sh"
+};
+
+bool anyMatch(const std::vector<std::string>& patterns, const std::string& rel) {
+    for (const auto& p : patterns) {
+        if (globMatch(p, rel)) return true;
+    }
+    return false;
+}
+
+bool looksBinary(const std::string& data) {
+    return std::memchr(data.data(), '\0', std::min<size_t>(data.size(), 8192)) != nullptr;
+}
+
+struct FileReport {
+    // LOCAL — модель не спрашивали, но локальный проход что-то нашёл
+    enum Status { PENDING, OK, FAILED, SKIPPED, LOCAL };
+    Status status = PENDING;
+    std::string language;
+    std::string text;      // ответ модели или причина ошибки/пропуска
+    double seconds = 0;    // время запросов к модели
+    size_t chunks = 1;
+    bool by_prepass = false;   // пропущен локальным проходом
+};
+
+// Файл, который уже прочитан и ждёт ответов по фрагментам
+struct FileJob {
+    std::string code;
+    std::string language;
+    PrepassResult prepass;
+    std::vector<SourceChunk> chunks;
+    std::vector<std::string> responses;
+    std::vector<std::string> errors;
+    std::atomic<size_t> remaining{0};
+    std::chrono::steady_clock::time_point started;
+};
+
+}
+
+bool globMatch(const std::string& pattern, const std::string& rel_path) {
+    if (fnmatch(pattern.c_str(), rel_path.c_str(), 0) == 0) return true;
+    if (pattern.find('/') != std::string::npos) return false;
+    auto slash = rel_path.rfind('/');
+    return slash != std::string::npos &&
+           fnmatch(pattern.c_str(), rel_path.c_str() + slash + 1, 0) == 0;
+}
+
+bool acceptsSourcePath(const std::string& rel_path, const DirAnalysisOptions& opts) {
+    size_t start = 0;
+    for (;;) {
+        const size_t slash = rel_path.find('/', start);
+        if (rel_path[start] == '.') return false;
+        const std::string prefix = rel_path.substr(0, slash);
+        if (anyMatch(opts.exclude, prefix)) return false;
+        if (slash == std::string::npos) break;
+        start = slash + 1;
+    }
+    return anyMatch(opts.include.empty() ? kDefaultInclude : opts.include, rel_path);
+}
+
+std::vector<SourceFile> collectSourceFiles(const std::string& root,
+                                           const DirAnalysisOptions& opts,
+                                           std::string* err) {
+    std::vector<SourceFile> files;
+    const fs::path base(root);
+    std::error_code ec;
+    if (!fs::is_directory(base, ec)) {
+        if (err) *err = "Не каталог: " + root;
+        return files;
+    }
+
+    const auto& include = opts.include.empty() ? kDefaultInclude : opts.include;
+    fs::recursive_directory_iterator it(base, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        if (err) *err = "Не удалось открыть " + root + ": " + ec.message();
+        return files;
+    }
+
+    for (const fs::recursive_directory_iterator end; it != end; it.increment(ec)) {
+        if (ec) {
+            std::cerr << "Предупреждение: обход прерван: " << ec.message() << "\n";
+            break;
+        }
+        const fs::directory_entry& entry = *it;
+        const std::string rel = entry.path().lexically_relative(base).generic_string();
+        const bool is_dir = entry.is_directory(ec);
+
+        if (entry.path().filename().string().front() == '.' || anyMatch(opts.exclude, rel)) {
+            if (is_dir) it.disable_recursion_pending();
+            continue;
+        }
+        if (is_dir || !entry.is_regular_file(ec) || !anyMatch(include, rel)) continue;
+
+        SourceFile f;
+        f.path = entry.path();
+        f.rel = rel;
+        f.size = entry.file_size(ec);
+        if (ec) continue;
+        files.push_back(std::move(f));
+    }
+
+    std::sort(files.begin(), files.end(),
+              [](const SourceFile& a, const SourceFile& b) { return a.rel < b.rel; });
+    return files;
+}
+
+bool analyzeDirectory(const AiAgent& agent, const std::string& root,
+                      const DirAnalysisOptions& opts, std::ostream& out,
+                      std::string* err) {
+    std::string walk_err;
+    const std::vector<SourceFile> files = collectSourceFiles(root, opts, &walk_err);
+    if (!walk_err.empty()) {
+        if (err) *err = walk_err;
+        return false;
+    }
+    if (files.empty()) {
+        out << "Подходящих файлов не найдено в " << root << "\n";
+        return true;
+    }
+
+    const size_t total = files.size();
+    const unsigned jobs = (unsigned)std::max<size_t>(1, std::min<size_t>(opts.jobs, total));
+    out << "Найдено файлов: " << total << ", параллельных запросов: " << jobs << "\n\n";
+
+    std::vector<FileReport> reports(total);
+    std::mutex reports_m;
+    std::condition_variable ready_cv;
+
+    auto finish = [&](size_t i, FileReport r) {
+        {
+            std::lock_guard<std::mutex> lock(reports_m);
+            reports[i] = std::move(r);
+        }
+        ready_cv.notify_all();
+    };
+
+    // Чтение, фильтры и план фрагментов. nullptr — файл уже решён (r заполнен)
+    auto prepare = [&](size_t i, FileReport& r) -> std::shared_ptr<FileJob> {
+        const SourceFile& f = files[i];
+        r.status = FileReport::SKIPPED;
+        if (f.size == 0) {
+            r.text = "пустой файл";
+            return nullptr;
+        }
+        if (f.size > opts.max_file_bytes) {
+            r.text = "больше " + std::to_string(opts.max_file_bytes) + " байт";
+            return nullptr;
+        }
+
+        auto job = std::make_shared<FileJob>();
+        std::string read_err;
+        if (!AiAgent::readWholeFile(f.path.string(), job->code, &read_err)) {
+            r.status = FileReport::FAILED;
+            r.text = read_err;
+            return nullptr;
+        }
+        if (looksBinary(job->code)) {
+            r.text = "двоичный файл";
+            return nullptr;
+        }
+
+        const LanguageGuess guess = detectSourceLanguage(job->code, f.rel);
+        job->language = guess.language;
+        if (job->language == "auto") {
+            r.text = "язык не определен";
+            return nullptr;
+        }
+        if (opts.language != "any" && job->language != opts.language) {
+            r.text = "язык " + job->language;
+            return nullptr;
+        }
+
+        // Локальный проход: тривиальные, сгенерированные и сторонние файлы
+        // к модели не отправляются
+        job->prepass = runPrepass(job->code, job->language, f.rel, agent.prepassRules());
+        if (job->prepass.decision == PrepassDecision::Skip) {
+            const AnalysisReport& found = job->prepass.findings;
+            r.by_prepass = true;
+            r.language = job->language;
+            if (found.errors.empty() && found.recommendations.empty()) {
+                r.text = job->prepass.reason;
+            } else {
+                r.status = FileReport::LOCAL;
+                r.text = localOnlyReport(job->prepass);
+            }
+            return nullptr;
+        }
+
+        job->chunks = agent.planChunks(job->code, job->language);
+        job->responses.resize(job->chunks.size());
+        job->errors.resize(job->chunks.size());
+        job->remaining = job->chunks.size();
+        return job;
+    };
+
+    // Запрос по одному фрагменту; последний завершившийся склеивает отчёт
+    auto runChunk = [&](size_t i, FileJob& job, size_t k) {
+        try {
+            if (auto resp = agent.analyzeChunk(job.code, job.chunks, k, job.language, &job.errors[k])) {
+                job.responses[k] = std::move(*resp);
+            }
+        } catch (const std::exception& e) {
+            job.errors[k] = e.what();
+        }
+        if (job.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        FileReport r;
+        r.language = job.language;
+        r.chunks = job.chunks.size();
+        r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.started).count();
+        std::string merge_err;
+        if (auto text = AiAgent::finishChunks(job.chunks, job.responses, job.errors, &merge_err)) {
+            r.status = FileReport::OK;
+            r.text = addLocalFindings(*text, job.prepass.findings);
+        } else {
+            r.status = FileReport::FAILED;
+            r.text = merge_err;
+        }
+        finish(i, std::move(r));
+    };
+
+    const auto started = std::chrono::steady_clock::now();
+    WorkStealingPool pool(jobs);
+
+    // Фаза 1: чтение, определение языка и локальный проход — параллельно и
+    // без запросов к модели
+    std::vector<std::shared_ptr<FileJob>> pending(total);
+    for (size_t i = 0; i < total; ++i) {
+        pool.submit([&, i] {
+            FileReport r;
+            try {
+                pending[i] = prepare(i, r);
+            } catch (const std::exception& e) {
+                r.status = FileReport::FAILED;
+                r.text = e.what();
+            }
+            if (!pending[i]) finish(i, std::move(r));
+        });
+    }
+    pool.wait();
+
+    // Фаза 2: запросы к модели. Сначала большие файлы — самые долгие запросы
+    // начинаются раньше и не растягивают хвост; простые файлы — в конце
+    std::vector<size_t> queue;
+    size_t deferred = 0;
+    for (size_t i = 0; i < total; ++i) {
+        if (!pending[i]) continue;
+        queue.push_back(i);
+        if (pending[i]->prepass.decision == PrepassDecision::LowPriority) ++deferred;
+    }
+    std::stable_sort(queue.begin(), queue.end(), [&](size_t a, size_t b) {
+        const bool low_a = pending[a]->prepass.decision == PrepassDecision::LowPriority;
+        const bool low_b = pending[b]->prepass.decision == PrepassDecision::LowPriority;
+        if (low_a != low_b) return low_b;
+        return files[a].size > files[b].size;
+    });
+    for (size_t i : queue) {
+        std::shared_ptr<FileJob> job = std::move(pending[i]);
+        pool.submit([&, i, job] {
+            job->started = std::chrono::steady_clock::now();
+            if (job->chunks.size() == 1) {
+                runChunk(i, *job, 0);
+                return;
+            }
+            // Фрагменты большого файла — отдельные задачи того же пула: их
+            // подхватят простаивающие потоки, а --jobs остаётся общим пределом.
+            // Подзадачи встают в голову очереди, поэтому отправляем с конца
+            for (size_t k = job->chunks.size(); k-- > 0;) {
+                pool.submit([&, i, job, k] { runChunk(i, *job, k); });
+            }
+        });
+    }
+
+    // Отчёты печатаются в порядке путей: ждём очередной, даже если
+    // следующие уже готовы
+    size_t analyzed = 0, failed = 0, skipped = 0, local = 0;
+    uintmax_t analyzed_bytes = 0;
+    for (size_t i = 0; i < total; ++i) {
+        FileReport r;
+        {
+            std::unique_lock<std::mutex> lock(reports_m);
+            ready_cv.wait(lock, [&] { return reports[i].status != FileReport::PENDING; });
+            r = std::move(reports[i]);
+            reports[i].status = r.status;
+            reports[i].seconds = r.seconds;
+            reports[i].by_prepass = r.by_prepass;
+        }
+
+        const SourceFile& f = files[i];
+        if (r.by_prepass) ++local;
+        if (r.status == FileReport::SKIPPED) {
+            ++skipped;
+            continue;
+        }
+        out << "=== [" << (i + 1) << "/" << total << "] " << f.rel;
+        if (r.status == FileReport::LOCAL) {
+            ++skipped;
+            out << " (" << languageDisplayName(r.language) << ", " << f.size << " байт, без модели) ===\n"
+                << r.text << "\n";
+        } else if (r.status == FileReport::OK) {
+            ++analyzed;
+            analyzed_bytes += f.size;
+            out << " (" << languageDisplayName(r.language) << ", " << f.size << " байт, ";
+            if (r.chunks > 1) out << r.chunks << " фрагм., ";
+            out << std::fixed << std::setprecision(1) << r.seconds << " с) ===\n"
+                << r.text << "\n\n";
+        } else {
+            ++failed;
+            out << " ===\nОшибка анализа: " << r.text << "\n\n";
+        }
+        out.flush();
+    }
+    pool.wait();
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    out << "=== ИТОГ ===\n";
+    out << "Файлов: " << total << ", проанализировано: " << analyzed
+        << ", с ошибкой: " << failed << ", пропущено: " << skipped << "\n";
+    out << "Без запроса к модели (локальный проход): " << local
+        << ", простых файлов в конце очереди: " << deferred << "\n";
+    out << std::fixed << std::setprecision(2);
+    out << "Время: " << wall << " с, параллельных запросов: " << jobs << "\n";
+    if (wall > 0) {
+        out << "Пропускная способность: " << analyzed / wall << " файлов/с, "
+            << analyzed_bytes / wall / 1024.0 << " КБ/с (" << analyzed_bytes << " байт)\n";
+    }
+
+    // Самые долгие запросы — кандидаты на разбиение или исключение
+    std::vector<size_t> order;
+    for (size_t i = 0; i < total; ++i) {
+        if (reports[i].status == FileReport::OK) order.push_back(i);
+    }
+    const size_t top = std::min(opts.slowest, order.size());
+    std::partial_sort(order.begin(), order.begin() + top, order.end(), [&](size_t a, size_t b) {
+        return reports[a].seconds > reports[b].seconds;
+    });
+    if (top > 0) {
+        out << "Самые долгие файлы:\n";
+        for (size_t k = 0; k < top; ++k) {
+            const size_t i = order[k];
+            out << "  " << std::setw(7) << reports[i].seconds << " с  "
+                << files[i].rel << " (" << files[i].size << " байт)\n";
+        }
+    }
+    out << std::defaultfloat;
+
+    return failed == 0;
+}
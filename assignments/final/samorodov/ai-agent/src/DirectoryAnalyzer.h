@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class AiAgent;
+
+// Параметры analyze-dir
+struct DirAnalysisOptions {
+    // Glob'ы (fnmatch) по пути относительно корня или по имени файла.
+    // Пустой include — обычные расширения исходников (LanguageDetector.h)
+    std::vector<std::string> include;
+    std::vector<std::string> exclude;   // и для файлов, и для каталогов
+    std::string language = "any";       // id языка (LanguageDetector.h) или any
+    unsigned jobs = 4;                  // одновременных запросов к модели
+    uintmax_t max_file_bytes = 256 * 1024;
+    size_t slowest = 5;                 // сколько самых долгих файлов показать
+};
+
+// Файл, найденный обходом каталога
+struct SourceFile {
+    std::filesystem::path path;
+    std::string rel;        // путь от корня, через '/'
+    uintmax_t size = 0;
+};
+
+// Совпадение glob'а с путём: шаблон без '/' сверяется и с именем файла,
+// '*' совпадает и с '/', так что "src/*.cpp" захватывает подкаталоги
+bool globMatch(const std::string& pattern, const std::string& rel_path);
+
+// Тот же фильтр, что у collectSourceFiles, для одного пути от корня:
+// скрытые и исключенные каталоги по пути, include/exclude для файла
+bool acceptsSourcePath(const std::string& rel_path, const DirAnalysisOptions& opts);
+
+// Рекурсивный обход root. Скрытые файлы и каталоги (".git") пропускаются,
+// исключённые каталоги не обходятся вовсе. Результат отсортирован по rel
+std::vector<SourceFile> collectSourceFiles(const std::string& root,
+                                           const DirAnalysisOptions& opts,
+                                           std::string* err = nullptr);
+
+// Анализ каталога: сначала все файлы проходят локальный проход
+// (StaticPrepass.h) — тривиальные, сгенерированные и сторонние к модели не
+// отправляются; остальные отправляются параллельно (WorkStealingPool), от
+// больших к маленьким, простые — в конце. Отчёты печатаются в out по порядку
+// путей по мере готовности, в конце — сводка с пропускной способностью и
+// самыми долгими файлами.
+// false — обход не удался (err) или хотя бы один файл не проанализирован
+bool analyzeDirectory(const AiAgent& agent, const std::string& root,
+                      const DirAnalysisOptions& opts, std::ostream& out,
+                      std::string* err = nullptr);
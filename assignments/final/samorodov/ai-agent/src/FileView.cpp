@@ -0,0 +1,135 @@
+#include "FileView.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Закрывает дескриптор на любом выходе
+struct Fd {
+    int fd;
+    ~Fd() { if (fd >= 0) ::close(fd); }
+};
+
+bool fail(std::string* err, const std::string& what, const std::string& path) {
+    if (err) *err = what + ": " + path + " (" + std::strerror(errno) + ")";
+    return false;
+}
+
+// Дочитать fd до конца в out, начиная с out.size()
+bool readRest(int fd, std::string& out) {
+    size_t used = out.size();
+    for (;;) {
+        if (out.size() - used < 16 * 1024) out.resize(std::max<size_t>(64 * 1024, out.size() * 2));
+        const ssize_t n = ::read(fd, &out[used], out.size() - used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) break;
+        used += (size_t)n;
+    }
+    out.resize(used);
+    return true;
+}
+
+// Обычный файл известного размера: строка сразу нужной длины. Файл мог
+// вырасти после fstat — конец проверяется чтением в буфер на стеке, и
+// только если там что-то есть, остаток дочитывается в строку
+bool readSized(int fd, size_t size, std::string& out) {
+    out.resize(size);
+    size_t used = 0;
+    while (used < size) {
+        const ssize_t n = ::read(fd, &out[used], size - used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) {
+            out.resize(used);   // укоротили
+            return true;
+        }
+        used += (size_t)n;
+    }
+    char probe[4096];
+    for (;;) {
+        const ssize_t n = ::read(fd, probe, sizeof(probe));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) return true;
+        out.append(probe, (size_t)n);
+        return readRest(fd, out);
+    }
+}
+
+bool readFd(int fd, const struct stat& st, std::string& out) {
+    out.clear();
+    if (S_ISREG(st.st_mode)) return readSized(fd, (size_t)st.st_size, out);
+    return readRest(fd, out);
+}
+
+}
+
+FileView::~FileView() {
+    reset();
+}
+
+FileView::FileView(FileView&& other) noexcept {
+    *this = std::move(other);
+}
+
+FileView& FileView::operator=(FileView&& other) noexcept {
+    if (this == &other) return *this;
+    reset();
+    map_ = other.map_;
+    size_ = other.size_;
+    buffer_ = std::move(other.buffer_);
+    data_ = map_ ? static_cast<const char*>(map_) : buffer_.data();
+    other.map_ = nullptr;
+    other.data_ = "";
+    other.size_ = 0;
+    return *this;
+}
+
+void FileView::reset() {
+    if (map_) ::munmap(map_, size_);
+    map_ = nullptr;
+    data_ = "";
+    size_ = 0;
+    buffer_.clear();
+}
+
+bool FileView::open(const std::string& path, std::string* err) {
+    reset();
+    Fd f{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (f.fd < 0) return fail(err, "Cannot open file", path);
+    struct stat st;
+    if (::fstat(f.fd, &st) != 0) return fail(err, "Cannot stat file", path);
+
+    if (S_ISREG(st.st_mode) && (size_t)st.st_size >= kMapThreshold) {
+        void* p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, f.fd, 0);
+        if (p != MAP_FAILED) {
+            // Файл читается один раз от начала до конца
+            ::madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            map_ = p;
+            data_ = static_cast<const char*>(p);
+            size_ = (size_t)st.st_size;
+            return true;
+        }
+        // Например, файловая система без mmap — читаем как обычно
+    }
+
+    if (!readFd(f.fd, st, buffer_)) return fail(err, "Cannot read file", path);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
+
+bool FileView::readAll(const std::string& path, std::string& out, std::string* err) {
+    Fd f{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (f.fd < 0) return fail(err, "Cannot open file", path);
+    struct stat st;
+    if (::fstat(f.fd, &st) != 0) return fail(err, "Cannot stat file", path);
+    if (!readFd(f.fd, st, out)) return fail(err, "Cannot read file", path);
+    return true;
+}
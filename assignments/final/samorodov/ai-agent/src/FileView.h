@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Содержимое файла без копий через потоки.
+//
+// Обычный файл от kMapThreshold байт отображается в память (mmap) и
+// читается прямо со страниц кэша ядра; маленький файл, канал, /dev/stdin
+// и прочие специальные файлы, а также файл, который не удалось отобразить,
+// читаются read() в собственный буфер. view() действителен, пока жив
+// FileView.
+//
+// Если файл укоротить, пока он отображен, обращение к пропавшим страницам
+// завершит процесс по SIGBUS. Поэтому отображается только файл одного
+// analyze; analyze-dir, --diff и --watch анализируют файлы дольше, пока их
+// правят, и читают копию (readAll).
+class FileView {
+public:
+    // Меньше этого mmap дороже, чем один read()
+    static constexpr size_t kMapThreshold = 64 * 1024;
+
+    FileView() = default;
+    ~FileView();
+    FileView(FileView&& other) noexcept;
+    FileView& operator=(FileView&& other) noexcept;
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    bool open(const std::string& path, std::string* err = nullptr);
+
+    std::string_view view() const { return {data_, size_}; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool mapped() const { return map_ != nullptr; }
+
+    // Весь файл в out одним read() в строку нужного размера (для файлов,
+    // которые нужны строкой: конфиг, файлы каталога); каналы — блоками
+    static bool readAll(const std::string& path, std::string& out, std::string* err = nullptr);
+
+private:
+    void reset();
+
+    const char* data_ = "";
+    size_t size_ = 0;
+    void* map_ = nullptr;
+    std::string buffer_;
+};
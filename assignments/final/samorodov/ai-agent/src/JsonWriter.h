@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// Потоковая запись тела запроса к модели без json-DOM.
+//
+// Скелет запроса пишется как есть, а строки (промпт, содержимое файла)
+// экранируются за один проход: SIMD-сканер ищет ближайший символ, который
+// нужно экранировать ('"', '\\', управляющие < 0x20), и всё, что до него,
+// копируется одним блоком. Вывод совпадает с json::dump() по умолчанию
+// (UTF-8 как есть, \uXXXX только для управляющих символов). Некорректный
+// UTF-8 не проверяется и уходит как есть — dump() на нём бросает исключение.
+namespace json_writer {
+
+enum class Simd { Scalar, SSE2, AVX2 };
+
+// Лучший вариант для текущего процессора (определяется один раз)
+Simd detectSimd();
+const char* simdName(Simd simd);
+
+// Дописать s в out как содержимое JSON-строки (без кавычек)
+void appendEscaped(std::string& out, std::string_view s);
+void appendEscaped(std::string& out, std::string_view s, Simd simd);
+
+// Объект/массив пишутся в буфер, который переиспользуется между запросами:
+// конструктор очищает его, но ёмкость остаётся.
+class Writer {
+public:
+    explicit Writer(std::string& out, size_t reserve = 0);
+
+    Writer& beginObject(std::string_view key = {});
+    Writer& endObject();
+    Writer& beginArray(std::string_view key = {});
+    Writer& endArray();
+
+    Writer& field(std::string_view key, std::string_view value);
+    Writer& field(std::string_view key, const char* value) { return field(key, std::string_view(value)); }
+    Writer& field(std::string_view key, int64_t value);
+    Writer& field(std::string_view key, int value) { return field(key, (int64_t)value); }
+    Writer& field(std::string_view key, double value);
+    Writer& field(std::string_view key, bool value);
+    // Готовый JSON (схема ответа и т.п.) вставляется без проверки
+    Writer& rawField(std::string_view key, std::string_view json);
+
+private:
+    void separator(std::string_view key);
+
+    std::string& out_;
+    bool first_ = true;   // в текущем контейнере ещё нет элементов
+};
+
+}
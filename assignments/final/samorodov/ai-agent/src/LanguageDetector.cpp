@@ -0,0 +1,344 @@
+#include "LanguageDetector.h"
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+namespace {
+
+enum Lang { CPP, C, PYTHON, JAVA, JS, TS, GO, RUST, SHELL, LANG_COUNT };
+
+const char* const kIds[LANG_COUNT] = {
+    "cpp", "c", "python", "java", "javascript", "typescript", "go", "rust", "shell"
+};
+const char* const kNames[LANG_COUNT] = {
+    "C++", "C", "Python", "Java", "JavaScript", "TypeScript", "Go", "Rust", "Shell"
+};
+
+const size_t kMaxScan = 256 * 1024;
+const uint8_t kMaxHits = 5;        // сколько раз одна конструкция добавляет вес
+const float kExtensionWeight = 5;
+const float kShebangWeight = 8;
+const float kMinScore = 1.5f;      // меньше — язык не определён
+
+struct Weight {
+    Lang lang;
+    float w;
+};
+
+// Шаблоны, которые начинаются или кончаются буквой, совпадают только
+// целым словом с этой стороны ("def " не найдётся в "undef ")
+struct Feature {
+    const char* pattern;
+    Weight weights[3];
+};
+
+const Feature kFeatures[] = {
+    // C и C++
+    {"#include",        {{CPP, 2}, {C, 2}}},
+    {"#define",         {{CPP, 1}, {C, 1}}},
+    {"#ifndef",         {{CPP, 1}, {C, 1}}},
+    {"int main(",       {{CPP, 1}, {C, 1}}},
+    {"printf(",         {{C, 1.5f}, {CPP, 0.5f}}},
+    {"malloc(",         {{C, 2}, {CPP, 0.5f}}},
+    {"free(",           {{C, 1}, {CPP, 0.3f}}},
+    {"typedef ",        {{C, 1.5f}, {CPP, 0.5f}}},
+    {"sizeof(",         {{C, 1}, {CPP, 0.5f}}},
+    {"NULL",            {{C, 1}, {CPP, 0.5f}}},
+    {"std::",           {{CPP, 2}, {RUST, 0.5f}}},
+    {"using namespace", {{CPP, 3}}},
+    {"namespace ",      {{CPP, 2}}},
+    {"template<",       {{CPP, 2}}},
+    {"template <",      {{CPP, 2}}},
+    {"public:",         {{CPP, 2}}},
+    {"private:",        {{CPP, 2}}},
+    {"nullptr",         {{CPP, 3}}},
+    {"cout",            {{CPP, 2}}},
+    {"virtual ",        {{CPP, 2}}},
+    {"unique_ptr",      {{CPP, 2}}},
+    {"const auto&",     {{CPP, 2}}},
+    {"class ",          {{CPP, 0.5f}, {JAVA, 0.5f}, {PYTHON, 0.3f}}},
+    {"new ",            {{JAVA, 0.3f}, {JS, 0.3f}, {CPP, 0.3f}}},
+    {"->",              {{CPP, 0.3f}, {C, 0.3f}, {RUST, 0.5f}}},
+
+    // Python
+    {"def ",            {{PYTHON, 2}}},
+    {"elif ",           {{PYTHON, 3}}},
+    {"self.",           {{PYTHON, 2}}},
+    {"self,",           {{PYTHON, 1.5f}}},
+    {"__init__",        {{PYTHON, 3}}},
+    {"if __name__",     {{PYTHON, 3}}},
+    {"print(",          {{PYTHON, 1}}},
+    {"None",            {{PYTHON, 1.5f}, {RUST, 0.5f}}},
+    {"True",            {{PYTHON, 0.7f}}},
+    {"False",           {{PYTHON, 0.7f}}},
+    {"lambda ",         {{PYTHON, 1}}},
+    {"):\n",            {{PYTHON, 1}}},
+    {"import ",         {{PYTHON, 1}, {JAVA, 1}, {JS, 0.5f}}},
+    {"from ",           {{PYTHON, 0.5f}, {JS, 0.3f}, {TS, 0.3f}}},
+
+    // Java
+    {"public class",    {{JAVA, 3}}},
+    {"System.out",      {{JAVA, 3}}},
+    {"public static void main", {{JAVA, 3}}},
+    {"import java.",    {{JAVA, 3}}},
+    {"@Override",       {{JAVA, 3}}},
+    {"private final",   {{JAVA, 1.5f}}},
+    {"String[]",        {{JAVA, 1.5f}}},
+    {"package ",        {{JAVA, 1.5f}, {GO, 1.5f}}},
+    {"extends ",        {{JAVA, 1}, {TS, 0.7f}, {JS, 0.5f}}},
+    {"implements ",     {{JAVA, 1.5f}, {TS, 1}}},
+    {"private ",        {{JAVA, 1}, {TS, 0.5f}}},
+
+    // JavaScript / TypeScript
+    {"function ",       {{JS, 1.5f}, {TS, 1}, {SHELL, 0.3f}}},
+    {"const ",          {{JS, 0.7f}, {TS, 0.7f}, {CPP, 0.2f}}},
+    {"let ",            {{JS, 1}, {TS, 1}, {RUST, 1}}},
+    {"var ",            {{JS, 1}, {TS, 0.5f}, {GO, 0.5f}}},
+    {"=>",              {{JS, 1}, {TS, 1}, {RUST, 0.5f}}},
+    {"console.log",     {{JS, 2}, {TS, 1.5f}}},
+    {"require(",        {{JS, 2}}},
+    {"module.exports",  {{JS, 3}}},
+    {"document.",       {{JS, 2}, {TS, 1}}},
+    {"===",             {{JS, 1.5f}, {TS, 1.5f}}},
+    {"!==",             {{JS, 1.5f}, {TS, 1.5f}}},
+    {"undefined",       {{JS, 1.5f}, {TS, 1}}},
+    {"export ",         {{JS, 1}, {TS, 1}, {SHELL, 1}}},
+    {"async ",          {{JS, 0.5f}, {TS, 0.5f}, {PYTHON, 0.5f}}},
+    {"interface ",      {{TS, 2}, {JAVA, 0.7f}, {GO, 0.5f}}},
+    {": string",        {{TS, 3}}},
+    {": number",        {{TS, 3}}},
+    {": boolean",       {{TS, 2}}},
+    {"readonly ",       {{TS, 1.5f}}},
+    {"import type",     {{TS, 3}}},
+    {"as const",        {{TS, 2}}},
+
+    // Go
+    {"package main",    {{GO, 3}}},
+    {"func ",           {{GO, 2}}},
+    {":=",              {{GO, 2}}},
+    {"fmt.",            {{GO, 3}}},
+    {"go func",         {{GO, 3}}},
+    {"chan ",           {{GO, 2}}},
+    {"defer ",          {{GO, 2}}},
+    {"err != nil",      {{GO, 3}}},
+    {"interface{",      {{GO, 2}}},
+    {"import (",        {{GO, 2}}},
+    {"const (",         {{GO, 2}}},
+    {"var (",           {{GO, 2}}},
+    {"//go:",           {{GO, 3}}},
+
+    // Rust
+    {"fn ",             {{RUST, 2}}},
+    {"let mut ",        {{RUST, 3}}},
+    {"impl ",           {{RUST, 2.5f}}},
+    {"pub fn",          {{RUST, 3}}},
+    {"use std::",       {{RUST, 3}}},
+    {"&mut ",           {{RUST, 2}}},
+    {"match ",          {{RUST, 1}, {PYTHON, 0.3f}}},
+    {"println!",        {{RUST, 3}}},
+    {"Option<",         {{RUST, 1.5f}}},
+    {"Result<",         {{RUST, 1.5f}}},
+    {"unwrap()",        {{RUST, 2.5f}}},
+    {"#[derive",        {{RUST, 3}}},
+    {"crate::",         {{RUST, 3}}},
+
+    // Shell
+    {"fi",              {{SHELL, 2}}},
+    {"then",            {{SHELL, 1.5f}}},
+    {"esac",            {{SHELL, 3}}},
+    {"done",            {{SHELL, 1}}},
+    {"echo ",           {{SHELL, 1.5f}}},
+    {"$(",              {{SHELL, 1.5f}}},
+    {"${",              {{SHELL, 1}, {JS, 0.5f}, {TS, 0.5f}}},
+    {"local ",          {{SHELL, 1}}},
+    {"[[ ",             {{SHELL, 2}}},
+    {"set -e",          {{SHELL, 3}}},
+    {" -eq ",           {{SHELL, 2}}},
+    {" -ne ",           {{SHELL, 2}}},
+};
+
+const size_t kFeatureCount = sizeof(kFeatures) / sizeof(kFeatures[0]);
+
+bool isIdent(char c) {
+    return std::isalnum((unsigned char)c) || c == '_';
+}
+
+// Детерминированный автомат Ахо–Корасик по шаблонам kFeatures. Байты, которых
+// нет ни в одном шаблоне, сведены в класс 0, поэтому таблица переходов — узлы
+// на число классов, а не на 256
+class Automaton {
+public:
+    Automaton() {
+        cls_.fill(0);
+        for (size_t p = 0; p < kFeatureCount; ++p) {
+            for (const char* c = kFeatures[p].pattern; *c; ++c) {
+                uint8_t& k = cls_[(unsigned char)*c];
+                if (k == 0) k = (uint8_t)++classes_;
+            }
+        }
+        ++classes_;   // класс 0
+
+        // Бор
+        addNode();
+        for (size_t p = 0; p < kFeatureCount; ++p) {
+            int node = 0;
+            for (const char* c = kFeatures[p].pattern; *c; ++c) {
+                int& next = delta_[node * classes_ + cls_[(unsigned char)*c]];
+                if (next < 0) {
+                    int created = addNode();
+                    delta_[node * classes_ + cls_[(unsigned char)*c]] = created;
+                    node = created;
+                } else {
+                    node = next;
+                }
+            }
+            out_[node] = (int)p;
+        }
+
+        // Суффиксные ссылки в ширину; недостающие переходы берутся у суффикса
+        std::vector<int> fail(out_.size(), 0);
+        std::queue<int> q;
+        for (int c = 0; c < classes_; ++c) {
+            int& next = delta_[c];
+            if (next < 0) next = 0;
+            else q.push(next);
+        }
+        while (!q.empty()) {
+            int u = q.front();
+            q.pop();
+            for (int c = 0; c < classes_; ++c) {
+                int v = delta_[u * classes_ + c];
+                if (v < 0) {
+                    delta_[u * classes_ + c] = delta_[fail[u] * classes_ + c];
+                    continue;
+                }
+                fail[v] = delta_[fail[u] * classes_ + c];
+                link_[v] = out_[fail[v]] >= 0 ? fail[v] : link_[fail[v]];
+                q.push(v);
+            }
+        }
+    }
+
+    // on_match(индекс шаблона, позиция за последним символом совпадения)
+    template <class F>
+    void scan(std::string_view text, F&& on_match) const {
+        int state = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            state = delta_[state * classes_ + cls_[(unsigned char)text[i]]];
+            for (int n = out_[state] >= 0 ? state : link_[state]; n >= 0; n = link_[n]) {
+                on_match(out_[n], i + 1);
+            }
+        }
+    }
+
+private:
+    int addNode() {
+        delta_.resize(delta_.size() + classes_, -1);
+        out_.push_back(-1);
+        link_.push_back(-1);
+        return (int)out_.size() - 1;
+    }
+
+    std::array<uint8_t, 256> cls_;
+    int classes_ = 0;
+    std::vector<int> delta_;
+    std::vector<int> out_;    // шаблон, который кончается в узле, или -1
+    std::vector<int> link_;   // ближайший по суффиксным ссылкам узел с шаблоном
+};
+
+const Automaton& automaton() {
+    static const Automaton instance;
+    return instance;
+}
+
+void extensionHint(std::string_view filename, float score[LANG_COUNT]) {
+    size_t dot = filename.rfind('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) return;
+    std::string ext(filename.substr(dot + 1));
+    for (auto& c : ext) c = (char)std::tolower((unsigned char)c);
+
+    struct Hint { const char* ext; Lang lang; };
+    static const Hint hints[] = {
+        {"cpp", CPP}, {"cc", CPP}, {"cxx", CPP}, {"hpp", CPP}, {"hh", CPP}, {"hxx", CPP},
+        {"c", C}, {"py", PYTHON}, {"pyw", PYTHON}, {"java", JAVA},
+        {"js", JS}, {"mjs", JS}, {"cjs", JS}, {"jsx", JS},
+        {"ts", TS}, {"tsx", TS}, {"mts", TS}, {"go", GO}, {"rs", RUST},
+        {"sh", SHELL}, {"bash", SHELL}, {"zsh", SHELL},
+    };
+    if (ext == "h") {   // C или C++ — решит содержимое, при равенстве C++
+        score[CPP] += kExtensionWeight / 2;
+        score[C] += kExtensionWeight / 2;
+        return;
+    }
+    for (const auto& h : hints) {
+        if (ext == h.ext) {
+            score[h.lang] += kExtensionWeight;
+            return;
+        }
+    }
+}
+
+void shebangHint(std::string_view code, float score[LANG_COUNT]) {
+    if (code.substr(0, 2) != "#!") return;
+    std::string_view line = code.substr(0, code.find('\n'));
+    auto has = [&line](const char* what) { return line.find(what) != std::string_view::npos; };
+    if (has("python")) score[PYTHON] += kShebangWeight;
+    else if (has("ts-node") || has("deno")) score[TS] += kShebangWeight;
+    else if (has("node")) score[JS] += kShebangWeight;
+    else if (has("sh")) score[SHELL] += kShebangWeight;   // sh, bash, zsh, dash, ksh
+}
+
+}
+
+LanguageGuess detectSourceLanguage(std::string_view code, std::string_view filename) {
+    float score[LANG_COUNT] = {};
+    extensionHint(filename, score);
+    shebangHint(code, score);
+
+    const std::string_view text = code.substr(0, kMaxScan);
+    uint8_t hits[kFeatureCount] = {};
+    automaton().scan(text, [&](int p, size_t end) {
+        const Feature& f = kFeatures[p];
+        const size_t len = std::strlen(f.pattern);
+        const size_t start = end - len;
+        if (isIdent(f.pattern[0]) && start > 0 && isIdent(text[start - 1])) return;
+        if (isIdent(f.pattern[len - 1]) && end < text.size() && isIdent(text[end])) return;
+        if (hits[p] >= kMaxHits) return;
+        ++hits[p];
+        for (const Weight& w : f.weights) score[w.lang] += w.w;
+    });
+
+    int best = 0;
+    for (int l = 1; l < LANG_COUNT; ++l) {
+        if (score[l] > score[best]) best = l;
+    }
+    float second = 0;
+    for (int l = 0; l < LANG_COUNT; ++l) {
+        if (l != best && score[l] > second) second = score[l];
+    }
+
+    LanguageGuess guess;
+    if (score[best] < kMinScore) return guess;
+    guess.language = kIds[best];
+    // 2 — «априорная масса»: пара слабых признаков не даёт уверенности
+    guess.confidence = score[best] / (score[best] + second + 2.0);
+    return guess;
+}
+
+std::string languageDisplayName(const std::string& language) {
+    for (int l = 0; l < LANG_COUNT; ++l) {
+        if (language == kIds[l]) return kNames[l];
+    }
+    return language;
+}
+
+bool isKnownLanguage(const std::string& language) {
+    for (const char* id : kIds) {
+        if (language == id) return true;
+    }
+    return false;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Определение языка исходника за один проход.
+//
+// Ключевые слова и характерные конструкции всех языков собраны в один
+// автомат Ахо–Корасик: текст читается один раз, без копии и без перевода в
+// нижний регистр, каждое совпадение добавляет вес своим языкам (одна
+// конструкция учитывается не больше нескольких раз). К весам добавляются
+// подсказки: расширение файла и строка #! в начале.
+//
+// Языки: "cpp", "c", "python", "java", "javascript", "typescript", "go",
+// "rust", "shell"; "auto" — не удалось определить.
+struct LanguageGuess {
+    std::string language = "auto";
+    double confidence = 0;   // 0..1: насколько лучший язык оторвался от остальных
+};
+
+// filename — путь или имя файла для подсказки по расширению (может быть пустым).
+// Смотрятся первые 256 КБ текста
+LanguageGuess detectSourceLanguage(std::string_view code, std::string_view filename = {});
+
+// "C++", "Python", ... для промпта и отчетов; неизвестный id возвращается как есть
+std::string languageDisplayName(const std::string& language);
+
+// Известен ли id языка (для проверки аргументов командной строки)
+bool isKnownLanguage(const std::string& language);
@@ -0,0 +1,241 @@
+#include "SessionArchive.h"
+#include <cstring>
+#include <openssl/evp.h>
+
+using nlohmann::json;
+
+namespace session_archive {
+
+namespace {
+const char kMagic[7] = {'A', 'I', 'S', 'E', 'S', 'S', '\0'};
+constexpr size_t kDigestSize = 32;
+// Защита от мусора вместо длины кадра
+constexpr uint32_t kMaxFrame = 256u * 1024 * 1024;
+
+void putLE(unsigned char* p, uint64_t v, int n) {
+    for (int i = 0; i < n; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+uint64_t getLE(const unsigned char* p, int n) {
+    uint64_t v = 0;
+    for (int i = 0; i < n; ++i) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+bool readExact(std::ifstream& in, void* data, size_t size) {
+    return static_cast<bool>(in.read(static_cast<char*>(data), static_cast<std::streamsize>(size)));
+}
+
+bool readMagic(std::ifstream& in, std::string* err) {
+    char head[sizeof(kMagic) + 1];
+    if (!readExact(in, head, sizeof(head)) || std::memcmp(head, kMagic, sizeof(kMagic)) != 0) {
+        if (err) *err = "Not a session archive";
+        return false;
+    }
+    if (static_cast<uint8_t>(head[sizeof(kMagic)]) != kFormatVersion) {
+        if (err) *err = "Unsupported session archive version " +
+                        std::to_string(static_cast<uint8_t>(head[sizeof(kMagic)]));
+        return false;
+    }
+    return true;
+}
+
+// Длина следующего кадра; 0 — начало окончания
+bool readLength(std::ifstream& in, uint32_t& len, std::string* err) {
+    unsigned char buf[4];
+    if (!readExact(in, buf, sizeof(buf))) {
+        if (err) *err = "Session archive is truncated";
+        return false;
+    }
+    len = static_cast<uint32_t>(getLE(buf, 4));
+    if (len > kMaxFrame) {
+        if (err) *err = "Session archive is corrupted (frame of " + std::to_string(len) + " bytes)";
+        return false;
+    }
+    return true;
+}
+}
+
+// ---------- Writer ----------
+
+Writer::Writer() : sha_(EVP_MD_CTX_new()) {}
+
+Writer::~Writer() {
+    EVP_MD_CTX_free(sha_);
+}
+
+bool Writer::writeRaw(const void* data, size_t size, bool hashed) {
+    if (hashed) EVP_DigestUpdate(sha_, data, size);
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    bytes_ += size;
+    return static_cast<bool>(out_);
+}
+
+bool Writer::writeFrame(const json& frame) {
+    const std::vector<uint8_t> cbor = json::to_cbor(frame);
+    unsigned char len[4];
+    putLE(len, cbor.size(), 4);
+    return writeRaw(len, sizeof(len)) && writeRaw(cbor.data(), cbor.size());
+}
+
+bool Writer::open(const std::string& path, json header, std::string* err) {
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        if (err) *err = "Cannot create file: " + path;
+        return false;
+    }
+    EVP_DigestInit_ex(sha_, EVP_sha256(), nullptr);
+    count_ = bytes_ = 0;
+    pending_ = json::array();
+
+    const uint8_t version = kFormatVersion;
+    if (!writeRaw(kMagic, sizeof(kMagic)) || !writeRaw(&version, 1) || !writeFrame(header)) {
+        if (err) *err = "Cannot write file: " + path;
+        return false;
+    }
+    return true;
+}
+
+bool Writer::flushChunk() {
+    if (pending_.empty()) return true;
+    const bool ok = writeFrame(pending_);
+    pending_ = json::array();
+    return ok;
+}
+
+bool Writer::add(json record, std::string* err) {
+    pending_.push_back(std::move(record));
+    ++count_;
+    if (pending_.size() >= kChunkRecords && !flushChunk()) {
+        if (err) *err = "Cannot write session archive";
+        return false;
+    }
+    return true;
+}
+
+bool Writer::finish(std::string* err) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    bool ok = flushChunk();
+    EVP_DigestFinal_ex(sha_, digest, &digest_len);
+
+    unsigned char tail[4 + 8];
+    putLE(tail, 0, 4);
+    putLE(tail + 4, count_, 8);
+    ok = ok && writeRaw(tail, sizeof(tail), false) && writeRaw(digest, digest_len, false);
+    out_.close();
+    if (!ok || !out_) {
+        if (err) *err = "Cannot write session archive";
+        return false;
+    }
+    return true;
+}
+
+// ---------- Reader ----------
+
+bool Reader::verify(const std::string& path, std::string* err, uint64_t* records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        if (err) *err = "Cannot open file: " + path;
+        return false;
+    }
+    if (!readMagic(in, err)) return false;
+
+    EVP_MD_CTX* sha = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(sha, EVP_sha256(), nullptr);
+    EVP_DigestUpdate(sha, kMagic, sizeof(kMagic));
+    EVP_DigestUpdate(sha, &kFormatVersion, 1);
+
+    std::vector<char> buf;
+    bool ok = false;
+    uint64_t frames = 0;
+    uint32_t len = 0;
+    while (readLength(in, len, err)) {
+        if (len == 0) {
+            unsigned char tail[8 + kDigestSize];
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int digest_len = 0;
+            EVP_DigestFinal_ex(sha, digest, &digest_len);
+            if (!readExact(in, tail, sizeof(tail))) {
+                if (err) *err = "Session archive is truncated";
+            } else if (digest_len != kDigestSize || std::memcmp(tail + 8, digest, kDigestSize) != 0) {
+                if (err) *err = "Session archive checksum mismatch";
+            } else {
+                if (records) *records = getLE(tail, 8);
+                ok = frames > 0;
+                if (!ok && err) *err = "Session archive has no header";
+            }
+            break;
+        }
+        unsigned char len_buf[4];
+        putLE(len_buf, len, 4);
+        EVP_DigestUpdate(sha, len_buf, sizeof(len_buf));
+        buf.resize(len);
+        if (!readExact(in, buf.data(), len)) {
+            if (err) *err = "Session archive is truncated";
+            break;
+        }
+        EVP_DigestUpdate(sha, buf.data(), len);
+        ++frames;
+    }
+    EVP_MD_CTX_free(sha);
+    return ok;
+}
+
+bool Reader::open(const std::string& path, std::string* err) {
+    in_.open(path, std::ios::binary);
+    if (!in_) {
+        if (err) *err = "Cannot open file: " + path;
+        return false;
+    }
+    done_ = false;
+    if (!readMagic(in_, err)) return false;
+
+    uint32_t len = 0;
+    if (!readLength(in_, len, err)) return false;
+    payload_.resize(len);
+    if (len == 0 || !readExact(in_, &payload_[0], len)) {
+        if (err) *err = "Session archive has no header";
+        return false;
+    }
+    try {
+        header_ = json::from_cbor(payload_);
+    } catch (const std::exception& e) {
+        if (err) *err = std::string("Session archive header is corrupted: ") + e.what();
+        return false;
+    }
+    return true;
+}
+
+bool Reader::next(std::vector<json>& records, std::string* err) {
+    records.clear();
+    if (done_) return false;
+
+    uint32_t len = 0;
+    if (!readLength(in_, len, err)) {
+        done_ = true;
+        return false;
+    }
+    if (len == 0) {
+        done_ = true;
+        return false;
+    }
+    payload_.resize(len);
+    if (!readExact(in_, &payload_[0], len)) {
+        if (err) *err = "Session archive is truncated";
+        done_ = true;
+        return false;
+    }
+    try {
+        json chunk = json::from_cbor(payload_);
+        records.reserve(chunk.size());
+        for (auto& r : chunk) records.push_back(std::move(r));
+    } catch (const std::exception& e) {
+        if (err) *err = std::string("Session archive chunk is corrupted: ") + e.what();
+        done_ = true;
+        return false;
+    }
+    return true;
+}
+
+}
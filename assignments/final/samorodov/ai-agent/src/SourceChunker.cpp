@@ -0,0 +1,399 @@
+#include "SourceChunker.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+namespace {
+
+// Уровень места разреза перед строкой: чем меньше, тем лучше здесь резать
+enum CutLevel { CUT_TOP = 0, CUT_MEMBER = 1, CUT_HARD = 2 };
+
+const size_t kNumberWidth = 7;   // "%5zu| " перед каждой строкой
+
+struct Line {
+    size_t begin;
+    size_t end;   // без '\n'
+};
+
+std::vector<Line> splitLines(std::string_view code) {
+    std::vector<Line> lines;
+    size_t pos = 0;
+    while (pos < code.size()) {
+        size_t nl = code.find('\n', pos);
+        if (nl == std::string_view::npos) nl = code.size();
+        lines.push_back({pos, nl});
+        pos = nl + 1;
+    }
+    return lines;
+}
+
+size_t firstNonSpace(std::string_view s) {
+    size_t i = 0;
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r')) ++i;
+    return i;
+}
+
+bool startsWith(std::string_view s, std::string_view prefix) {
+    return s.substr(0, prefix.size()) == prefix;
+}
+
+bool isWord(std::string_view stmt, std::string_view word) {
+    return startsWith(stmt, word) &&
+           (stmt.size() == word.size() || !(std::isalnum((unsigned char)stmt[word.size()]) || stmt[word.size()] == '_'));
+}
+
+// ---------------- C++ ----------------
+// Разрез возможен, когда строка начинается вне комментария и строки, на
+// глубине фигурных скобок 0 (или 1) и предыдущее объявление закончено.
+std::vector<int> cppCutLevels(std::string_view code, const std::vector<Line>& lines,
+                              std::vector<bool>& comment_only) {
+    enum Mode { CODE, BLOCK_COMMENT, STRING, CHAR_LIT, RAW_STRING };
+    Mode mode = CODE;
+    std::string raw_end;            // ")delim\"" для R"delim(...)delim"
+    std::vector<bool> transparent;  // стек '{': namespace/extern не считаются
+    int depth = 0;
+    int parens = 0;
+    std::string stmt;               // начало текущего объявления без пробелов
+    bool in_pp = false;             // продолжение директивы препроцессора
+
+    std::vector<int> cut(lines.size(), CUT_HARD);
+    comment_only.assign(lines.size(), false);
+
+    for (size_t li = 0; li < lines.size(); ++li) {
+        std::string_view s = code.substr(lines[li].begin, lines[li].end - lines[li].begin);
+        size_t i = firstNonSpace(s);
+        std::string_view rest = s.substr(i);
+
+        comment_only[li] = mode == BLOCK_COMMENT ||
+                           (mode == CODE && (startsWith(rest, "//") || startsWith(rest, "/*")));
+        if (mode == CODE && !in_pp && stmt.empty() && parens == 0) {
+            if (depth == 0) cut[li] = CUT_TOP;
+            else if (depth == 1) cut[li] = CUT_MEMBER;
+        }
+
+        // Директивы препроцессора не влияют на скобки (макросы с '{')
+        if (in_pp || (mode == CODE && stmt.empty() && startsWith(rest, "#"))) {
+            in_pp = !s.empty() && s.back() == '\\';
+            continue;
+        }
+
+        for (; i < s.size(); ++i) {
+            const char c = s[i];
+            const char next = i + 1 < s.size() ? s[i + 1] : '\0';
+            switch (mode) {
+            case BLOCK_COMMENT:
+                if (c == '*' && next == '/') { mode = CODE; ++i; }
+                continue;
+            case STRING:
+            case CHAR_LIT:
+                if (c == '\\') ++i;
+                else if (c == (mode == STRING ? '"' : '\'')) mode = CODE;
+                continue;
+            case RAW_STRING:
+                if (s.compare(i, raw_end.size(), raw_end) == 0) {
+                    i += raw_end.size() - 1;
+                    mode = CODE;
+                }
+                continue;
+            case CODE:
+                break;
+            }
+
+            if (c == '/' && next == '/') break;
+            if (c == '/' && next == '*') { mode = BLOCK_COMMENT; ++i; continue; }
+            if (c == '"') {
+                if (i > 0 && s[i - 1] == 'R') {
+                    size_t open = s.find('(', i);
+                    if (open != std::string_view::npos) {
+                        raw_end = ")" + std::string(s.substr(i + 1, open - i - 1)) + "\"";
+                        mode = RAW_STRING;
+                        i = open;
+                        continue;
+                    }
+                }
+                mode = STRING;
+                continue;
+            }
+            if (c == '\'') {
+                // 1'000'000 — разделитель разрядов, а не символьный литерал
+                if (!(i > 0 && std::isdigit((unsigned char)s[i - 1]))) mode = CHAR_LIT;
+                continue;
+            }
+            if (c == '(') { ++parens; stmt += c; continue; }
+            if (c == ')') { if (parens > 0) --parens; stmt += c; continue; }
+            if (c == '{') {
+                // Пробелы из stmt выброшены: "inline namespace" -> "inlinenamespace"
+                bool skip = startsWith(stmt, "namespace") || startsWith(stmt, "inlinenamespace") ||
+                            isWord(stmt, "extern");
+                transparent.push_back(skip);
+                if (!skip) ++depth;
+                stmt.clear();
+                continue;
+            }
+            if (c == '}') {
+                if (!transparent.empty()) {
+                    if (!transparent.back()) --depth;
+                    transparent.pop_back();
+                }
+                stmt.clear();
+                continue;
+            }
+            if (c == ';' && parens == 0) { stmt.clear(); continue; }
+            if (c == ':' && next != ':' &&
+                (stmt == "public" || stmt == "private" || stmt == "protected")) {
+                stmt.clear();
+                continue;
+            }
+            if (c != ' ' && c != '\t' && c != '\r' && stmt.size() < 64) stmt += c;
+        }
+        // Обычная строка или символ не переходят на следующую строку без '\':
+        // незакрытая кавычка (апостроф в комментарии shell, 'a у Rust) не
+        // должна «съесть» остаток файла
+        if ((mode == STRING || mode == CHAR_LIT) && (s.empty() || s.back() != '\\')) mode = CODE;
+    }
+    return cut;
+}
+
+// ---------------- Python ----------------
+// Разрез перед каждым оператором верхнего уровня, а внутри классов и функций —
+// перед def/class. Декоратор остаётся со своей функцией.
+std::vector<int> pythonCutLevels(std::string_view code, const std::vector<Line>& lines,
+                                 std::vector<bool>& comment_only) {
+    char triple = 0;        // '"' или '\'' внутри """...""" / '''...'''
+    int brackets = 0;
+    bool continued = false; // строка заканчивалась на '\'
+    bool prev_decorator = false;
+    size_t prev_indent = 0;
+
+    std::vector<int> cut(lines.size(), CUT_HARD);
+    comment_only.assign(lines.size(), false);
+
+    for (size_t li = 0; li < lines.size(); ++li) {
+        std::string_view s = code.substr(lines[li].begin, lines[li].end - lines[li].begin);
+        const size_t indent = firstNonSpace(s);
+        std::string_view rest = s.substr(indent);
+        const bool fresh = triple == 0 && brackets == 0 && !continued;
+
+        if (fresh && !rest.empty()) {
+            const bool is_def = startsWith(rest, "def ") || startsWith(rest, "async def ") ||
+                                startsWith(rest, "class ");
+            comment_only[li] = rest[0] == '#';
+            if (indent == 0) cut[li] = CUT_TOP;
+            else if (is_def || rest[0] == '@' || comment_only[li]) cut[li] = CUT_MEMBER;
+            if (is_def && prev_decorator && prev_indent == indent) cut[li] = CUT_HARD;
+            if (!comment_only[li]) {
+                prev_decorator = rest[0] == '@';
+                prev_indent = indent;
+            }
+        }
+
+        continued = false;
+        for (size_t i = indent; i < s.size(); ++i) {
+            const char c = s[i];
+            if (triple) {
+                if (c == '\\') ++i;
+                else if (c == triple && s.compare(i, 3, std::string(3, triple)) == 0) {
+                    triple = 0;
+                    i += 2;
+                }
+                continue;
+            }
+            if (c == '#') break;
+            if (c == '"' || c == '\'') {
+                if (s.compare(i, 3, std::string(3, c)) == 0) {
+                    triple = c;
+                    i += 2;
+                    continue;
+                }
+                for (++i; i < s.size() && s[i] != c; ++i) {
+                    if (s[i] == '\\') ++i;
+                }
+                continue;
+            }
+            if (c == '(' || c == '[' || c == '{') ++brackets;
+            else if ((c == ')' || c == ']' || c == '}') && brackets > 0) --brackets;
+            else if (c == '\\' && i + 1 == s.size()) continued = true;
+        }
+    }
+    return cut;
+}
+
+// Уровни разрезов с поправкой: комментарий над функцией уходит в её фрагмент
+std::vector<int> cutLevels(std::string_view code, const std::string& language,
+                           const std::vector<Line>& lines) {
+    std::vector<bool> comment_only;
+    std::vector<int> cut = language == "python" ? pythonCutLevels(code, lines, comment_only)
+                                                : cppCutLevels(code, lines, comment_only);
+    for (size_t i = lines.size() - 1; i > 0; --i) {
+        if (cut[i] < CUT_HARD && comment_only[i - 1] && cut[i - 1] <= cut[i]) cut[i] = CUT_HARD;
+    }
+    return cut;
+}
+
+struct Range {
+    size_t first;   // индексы строк [first, last)
+    size_t last;
+};
+
+class Packer {
+public:
+    Packer(const std::vector<Line>& lines, const std::vector<int>& cut, size_t max_chars)
+        : cut_(cut), max_(max_chars), prefix_(lines.size() + 1, 0) {
+        for (size_t i = 0; i < lines.size(); ++i) {
+            prefix_[i + 1] = prefix_[i] + (lines[i].end - lines[i].begin) + 1 + kNumberWidth;
+        }
+    }
+
+    size_t size(size_t first, size_t last) const { return prefix_[last] - prefix_[first]; }
+
+    std::vector<Range> pack() {
+        std::vector<Range> pieces;
+        split({0, cut_.size()}, CUT_TOP, pieces);
+
+        // Соседние куски склеиваются, пока помещаются в лимит
+        std::vector<Range> merged;
+        for (const Range& p : pieces) {
+            if (!merged.empty() && size(merged.back().first, p.last) <= max_) {
+                merged.back().last = p.last;
+            } else {
+                merged.push_back(p);
+            }
+        }
+        return merged;
+    }
+
+private:
+    void split(Range r, int level, std::vector<Range>& out) const {
+        if (r.last - r.first <= 1 || size(r.first, r.last) <= max_ || level > CUT_HARD) {
+            out.push_back(r);
+            return;
+        }
+        size_t start = r.first;
+        for (size_t i = r.first + 1; i <= r.last; ++i) {
+            if (i < r.last && cut_[i] > level) continue;
+            Range part{start, i};
+            if (size(part.first, part.last) <= max_) out.push_back(part);
+            else split(part, level + 1, out);
+            start = i;
+        }
+    }
+
+    const std::vector<int>& cut_;
+    size_t max_;
+    std::vector<size_t> prefix_;
+};
+
+}
+
+size_t countLines(std::string_view code) {
+    size_t n = 0;
+    for (char c : code) n += c == '\n';
+    return n + (!code.empty() && code.back() != '\n');
+}
+
+std::vector<SourceChunk> splitSource(std::string_view code, const std::string& language,
+                                     const ChunkingOptions& opts) {
+    const std::vector<Line> lines = splitLines(code);
+    std::vector<SourceChunk> chunks;
+    if (lines.empty()) return chunks;
+
+    const std::vector<int> cut = cutLevels(code, language, lines);
+
+    Packer packer(lines, cut, opts.max_chars);
+    const std::vector<Range> ranges = packer.pack();
+
+    for (size_t k = 0; k < ranges.size(); ++k) {
+        const Range& r = ranges[k];
+        size_t text_first = r.first;
+        if (k > 0) {
+            const size_t prev_first = ranges[k - 1].first;
+            text_first = r.first - std::min(opts.overlap_lines, r.first - prev_first);
+        }
+        SourceChunk c;
+        c.first_line = text_first + 1;
+        c.own_first = r.first + 1;
+        c.last_line = r.last;
+        c.begin = lines[text_first].begin;
+        c.end = r.last < lines.size() ? lines[r.last].begin : code.size();
+        chunks.push_back(c);
+    }
+    return chunks;
+}
+
+std::vector<SourceChunk> enclosingRegions(std::string_view code, const std::string& language,
+                                          const std::vector<LineSpan>& changed,
+                                          const RegionOptions& opts) {
+    const std::vector<Line> lines = splitLines(code);
+    std::vector<SourceChunk> regions;
+    if (lines.empty()) return regions;
+    const std::vector<int> cut = cutLevels(code, language, lines);
+    Packer packer(lines, cut, opts.max_chars);
+    const size_t n = lines.size();
+
+    std::vector<Range> ranges;
+    for (const LineSpan& span : changed) {
+        // Индексы строк [a, b); удаление без новых строк — место после строки first
+        const size_t a = std::min(span.first > 0 ? span.first - 1 : 0, n - 1);
+        const size_t b = std::min(std::max(span.last, a + 1), n);
+
+        // Наименьший охватывающий объемлющий кусок, который помещается в лимит:
+        // функция или класс верхнего уровня, затем метод, затем окно строк
+        Range r{a, b};
+        bool found = false;
+        for (int level = CUT_TOP; level < CUT_HARD && !found; ++level) {
+            size_t first = a, last = b;
+            while (first > 0 && cut[first] > level) --first;
+            while (last < n && cut[last] > level) ++last;
+            if (packer.size(first, last) <= opts.max_chars) {
+                r = {first, last};
+                found = true;
+            }
+        }
+        if (!found) {
+            r.first = a - std::min(a, opts.context_lines);
+            r.last = std::min(n, b + opts.context_lines);
+        }
+        ranges.push_back(r);
+    }
+
+    // Пересекающиеся и соседние куски объединяются, если вместе помещаются
+    std::sort(ranges.begin(), ranges.end(),
+              [](const Range& x, const Range& y) { return x.first < y.first; });
+    std::vector<Range> merged;
+    for (const Range& r : ranges) {
+        if (!merged.empty() && r.first <= merged.back().last &&
+            (r.last <= merged.back().last || packer.size(merged.back().first, r.last) <= opts.max_chars)) {
+            merged.back().last = std::max(merged.back().last, r.last);
+        } else {
+            merged.push_back(r);
+        }
+    }
+
+    for (const Range& r : merged) {
+        SourceChunk c;
+        c.first_line = c.own_first = r.first + 1;
+        c.last_line = r.last;
+        c.begin = lines[r.first].begin;
+        c.end = r.last < n ? lines[r.last].begin : code.size();
+        regions.push_back(c);
+    }
+    return regions;
+}
+
+std::string numberLines(std::string_view code, const SourceChunk& chunk) {
+    std::string out;
+    out.reserve(chunk.end - chunk.begin + (chunk.last_line - chunk.first_line + 1) * kNumberWidth);
+    size_t line = chunk.first_line;
+    size_t pos = chunk.begin;
+    char num[32];
+    while (pos < chunk.end) {
+        size_t nl = code.find('\n', pos);
+        if (nl == std::string_view::npos || nl > chunk.end) nl = chunk.end;
+        int n = std::snprintf(num, sizeof(num), "%5zu| ", line++);
+        out.append(num, n);
+        out.append(code.substr(pos, nl - pos));
+        out += '\n';
+        pos = nl + 1;
+    }
+    return out;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Деление большого исходника на фрагменты для отдельных запросов к модели.
+//
+// Резать стараемся между функциями и классами верхнего уровня (namespace и
+// extern "C" уровня не добавляют), комментарий над функцией остаётся с ней.
+// Если одна функция или класс больше лимита — режем между методами или
+// операторами первого уровня вложенности, и только в крайнем случае по строкам.
+// Соседние мелкие куски склеиваются, пока помещаются в лимит.
+struct SourceChunk {
+    size_t first_line = 1;  // первая строка текста фрагмента (с перекрытием), с 1
+    size_t own_first = 1;   // строки до неё — контекст из предыдущего фрагмента
+    size_t last_line = 1;
+    size_t begin = 0;       // байтовый диапазон [begin, end) в исходнике
+    size_t end = 0;
+};
+
+struct ChunkingOptions {
+    size_t max_chars = 8000;    // размер фрагмента с номерами строк, без перекрытия
+    size_t overlap_lines = 3;   // строк предыдущего фрагмента в начале следующего
+};
+
+// language: "python" режется по отступам, остальные языки — по фигурным скобкам.
+// Исходник, который помещается в лимит, — один фрагмент на весь файл
+std::vector<SourceChunk> splitSource(std::string_view code, const std::string& language,
+                                     const ChunkingOptions& opts);
+
+// Строки [first, last], с 1. last < first — удаленные строки: место после first
+struct LineSpan {
+    size_t first = 1;
+    size_t last = 1;
+};
+
+struct RegionOptions {
+    size_t max_chars = 8000;    // больше — функция сужается до метода или окна строк
+    size_t context_lines = 3;   // окно вокруг изменения, если функция не помещается
+};
+
+// Фрагменты вокруг измененных строк (analyze --diff): каждое изменение
+// расширяется до объемлющей функции или класса верхнего уровня, слишком
+// большие — до метода, и только потом до окна в context_lines строк.
+// Пересекающиеся фрагменты объединяются, результат упорядочен по строкам
+std::vector<SourceChunk> enclosingRegions(std::string_view code, const std::string& language,
+                                          const std::vector<LineSpan>& changed,
+                                          const RegionOptions& opts);
+
+// Текст фрагмента с номерами исходных строк: "  12| код"
+std::string numberLines(std::string_view code, const SourceChunk& chunk);
+
+size_t countLines(std::string_view code);
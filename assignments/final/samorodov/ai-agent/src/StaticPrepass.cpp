@@ -0,0 +1,457 @@
+#include "StaticPrepass.h"
+#include "DirectoryAnalyzer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+// Группы языков для правил
+enum LangMask : unsigned {
+    L_C = 1, L_PY = 2, L_JS = 4, L_SH = 8, L_GO = 16, L_RUST = 32, L_JAVA = 64, L_ANY = 127
+};
+
+unsigned maskOf(const std::string& language) {
+    if (language == "cpp" || language == "c") return L_C;
+    if (language == "python") return L_PY;
+    if (language == "javascript" || language == "typescript") return L_JS;
+    if (language == "shell") return L_SH;
+    if (language == "go") return L_GO;
+    if (language == "rust") return L_RUST;
+    if (language == "java") return L_JAVA;
+    return L_C;
+}
+
+struct Token {
+    enum Kind { IDENT, NUMBER, STRING, PUNCT };
+    Kind kind;
+    std::string_view text;
+    int line;
+    bool line_start;   // первый токен строки
+};
+
+bool isIdentStart(char c) { return std::isalpha((unsigned char)c) || c == '_' || c == '$'; }
+bool isIdentChar(char c) { return std::isalnum((unsigned char)c) || c == '_' || c == '$'; }
+
+// Лексер для метрик и правил: комментарии пропускаются, строки — один токен.
+// Комментарии '#' — у Python и shell, '//' и '/* */' — у остальных
+struct Lexed {
+    std::vector<Token> tokens;
+    std::vector<unsigned char> line_kind;   // 0 — пустая, 1 — комментарий, 2 — код
+    std::vector<size_t> indent;             // отступ строк с кодом
+};
+
+Lexed lex(std::string_view code, unsigned lang) {
+    Lexed out;
+    const bool hash_comments = lang & (L_PY | L_SH);
+    size_t i = 0;
+    int line = 1;
+    bool at_line_start = true;
+    size_t line_begin = 0;
+    out.line_kind.push_back(0);
+    out.indent.push_back(0);
+
+    auto newLine = [&](size_t pos) {
+        ++line;
+        at_line_start = true;
+        line_begin = pos + 1;
+        out.line_kind.push_back(0);
+        out.indent.push_back(0);
+    };
+    auto mark = [&](unsigned char kind) {
+        unsigned char& k = out.line_kind[line - 1];
+        if (kind > k) k = kind;
+    };
+    auto push = [&](Token::Kind kind, size_t begin, size_t end) {
+        if (at_line_start) out.indent[line - 1] = begin - line_begin;
+        out.tokens.push_back({kind, code.substr(begin, end - begin), line, at_line_start});
+        at_line_start = false;
+        mark(2);
+    };
+
+    while (i < code.size()) {
+        const char c = code[i];
+        const char next = i + 1 < code.size() ? code[i + 1] : '\0';
+        if (c == '\n') { newLine(i); ++i; continue; }
+        if (c == ' ' || c == '\t' || c == '\r') { ++i; continue; }
+
+        // Комментарии
+        if ((hash_comments && c == '#') || (!hash_comments && c == '/' && next == '/')) {
+            mark(1);
+            while (i < code.size() && code[i] != '\n') ++i;
+            continue;
+        }
+        if (!hash_comments && c == '/' && next == '*') {
+            mark(1);
+            i += 2;
+            while (i < code.size() && !(code[i] == '*' && i + 1 < code.size() && code[i + 1] == '/')) {
+                if (code[i] == '\n') { newLine(i); mark(1); }
+                ++i;
+            }
+            i += 2;
+            continue;
+        }
+
+        // Строки (в Python — и тройные кавычки); перевод строки внутри
+        // учитывается, строка кода — та, где литерал начался
+        if (c == '"' || c == '\'' || c == '`') {
+            const size_t begin = i;
+            const int start_line = line;
+            const bool triple = (lang & L_PY) && code.compare(i, 3, std::string(3, c)) == 0;
+            i += triple ? 3 : 1;
+            while (i < code.size()) {
+                if (code[i] == '\\') { i += 2; continue; }
+                if (triple ? code.compare(i, 3, std::string(3, c)) == 0 : code[i] == c) {
+                    i += triple ? 3 : 1;
+                    break;
+                }
+                if (code[i] == '\n') {
+                    if (!triple && c != '`') break;   // незакрытая строка
+                    ++line;
+                    line_begin = i + 1;
+                    out.line_kind.push_back(2);
+                    out.indent.push_back(0);
+                }
+                ++i;
+            }
+            const int end_line = line;
+            line = start_line;
+            push(Token::STRING, begin, i);
+            line = end_line;
+            continue;
+        }
+
+        if (isIdentStart(c)) {
+            const size_t begin = i;
+            while (i < code.size() && isIdentChar(code[i])) ++i;
+            push(Token::IDENT, begin, i);
+            continue;
+        }
+        if (std::isdigit((unsigned char)c)) {
+            const size_t begin = i;
+            while (i < code.size() && (std::isalnum((unsigned char)code[i]) || code[i] == '.' || code[i] == '\'')) ++i;
+            push(Token::NUMBER, begin, i);
+            continue;
+        }
+
+        static const char* const two_char[] = {"&&", "||", "==", "!=", "<=", ">=", "->", "::", ":=", "=>", "<<", ">>"};
+        size_t len = 1;
+        for (const char* op : two_char) {
+            if (c == op[0] && next == op[1]) { len = 2; break; }
+        }
+        push(Token::PUNCT, i, i + len);
+        i += len;
+    }
+    return out;
+}
+
+bool is(const Token& t, const char* text) {
+    return t.text == text;
+}
+
+// Правило по последовательности токенов: ident, затем next1 и next2 (если заданы)
+struct TokenRule {
+    unsigned langs;
+    const char* ident;
+    const char* next1;
+    const char* next2;
+    bool error;          // в ОШИБКИ; иначе в РЕКОМЕНДАЦИИ
+    const char* category;
+    const char* message;
+};
+
+const TokenRule kRules[] = {
+    {L_C, "gets", "(", nullptr, true, "Безопасность",
+     "gets() не проверяет размер буфера — используйте fgets()"},
+    {L_C, "strcpy", "(", nullptr, true, "Переполнение буфера",
+     "strcpy() без проверки размера — используйте strncpy/std::string"},
+    {L_C, "strcat", "(", nullptr, true, "Переполнение буфера",
+     "strcat() без проверки размера — используйте strncat/std::string"},
+    {L_C, "sprintf", "(", nullptr, true, "Переполнение буфера",
+     "sprintf() без проверки размера — используйте snprintf()"},
+    {L_C, "system", "(", nullptr, false, "Безопасность",
+     "system() запускает оболочку — риск внедрения команд"},
+    {L_C, "rand", "(", nullptr, false, "Качество",
+     "rand() — слабый генератор случайных чисел; используйте <random>"},
+    {L_PY | L_JS, "eval", "(", nullptr, true, "Безопасность",
+     "eval() выполняет произвольный код"},
+    {L_PY, "exec", "(", nullptr, true, "Безопасность",
+     "exec() выполняет произвольный код"},
+    {L_PY, "except", ":", nullptr, true, "Обработка ошибок",
+     "голый except: перехватывает и SystemExit/KeyboardInterrupt — укажите тип исключения"},
+    {L_PY, "shell", "=", "True", true, "Безопасность",
+     "subprocess с shell=True — риск внедрения команд"},
+    {L_PY, "pickle", ".", "load", false, "Безопасность",
+     "pickle.load() на недоверенных данных выполняет произвольный код"},
+    {L_PY, "pickle", ".", "loads", false, "Безопасность",
+     "pickle.loads() на недоверенных данных выполняет произвольный код"},
+    {L_PY, "import", "*", nullptr, false, "Стиль",
+     "import * засоряет пространство имен"},
+    {L_JS, "innerHTML", "=", nullptr, false, "Безопасность",
+     "присваивание innerHTML — риск XSS"},
+    {L_SH, "eval", nullptr, nullptr, false, "Безопасность",
+     "eval в shell выполняет произвольную строку"},
+    {L_RUST, "unsafe", nullptr, nullptr, false, "Безопасность",
+     "unsafe-блок: инварианты нужно проверить вручную"},
+    {L_JAVA, "printStackTrace", "(", nullptr, false, "Обработка ошибок",
+     "printStackTrace() вместо логирования"},
+};
+
+const size_t kMaxPerRule = 20;
+
+bool ruleMatches(const TokenRule& r, const std::vector<Token>& t, size_t i) {
+    if (t[i].kind != Token::IDENT || t[i].text != r.ident) return false;
+    if (r.next1 && (i + 1 >= t.size() || t[i + 1].text != r.next1)) return false;
+    if (r.next2 && (i + 2 >= t.size() || t[i + 2].text != r.next2)) return false;
+    return true;
+}
+
+void addIssue(std::vector<CodeIssue>& list, const char* category, int line, const std::string& message) {
+    list.push_back({category, line, message});
+}
+
+std::string lower(std::string_view s) {
+    std::string out(s);
+    for (auto& c : out) c = (char)std::tolower((unsigned char)c);
+    return out;
+}
+
+// Пароль или ключ строкой в коде: password = "...", api_key: '...'
+void findSecrets(const std::vector<Token>& t, AnalysisReport& findings) {
+    static const char* const names[] = {"password", "passwd", "secret", "api_key", "apikey", "token", "private_key"};
+    for (size_t i = 0; i + 2 < t.size(); ++i) {
+        if (t[i].kind != Token::IDENT) continue;
+        if (!(is(t[i + 1], "=") || is(t[i + 1], ":") || is(t[i + 1], ":="))) continue;
+        const Token& value = t[i + 2];
+        if (value.kind != Token::STRING || value.text.size() < 10) continue;
+        const std::string name = lower(t[i].text);
+        for (const char* n : names) {
+            if (name.find(n) != std::string::npos) {
+                addIssue(findings.errors, "Безопасность", t[i].line,
+                         "секрет в исходном коде (" + std::string(t[i].text) + ") — вынесите в конфигурацию или переменные окружения");
+                break;
+            }
+        }
+    }
+}
+
+void findRawSecrets(std::string_view code, AnalysisReport& findings) {
+    size_t p = code.find("PRIVATE KEY-----");
+    if (p != std::string_view::npos) {
+        int line = 1 + (int)std::count(code.begin(), code.begin() + p, '\n');
+        addIssue(findings.errors, "Безопасность", line, "закрытый ключ в исходном коде");
+    }
+    // Ключ доступа AWS: AKIA + 16 заглавных букв/цифр
+    for (p = code.find("AKIA"); p != std::string_view::npos; p = code.find("AKIA", p + 4)) {
+        size_t n = 0;
+        while (p + 4 + n < code.size() && n < 16 &&
+               (std::isupper((unsigned char)code[p + 4 + n]) || std::isdigit((unsigned char)code[p + 4 + n]))) ++n;
+        if (n == 16) {
+            int line = 1 + (int)std::count(code.begin(), code.begin() + p, '\n');
+            addIssue(findings.errors, "Безопасность", line, "ключ доступа AWS в исходном коде");
+            break;
+        }
+    }
+}
+
+// def f(x=[]) / def f(x={}) — значение по умолчанию общее для всех вызовов
+void findMutableDefaults(const std::vector<Token>& t, AnalysisReport& findings) {
+    for (size_t i = 0; i + 2 < t.size(); ++i) {
+        if (!(t[i].kind == Token::IDENT && is(t[i], "def"))) continue;
+        size_t j = i + 2;
+        if (j >= t.size() || !is(t[j], "(")) continue;
+        int depth = 0;
+        for (; j < t.size(); ++j) {
+            if (is(t[j], "(") || is(t[j], "[") || is(t[j], "{")) ++depth;
+            else if (is(t[j], ")") || is(t[j], "]") || is(t[j], "}")) {
+                if (--depth == 0) break;
+            } else if (depth == 1 && is(t[j], "=") && j + 2 < t.size() &&
+                       ((is(t[j + 1], "[") && is(t[j + 2], "]")) || (is(t[j + 1], "{") && is(t[j + 2], "}")))) {
+                addIssue(findings.errors, "Логика", t[j].line,
+                         "изменяемое значение по умолчанию у параметра " + std::string(t[j - 1].text) +
+                         " — один объект на все вызовы; используйте None");
+            }
+        }
+        i = j;
+    }
+}
+
+bool isHeader(std::string_view path) {
+    for (const char* ext : {".h", ".hpp", ".hh", ".hxx"}) {
+        const size_t n = std::strlen(ext);
+        if (path.size() >= n && path.substr(path.size() - n) == ext) return true;
+    }
+    return false;
+}
+
+bool looksGenerated(std::string_view code, const SourceMetrics& m) {
+    const std::string_view head = code.substr(0, 2048);
+    for (const char* marker : {"DO NOT EDIT", "@generated", "Code generated", "generated by", "Generated by",
+                               "autogenerated", "auto-generated", "Autogenerated", "Auto-generated"}) {
+        if (head.find(marker) != std::string_view::npos) return true;
+    }
+    // Минифицированный код: мало очень длинных строк
+    return m.bytes > 5000 && m.lines > 0 && m.bytes / m.lines > 500;
+}
+
+// Строка-подключение: #include, import, use ... Условные директивы и
+// "#define GUARD" тоже, чтобы заголовок из одних #include с защитой от
+// повторного включения считался пустым; макросы с телом — код
+bool isIncludeLike(const std::vector<Token>& t, size_t i) {
+    const Token& first = t[i];
+    const Token* second = i + 1 < t.size() && t[i + 1].line == first.line ? &t[i + 1] : nullptr;
+    if (first.kind == Token::PUNCT && is(first, "#")) {
+        if (!second) return true;
+        if (is(*second, "define")) {
+            return i + 3 >= t.size() || t[i + 3].line != first.line;
+        }
+        static const char* const directives[] = {"include", "import", "pragma", "if", "ifdef", "ifndef",
+                                                 "elif", "else", "endif"};
+        for (const char* d : directives) {
+            if (second->text == d) return true;
+        }
+        return false;
+    }
+    if (first.kind != Token::IDENT) return false;
+    static const char* const words[] = {"import", "from", "package", "use", "using", "require"};
+    for (const char* w : words) {
+        if (first.text == w) return true;
+    }
+    // const x = require("...")
+    auto onLine = [&](size_t k) { return i + k < t.size() && t[i + k].line == first.line; };
+    return second && second->kind == Token::IDENT && onLine(3) && is(t[i + 2], "=") &&
+           t[i + 3].kind == Token::IDENT && is(t[i + 3], "require");
+}
+
+}
+
+PrepassResult runPrepass(std::string_view code, const std::string& language,
+                         std::string_view path, const PrepassRules& rules) {
+    PrepassResult result;
+    SourceMetrics& m = result.metrics;
+    const unsigned lang = maskOf(language);
+    const Lexed lexed = lex(code, lang);
+    const std::vector<Token>& t = lexed.tokens;
+
+    m.bytes = code.size();
+    m.lines = lexed.line_kind.size() - (!code.empty() && code.back() == '\n');
+    for (size_t l = 0; l < m.lines; ++l) {
+        switch (lexed.line_kind[l]) {
+            case 0: ++m.blank_lines; break;
+            case 1: ++m.comment_lines; break;
+            default: ++m.code_lines;
+        }
+    }
+    m.tokens = t.size();
+
+    // Сложность, вложенность, строки-подключения
+    static const char* const branches[] = {"if", "elif", "for", "while", "case", "catch", "except", "and", "or"};
+    int depth = 0;
+    bool line_is_include = false;
+    for (size_t i = 0; i < t.size(); ++i) {
+        const Token& tok = t[i];
+        if (tok.line_start) {
+            line_is_include = isIncludeLike(t, i);
+            if (line_is_include) ++m.include_lines;
+        }
+        if (line_is_include) continue;
+        if (tok.kind == Token::IDENT) {
+            for (const char* b : branches) {
+                if (tok.text == b) { ++m.complexity; break; }
+            }
+        } else if (tok.kind == Token::PUNCT) {
+            if (is(tok, "&&") || is(tok, "||") || is(tok, "?")) ++m.complexity;
+            else if (is(tok, "{")) m.max_nesting = std::max(m.max_nesting, ++depth);
+            else if (is(tok, "}") && depth > 0) --depth;
+        }
+    }
+    if (lang & L_PY) {
+        size_t unit = 0, deepest = 0;
+        for (size_t l = 0; l < lexed.indent.size(); ++l) {
+            if (lexed.line_kind[l] != 2 || lexed.indent[l] == 0) continue;
+            unit = unit ? std::min(unit, lexed.indent[l]) : lexed.indent[l];
+            deepest = std::max(deepest, lexed.indent[l]);
+        }
+        m.max_nesting = unit ? (int)(deepest / unit) : 0;
+    }
+    m.generated = looksGenerated(code, m);
+
+    // Очевидные проблемы
+    size_t hits[sizeof(kRules) / sizeof(kRules[0])] = {};
+    for (size_t i = 0; i < t.size(); ++i) {
+        for (size_t r = 0; r < sizeof(kRules) / sizeof(kRules[0]); ++r) {
+            const TokenRule& rule = kRules[r];
+            if (!(rule.langs & lang) || hits[r] >= kMaxPerRule || !ruleMatches(rule, t, i)) continue;
+            ++hits[r];
+            addIssue(rule.error ? result.findings.errors : result.findings.recommendations,
+                     rule.category, t[i].line, rule.message);
+        }
+    }
+    if ((lang & L_C) && isHeader(path)) {
+        for (size_t i = 0; i + 2 < t.size(); ++i) {
+            if (is(t[i], "using") && is(t[i + 1], "namespace") && is(t[i + 2], "std")) {
+                addIssue(result.findings.recommendations, "Стиль", t[i].line,
+                         "using namespace std в заголовке попадает во все файлы, которые его подключают");
+                break;
+            }
+        }
+    }
+    if (lang & L_PY) findMutableDefaults(t, result.findings);
+    findSecrets(t, result.findings);
+    findRawSecrets(code, result.findings);
+    mergeReports(result.findings, AnalysisReport{});   // сортировка по строкам
+
+    // Решение
+    auto skip = [&result](const std::string& reason) {
+        result.decision = PrepassDecision::Skip;
+        result.reason = reason;
+        return result;
+    };
+    if (!rules.enabled) return result;
+    if (!path.empty()) {
+        const std::string p(path);
+        for (const auto& glob : rules.skip_globs) {
+            if (globMatch(glob, p)) return skip("сторонний код (" + glob + ")");
+        }
+    }
+    if (m.code_lines == 0) return skip("нет кода");
+    if (rules.skip_generated && m.generated) return skip("сгенерированный код");
+    const bool has_findings = !result.findings.errors.empty() || !result.findings.recommendations.empty();
+    if (rules.skip_include_only && m.include_lines == m.code_lines) return skip("только подключения");
+    if (m.code_lines < rules.min_code_lines && !has_findings) {
+        return skip("тривиальный код (" + std::to_string(m.code_lines) + " строк)");
+    }
+    if (!has_findings && m.complexity <= rules.low_priority_complexity &&
+        m.code_lines <= rules.low_priority_lines) {
+        result.decision = PrepassDecision::LowPriority;
+        result.reason = "простой код";
+    }
+    return result;
+}
+
+std::string describeMetrics(const SourceMetrics& m) {
+    return std::to_string(m.code_lines) + " строк кода, сложность " + std::to_string(m.complexity) +
+           ", вложенность " + std::to_string(m.max_nesting);
+}
+
+std::string localOnlyReport(const PrepassResult& prepass) {
+    std::string out = "Анализ моделью не нужен: " + prepass.reason + "\n";
+    out += "Метрики: " + describeMetrics(prepass.metrics) + "\n";
+    if (!prepass.findings.errors.empty() || !prepass.findings.recommendations.empty()) {
+        out += "\n" + formatAnalysisReport(prepass.findings);
+    }
+    return out;
+}
+
+std::string addLocalFindings(const std::string& model_text, const AnalysisReport& findings) {
+    if (findings.errors.empty() && findings.recommendations.empty()) return model_text;
+    AnalysisReport report;
+    if (!parseAnalysisReport(model_text, report)) {
+        // Ответ не по формату — оставляем как есть, локальные замечания отдельно
+        AnalysisReport local = findings;
+        local.assessments.clear();
+        return model_text + "\n\n=== ЛОКАЛЬНЫЕ ПРОВЕРКИ ===\n" + formatAnalysisReport(local);
+    }
+    mergeReports(report, findings);
+    return formatAnalysisReport(report);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "AnalysisReport.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Быстрый локальный проход перед запросом к модели.
+//
+// Лёгкий лексер (комментарии и строки отброшены) считает метрики, по
+// правилам решает, стоит ли файл запроса к модели, и сразу находит очевидные
+// проблемы: gets/strcpy, eval, голый except:, shell=True, ключи и пароли в
+// коде и т.п. Эти замечания попадают в отчёт и без модели.
+struct SourceMetrics {
+    size_t bytes = 0;
+    size_t lines = 0;
+    size_t code_lines = 0;
+    size_t comment_lines = 0;
+    size_t blank_lines = 0;
+    size_t tokens = 0;
+    size_t include_lines = 0;  // #include, import, use, package ...
+    int complexity = 1;        // 1 + точки ветвления (if, for, case, &&, ...)
+    int max_nesting = 0;       // фигурные скобки или уровни отступа (Python)
+    bool generated = false;    // "DO NOT EDIT", "@generated", минифицированный код
+};
+
+struct PrepassRules {
+    bool enabled = true;
+    size_t min_code_lines = 3;        // меньше — тривиальный файл
+    bool skip_generated = true;
+    bool skip_include_only = true;    // в файле одни подключения
+    // Сторонний и сгенерированный код по пути (globMatch из DirectoryAnalyzer.h)
+    std::vector<std::string> skip_globs = {
+        "third_party/*", "*/third_party/*", "vendor/*", "*/vendor/*", "external/*", "*/external/*",
+        "*.pb.h", "*.pb.cc", "*_pb2.py", "*.min.js"
+    };
+    // Простой код без замечаний (сложность и размер не больше) — в конец очереди
+    int low_priority_complexity = 2;
+    size_t low_priority_lines = 20;
+};
+
+enum class PrepassDecision { Analyze, LowPriority, Skip };
+
+struct PrepassResult {
+    SourceMetrics metrics;
+    PrepassDecision decision = PrepassDecision::Analyze;
+    std::string reason;         // почему пропущен или отложен
+    AnalysisReport findings;    // найдено локально (errors/recommendations)
+};
+
+// language — id из LanguageDetector.h; path — для skip_globs и заголовков (может быть пустым)
+PrepassResult runPrepass(std::string_view code, const std::string& language,
+                         std::string_view path, const PrepassRules& rules);
+
+// "12 строк кода, сложность 4, вложенность 2"
+std::string describeMetrics(const SourceMetrics& m);
+
+// Отчёт без модели: причина, метрики и локальные замечания
+std::string localOnlyReport(const PrepassResult& prepass);
+
+// Добавить локальные замечания к ответу модели (без повторов)
+std::string addLocalFindings(const std::string& model_text, const AnalysisReport& findings);
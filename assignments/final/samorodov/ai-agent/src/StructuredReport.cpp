@@ -0,0 +1,251 @@
+#include "StructuredReport.h"
+#include <nlohmann/json.hpp>
+#include <vector>
+
+using nlohmann::json;
+
+namespace {
+
+// Не больше стольких замечаний в разделе — ограничивает и длину генерации
+const int kMaxIssues = 20;
+// Длинный испорченный ответ на исправление отправляется не целиком
+const size_t kMaxRepairInput = 16 * 1024;
+
+std::string issueSchema() {
+    return R"({"type":"object","properties":{)"
+           R"("category":{"type":"string"},)"
+           R"("line":{"type":"integer","minimum":0},)"
+           R"("message":{"type":"string","minLength":1}},)"
+           R"("required":["category","line","message"],"additionalProperties":false})";
+}
+
+// Обработчик SAX: путь до текущего значения известен по глубине и ключам
+class ReportSax : public nlohmann::json_sax<json> {
+public:
+    explicit ReportSax(AnalysisReport& out) : out_(out) {}
+
+    const std::string& error() const { return error_; }
+
+    bool finished() {
+        if (!error_.empty()) return false;
+        if (!seen_errors_) return fail("нет поля errors");
+        if (!seen_recommendations_) return fail("нет поля recommendations");
+        if (!seen_assessment_) return fail("нет поля assessment");
+        return true;
+    }
+
+    bool null() override { return scalar("null"); }
+    bool boolean(bool) override { return scalar("логическое значение"); }
+    bool number_float(number_float_t, const string_t&) override { return scalar("дробное число"); }
+    bool binary(binary_t&) override { return scalar("двоичные данные"); }
+
+    bool number_integer(number_integer_t v) override {
+        if (inIssue() && key_ == "line") {
+            if (v < 0) return fail(where() + ".line: отрицательный номер строки");
+            issue_.line = (int)v;
+            has_line_ = true;
+            return true;
+        }
+        return scalar("целое число");
+    }
+
+    bool number_unsigned(number_unsigned_t v) override {
+        if (inIssue() && key_ == "line") {
+            issue_.line = (int)std::min<number_unsigned_t>(v, 1u << 30);
+            has_line_ = true;
+            return true;
+        }
+        return scalar("целое число");
+    }
+
+    bool string(string_t& val) override {
+        if (depth_ == 1 && key_ == "assessment") {
+            if (!val.empty()) out_.assessments.push_back(std::move(val));
+            seen_assessment_ = true;
+            return true;
+        }
+        if (inIssue() && key_ == "category") {
+            issue_.category = std::move(val);
+            has_category_ = true;
+            return true;
+        }
+        if (inIssue() && key_ == "message") {
+            if (val.empty()) return fail(where() + ".message: пустая строка");
+            issue_.message = std::move(val);
+            return true;
+        }
+        return scalar("строка");
+    }
+
+    bool start_object(std::size_t) override {
+        ++depth_;
+        if (depth_ == 1) return true;
+        if (depth_ == 3 && section_) {
+            issue_ = CodeIssue{};
+            has_line_ = has_category_ = false;
+            return true;
+        }
+        if (skipping()) return true;
+        return fail(where() + ": ожидался " + expected());
+    }
+
+    bool end_object() override {
+        if (depth_ == 3 && section_) {
+            key_.clear();
+            if (issue_.message.empty()) return fail(where() + ": нет message");
+            if (!has_category_) return fail(where() + ": нет category");
+            if (!has_line_) return fail(where() + ": нет line");
+            if (++count_ <= kMaxIssues) section_->push_back(std::move(issue_));
+        }
+        --depth_;
+        key_.clear();
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        ++depth_;
+        if (depth_ == 1) return fail("ответ — не JSON-объект");
+        if (depth_ == 2 && (key_ == "errors" || key_ == "recommendations")) {
+            section_name_ = key_;
+            section_ = key_ == "errors" ? &out_.errors : &out_.recommendations;
+            (key_ == "errors" ? seen_errors_ : seen_recommendations_) = true;
+            count_ = 0;
+            return true;
+        }
+        if (skipping()) return true;
+        return fail(where() + ": ожидался " + expected());
+    }
+
+    bool end_array() override {
+        if (depth_ == 2) section_ = nullptr;
+        --depth_;
+        return true;
+    }
+
+    bool key(string_t& val) override {
+        if (skipping()) return true;   // ключи внутри пропускаемого значения
+        key_ = std::move(val);
+        skip_from_ = 0;
+        // Лишнее поле ответа или замечания — его значение пропускаем
+        if (depth_ == 1 && key_ != "errors" && key_ != "recommendations" && key_ != "assessment") {
+            skip_from_ = 1;
+        }
+        if (depth_ == 3 && key_ != "category" && key_ != "line" && key_ != "message") skip_from_ = 3;
+        return true;
+    }
+
+    bool parse_error(std::size_t pos, const std::string&, const nlohmann::detail::exception& ex) override {
+        if (error_.empty()) error_ = "позиция " + std::to_string(pos) + ": " + ex.what();
+        return false;
+    }
+
+private:
+    bool inIssue() const { return depth_ == 3 && section_ && !skip_from_; }
+    bool skipping() const { return skip_from_ && depth_ > skip_from_; }
+
+    bool scalar(const char* what) {
+        if (depth_ == 0) return fail("ответ — не JSON-объект");
+        if (skip_from_ && depth_ >= skip_from_) return true;
+        return fail(where() + ": " + what + " вместо " + expected());
+    }
+
+    std::string expected() const {
+        if (depth_ <= 1) {
+            return key_ == "assessment" ? "строки" : "массива объектов";
+        }
+        if (key_ == "line") return "целого числа";
+        if (depth_ == 2) return "объекта замечания";
+        return "строки";
+    }
+
+    std::string where() const {
+        std::string w = depth_ <= 1 ? key_ : section_name_ + "[" + std::to_string(count_) + "]";
+        if (depth_ >= 3 && !key_.empty()) w += "." + key_;
+        return w.empty() ? "ответ" : w;
+    }
+
+    bool fail(std::string message) {
+        if (error_.empty()) error_ = std::move(message);
+        return false;
+    }
+
+    AnalysisReport& out_;
+    int depth_ = 0;
+    int skip_from_ = 0;     // пропускаем значение лишнего поля с этой глубины
+    std::string key_;
+    std::vector<CodeIssue>* section_ = nullptr;
+    std::string section_name_;
+    int count_ = 0;
+    CodeIssue issue_;
+    bool has_line_ = false;
+    bool has_category_ = false;
+    bool seen_errors_ = false;
+    bool seen_recommendations_ = false;
+    bool seen_assessment_ = false;
+    std::string error_;
+};
+
+}
+
+const std::string& analysisJsonSchema() {
+    static const std::string schema =
+        R"({"type":"object","properties":{)"
+        R"("errors":{"type":"array","maxItems":)" + std::to_string(kMaxIssues) + R"(,"items":)" + issueSchema() + "}," +
+        R"("recommendations":{"type":"array","maxItems":)" + std::to_string(kMaxIssues) + R"(,"items":)" + issueSchema() + "}," +
+        R"("assessment":{"type":"string"}},)"
+        R"("required":["errors","recommendations","assessment"],"additionalProperties":false})";
+    return schema;
+}
+
+const std::string& analysisGrammar() {
+    // Пробелы ограничены по длине: иначе маленькая модель может бесконечно
+    // генерировать отступы
+    static const std::string grammar =
+        "root ::= \"{\" ws \"\\\"errors\\\":\" ws issues \",\" ws \"\\\"recommendations\\\":\" ws issues \",\" ws "
+        "\"\\\"assessment\\\":\" ws string ws \"}\"\n"
+        "issues ::= \"[\" ws ( issue ( \",\" ws issue ){0," + std::to_string(kMaxIssues - 1) + "} )? ws \"]\"\n"
+        "issue ::= \"{\" ws \"\\\"category\\\":\" ws string \",\" ws \"\\\"line\\\":\" ws line \",\" ws "
+        "\"\\\"message\\\":\" ws string ws \"}\"\n"
+        "line ::= [0-9] | [1-9] [0-9]{1,6}\n"
+        "string ::= \"\\\"\" ( [^\"\\\\\\x7F\\x00-\\x1F] | \"\\\\\" [\"\\\\/bfnrt] | \"\\\\u\" [0-9a-fA-F]{4} )* \"\\\"\"\n"
+        "ws ::= [ \\t\\n]{0,20}\n";
+    return grammar;
+}
+
+std::string structuredFormatHint() {
+    return "ФОРМАТ ОТВЕТА (СТРОГО СОБЛЮДАЙ): один JSON-объект, без ``` и пояснений:\n"
+           "{\"errors\": [{\"category\": \"Тип ошибки\", \"line\": номер строки (0 — без строки), "
+           "\"message\": \"Описание\"}],\n"
+           " \"recommendations\": [{\"category\": \"Категория\", \"line\": 0, \"message\": \"Рекомендация\"}],\n"
+           " \"assessment\": \"Краткая оценка качества кода, 1-2 предложения\"}\n"
+           "Нет ошибок или рекомендаций — пустой массив [].\n\n";
+}
+
+bool parseStructuredReport(std::string_view text, AnalysisReport& out, std::string* err) {
+    AnalysisReport report;
+    ReportSax sax(report);
+    const bool ok = json::sax_parse(text.begin(), text.end(), &sax) && sax.finished();
+    if (!ok) {
+        if (err) *err = sax.error().empty() ? "ответ не разобран" : sax.error();
+        return false;
+    }
+    out = std::move(report);
+    return true;
+}
+
+std::string_view extractJsonObject(std::string_view text) {
+    const size_t open = text.find('{');
+    const size_t close = text.rfind('}');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open) return text;
+    return text.substr(open, close - open + 1);
+}
+
+std::string buildRepairPrompt(std::string_view broken, const std::string& error) {
+    std::string prompt =
+        "Ответ ниже должен быть JSON-объектом по схеме, но не проходит проверку: " + error + ".\n"
+        "Исправь только формат: сохрани все замечания и их смысл, ничего не добавляй. "
+        "Верни ТОЛЬКО исправленный JSON.\n\n"
+        "СХЕМА:\n" + analysisJsonSchema() + "\n\nОТВЕТ:\n";
+    prompt.append(broken.substr(0, kMaxRepairInput));
+    return prompt;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "AnalysisReport.h"
+#include <string>
+#include <string_view>
+
+// Ответ модели в виде JSON вместо текста с разделами "=== ОШИБКИ ===":
+//
+//   {"errors": [{"category": "...", "line": 12, "message": "..."}],
+//    "recommendations": [...], "assessment": "..."}
+//
+// llama-server получает схему (response_format) или GBNF-грамматику (grammar)
+// и просто не может выдать другой ответ. Удаленный API ограничений не
+// понимает: ответ проверяется и при ошибке один раз отправляется на
+// исправление (buildRepairPrompt).
+
+// JSON Schema ответа (для response_format.json_schema.schema)
+const std::string& analysisJsonSchema();
+// Та же структура в GBNF для поля "grammar" llama-server
+const std::string& analysisGrammar();
+
+// Описание формата для промпта: что писать в каждом поле
+std::string structuredFormatHint();
+
+// Потоковый (SAX) разбор ответа сразу в CodeIssue, без дерева JSON.
+// Проверяется структура: обязательные поля, типы, line >= 0, непустой
+// message. Лишние поля пропускаются. false — причина в err
+bool parseStructuredReport(std::string_view json, AnalysisReport& out, std::string* err = nullptr);
+
+// JSON-объект из ответа как есть: без ```json и текста вокруг
+std::string_view extractJsonObject(std::string_view text);
+
+// Промпт для исправления ответа, не прошедшего проверку: только формат,
+// исходный код повторно не отправляется
+std::string buildRepairPrompt(std::string_view broken, const std::string& error);
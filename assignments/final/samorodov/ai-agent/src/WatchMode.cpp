@@ -0,0 +1,570 @@
+#include "WatchMode.h"
+#include "AiAgent.h"
+#include "AnalysisReport.h"
+#include "LanguageDetector.h"
+#include "StaticPrepass.h"
+#include "WorkStealingPool.h"
+#include <nlohmann/json.hpp>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+uint64_t fnv1a(std::string_view s) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Хеши строк: по ним находится измененный участок относительно прошлой версии
+std::vector<uint32_t> lineHashes(std::string_view code) {
+    std::vector<uint32_t> out;
+    size_t pos = 0;
+    while (pos < code.size()) {
+        size_t nl = code.find('\n', pos);
+        if (nl == std::string_view::npos) nl = code.size();
+        const uint64_t h = fnv1a(code.substr(pos, nl - pos));
+        out.push_back((uint32_t)(h ^ (h >> 32)));
+        pos = nl + 1;
+    }
+    return out;
+}
+
+std::string hexHash(uint64_t h) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+    return buf;
+}
+
+std::string clockTime() {
+    const std::time_t t = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    char buf[16];
+    std::strftime(buf, sizeof(buf), "%H:%M:%S", &tm);
+    return buf;
+}
+
+// Последний отчет по файлу
+struct CacheEntry {
+    std::string hash;               // hexHash содержимого
+    std::string language;
+    std::string report;
+    std::vector<uint32_t> lines;
+};
+
+// Кэш отчетов в JSON: {"version": 1, "files": {"src/a.cpp": {...}}}
+class AnalysisCache {
+public:
+    explicit AnalysisCache(std::string path) : path_(std::move(path)) {}
+
+    void load() {
+        std::ifstream in(path_);
+        if (!in) return;
+        try {
+            json j = json::parse(in);
+            if (j.value("version", 0) != 1) return;
+            for (auto& [rel, e] : j.at("files").items()) {
+                CacheEntry entry;
+                entry.hash = e.at("hash").get<std::string>();
+                entry.language = e.at("language").get<std::string>();
+                entry.report = e.at("report").get<std::string>();
+                entry.lines = e.at("lines").get<std::vector<uint32_t>>();
+                entries_[rel] = std::move(entry);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Предупреждение: кэш " << path_ << " не прочитан: " << e.what() << "\n";
+            entries_.clear();
+        }
+    }
+
+    // Запись через временный файл, чтобы прерванный процесс не оставил половину кэша
+    bool save() {
+        json files = json::object();
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            if (!dirty_) return true;
+            for (const auto& [rel, e] : entries_) {
+                files[rel] = {{"hash", e.hash}, {"language", e.language},
+                              {"report", e.report}, {"lines", e.lines}};
+            }
+            dirty_ = false;
+        }
+        const std::string tmp = path_ + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out) return false;
+            out << json{{"version", 1}, {"files", std::move(files)}}.dump();
+            if (!out) return false;
+        }
+        std::error_code ec;
+        fs::rename(tmp, path_, ec);
+        return !ec;
+    }
+
+    bool get(const std::string& rel, CacheEntry& out) const {
+        std::lock_guard<std::mutex> lock(m_);
+        auto it = entries_.find(rel);
+        if (it == entries_.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    void put(const std::string& rel, CacheEntry entry) {
+        std::lock_guard<std::mutex> lock(m_);
+        entries_[rel] = std::move(entry);
+        dirty_ = true;
+    }
+
+    void erase(const std::string& rel) {
+        std::lock_guard<std::mutex> lock(m_);
+        dirty_ |= entries_.erase(rel) > 0;
+    }
+
+    bool dirty() const {
+        std::lock_guard<std::mutex> lock(m_);
+        return dirty_;
+    }
+
+private:
+    std::string path_;
+    mutable std::mutex m_;
+    std::map<std::string, CacheEntry> entries_;
+    bool dirty_ = false;
+};
+
+// Рекурсивное наблюдение за каталогом через inotify. Новые подкаталоги
+// добавляются на лету, их файлы считаются измененными
+class InotifyWatcher {
+public:
+    ~InotifyWatcher() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool open(const fs::path& root, const DirAnalysisOptions& opts, std::string* err) {
+        root_ = root;
+        opts_ = &opts;
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) {
+            if (err) *err = std::string("inotify_init1: ") + std::strerror(errno);
+            return false;
+        }
+        if (!addDir("")) {
+            if (err) *err = std::string("inotify_add_watch: ") + std::strerror(errno);
+            return false;
+        }
+        std::set<std::string> ignored;
+        addTree("", ignored);
+        return true;
+    }
+
+    // Ждать событий не дольше timeout_ms; пути от корня — в changed/removed
+    void poll(int timeout_ms, std::set<std::string>& changed, std::set<std::string>& removed) {
+        pollfd pfd{fd_, POLLIN, 0};
+        if (::poll(&pfd, 1, timeout_ms) <= 0) return;
+
+        alignas(inotify_event) char buf[64 * 1024];
+        for (;;) {
+            const ssize_t n = ::read(fd_, buf, sizeof(buf));
+            if (n <= 0) break;
+            for (char* p = buf; p < buf + n;) {
+                const auto* ev = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                handle(*ev, changed, removed);
+            }
+        }
+    }
+
+    size_t directories() const { return dirs_.size(); }
+
+private:
+    static std::string join(const std::string& dir, const std::string& name) {
+        return dir.empty() ? name : dir + "/" + name;
+    }
+
+    bool addDir(const std::string& rel) {
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE;
+        const int wd = inotify_add_watch(fd_, (root_ / rel).c_str(), mask | IN_ONLYDIR);
+        if (wd < 0) return false;
+        dirs_[wd] = rel;
+        return true;
+    }
+
+    // Подкаталоги rel (сам rel уже под наблюдением); найденные файлы — в files
+    void addTree(const std::string& rel, std::set<std::string>& files) {
+        std::error_code ec;
+        for (fs::directory_iterator it(root_ / rel, ec), end; !ec && it != end; it.increment(ec)) {
+            const std::string child = join(rel, it->path().filename().string());
+            if (it->path().filename().string().front() == '.') continue;
+            if (it->is_directory(ec)) {
+                if (anyExcluded(child)) continue;
+                if (addDir(child)) addTree(child, files);
+            } else if (acceptsSourcePath(child, *opts_)) {
+                files.insert(child);
+            }
+        }
+    }
+
+    bool anyExcluded(const std::string& rel) const {
+        for (const auto& p : opts_->exclude) {
+            if (globMatch(p, rel)) return true;
+        }
+        return false;
+    }
+
+    void handle(const inotify_event& ev, std::set<std::string>& changed, std::set<std::string>& removed) {
+        if (ev.mask & IN_Q_OVERFLOW) {
+            // Очередь ядра переполнилась (wd == -1), часть событий потеряна:
+            // все дерево заново, неизмененные файлы отсеет кэш по хешу
+            addTree("", changed);
+            return;
+        }
+        if (ev.mask & IN_IGNORED) {
+            dirs_.erase(ev.wd);
+            return;
+        }
+        auto it = dirs_.find(ev.wd);
+        if (it == dirs_.end() || ev.len == 0) return;
+        const std::string rel = join(it->second, ev.name);
+        if (ev.name[0] == '.') return;   // скрытые и временные файлы редакторов
+
+        if (ev.mask & IN_ISDIR) {
+            if ((ev.mask & (IN_CREATE | IN_MOVED_TO)) && !anyExcluded(rel) && addDir(rel)) {
+                addTree(rel, changed);   // каталог мог появиться уже с файлами
+            }
+            return;
+        }
+        if (!acceptsSourcePath(rel, *opts_)) return;
+        if (ev.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+            changed.insert(rel);
+            removed.erase(rel);
+        } else if (ev.mask & (IN_DELETE | IN_MOVED_FROM)) {
+            removed.insert(rel);
+            changed.erase(rel);
+        }
+    }
+
+    int fd_ = -1;
+    fs::path root_;
+    const DirAnalysisOptions* opts_ = nullptr;
+    std::unordered_map<int, std::string> dirs_;   // wd -> каталог от корня
+};
+
+// Запрос по файлу, который еще выполняется
+struct InFlight {
+    uint64_t generation = 0;
+    std::string hash;
+    std::shared_ptr<std::atomic<bool>> cancel;
+};
+
+class Watcher {
+public:
+    Watcher(const AiAgent& agent, const fs::path& root, const WatchOptions& opts, std::ostream& out)
+        : agent_(agent), root_(root), opts_(opts), out_(out),
+          cache_(opts.cache_path.empty() ? (root / ".ai_agent_cache.json").string() : opts.cache_path),
+          pool_(std::max(1u, opts.files.jobs)) {}
+
+    AnalysisCache& cache() { return cache_; }
+
+    // Поставить файл в очередь, если его содержимое отличается от кэша и от
+    // того, что уже анализируется. true — запрос отправлен
+    bool schedule(const std::string& rel) {
+        std::string code;
+        std::string read_err;
+        const fs::path path = root_ / rel;
+        std::error_code ec;
+        const uintmax_t size = fs::file_size(path, ec);
+        if (ec || size == 0 || size > opts_.files.max_file_bytes ||
+            !AiAgent::readWholeFile(path.string(), code, &read_err)) {
+            return false;
+        }
+        if (std::memchr(code.data(), '\0', std::min<size_t>(code.size(), 8192))) return false;
+
+        const std::string hash = hexHash(fnv1a(code));
+        CacheEntry cached;
+        std::lock_guard<std::mutex> lock(m_);
+        InFlight& slot = inflight_[rel];
+        if (slot.cancel && slot.hash == hash) return false;   // то же самое уже анализируется
+        if (!slot.cancel && cache_.get(rel, cached) && cached.hash == hash) return false;
+
+        // Прежний запрос устарел — обрываем, его результат не сохранится
+        if (slot.cancel) {
+            slot.cancel->store(true);
+            print("=== [" + clockTime() + "] " + rel + ": изменен снова, прежний запрос отменен ===\n");
+        }
+        slot.generation = ++generation_;
+        slot.hash = hash;
+        slot.cancel = std::make_shared<std::atomic<bool>>(false);
+        pool_.submit([this, rel, code = std::move(code), hash, gen = slot.generation, cancel = slot.cancel] {
+            RequestCancelScope scope(cancel.get());
+            try {
+                analyze(rel, code, hash, gen);
+            } catch (const std::exception& e) {
+                finish(rel, gen, nullptr, "Ошибка анализа: " + std::string(e.what()));
+            }
+        });
+        return true;
+    }
+
+    void remove(const std::string& rel) {
+        std::lock_guard<std::mutex> lock(m_);
+        auto it = inflight_.find(rel);
+        if (it != inflight_.end()) {
+            if (it->second.cancel) it->second.cancel->store(true);
+            inflight_.erase(it);
+        }
+        cache_.erase(rel);
+        print("=== [" + clockTime() + "] " + rel + ": удален ===\n\n");
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            for (auto& [rel, slot] : inflight_) {
+                if (slot.cancel) slot.cancel->store(true);
+            }
+        }
+        pool_.wait();
+    }
+
+private:
+    void analyze(const std::string& rel, const std::string& code, const std::string& hash, uint64_t gen) {
+        const auto started = Clock::now();
+        const std::string language = detectSourceLanguage(code, rel).language;
+        if (language == "auto" || (opts_.files.language != "any" && language != opts_.files.language)) {
+            finish(rel, gen, nullptr, {});
+            return;
+        }
+
+        CacheEntry entry;
+        entry.hash = hash;
+        entry.language = language;
+        entry.lines = lineHashes(code);
+
+        CacheEntry base;
+        const bool has_base = cache_.get(rel, base) && base.language == language;
+        const PrepassResult prepass = runPrepass(code, language, rel, agent_.prepassRules());
+        std::string what;
+        std::string err;
+
+        if (prepass.decision == PrepassDecision::Skip) {
+            entry.report = localOnlyReport(prepass);
+            what = "без модели";
+        } else if (!has_base || !incremental(code, language, base, entry, prepass, what, err)) {
+            if (!err.empty()) {
+                finish(rel, gen, nullptr, err);
+                return;
+            }
+            auto result = agent_.analyzeSource(code, language, &err);
+            if (!result) {
+                finish(rel, gen, nullptr, err);
+                return;
+            }
+            entry.report = addLocalFindings(*result, prepass.findings);
+            what = "весь файл";
+        }
+
+        const double secs = std::chrono::duration<double>(Clock::now() - started).count();
+        std::ostringstream head;
+        head << "=== [" << clockTime() << "] " << rel << " (" << languageDisplayName(language) << ", "
+             << what << ", " << std::fixed << std::setprecision(1) << secs << " с) ===\n";
+        const std::string text = head.str() + entry.report + "\n";
+        finish(rel, gen, &entry, text);
+    }
+
+    // Анализ только функций вокруг измененного участка; замечания прошлого
+    // отчета вне участка переносятся со сдвигом номеров строк. false —
+    // изменено слишком много или прошлый отчет не разобрать (err пустой),
+    // либо запрос не удался (err)
+    bool incremental(const std::string& code, const std::string& language, const CacheEntry& base,
+                     CacheEntry& entry, const PrepassResult& prepass, std::string& what, std::string& err) {
+        AnalysisReport old_report;
+        if (base.lines.empty() || !parseAnalysisReport(base.report, old_report)) return false;
+
+        const std::vector<uint32_t>& a = base.lines;
+        const std::vector<uint32_t>& b = entry.lines;
+        size_t prefix = 0;
+        while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) ++prefix;
+        size_t suffix = 0;
+        while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+               a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) ++suffix;
+        const size_t changed_old = a.size() - prefix - suffix;
+        const size_t changed_new = b.size() - prefix - suffix;
+        if (b.empty() || (double)std::max(changed_old, changed_new) > opts_.full_reanalysis_ratio * b.size()) {
+            return false;
+        }
+
+        LineSpan span;
+        span.first = prefix + 1;
+        span.last = prefix + changed_new;
+        if (changed_new == 0) {   // только удаление: строки исчезли после prefix
+            span.first = std::max<size_t>(1, prefix);
+            span.last = span.first - 1;
+        }
+        const std::vector<SourceChunk> regions = agent_.planRegions(code, language, {span}, opts_.context_lines);
+        if (regions.empty()) return false;
+
+        AnalysisReport fresh;
+        size_t sent = 0;
+        for (const SourceChunk& region : regions) {
+            auto resp = agent_.analyzeRegion(code, region, {span}, language, &err);
+            if (!resp) return false;
+            AnalysisReport part;
+            if (!parseAnalysisReport(*resp, part)) part.assessments.push_back(*resp);
+            anchorToChunk(part, region);
+            mergeReports(fresh, std::move(part));
+            sent += region.last_line - region.first_line + 1;
+        }
+
+        // Прошлые замечания: внутри переанализированных строк — выбрасываются,
+        // после них — сдвигаются на разницу в длине файла
+        const long delta = (long)b.size() - (long)a.size();
+        const long first = (long)regions.front().first_line;
+        const long last_old = (long)regions.back().last_line - delta;
+        auto shift = [&](std::vector<CodeIssue>& issues) {
+            std::vector<CodeIssue> kept;
+            for (CodeIssue issue : issues) {
+                if (issue.line >= first && issue.line <= last_old) continue;
+                if (issue.line > last_old) issue.line += (int)delta;
+                kept.push_back(std::move(issue));
+            }
+            issues = std::move(kept);
+        };
+        shift(old_report.errors);
+        shift(old_report.recommendations);
+        // Оценки прежних фрагментов ("Строки a–b: ...") заменяются новыми
+        old_report.assessments.erase(
+            std::remove_if(old_report.assessments.begin(), old_report.assessments.end(),
+                           [](const std::string& s) { return s.rfind("Строки ", 0) == 0; }),
+            old_report.assessments.end());
+
+        mergeReports(old_report, std::move(fresh));
+        mergeReports(old_report, prepass.findings);
+        entry.report = formatAnalysisReport(old_report);
+
+        std::ostringstream w;
+        w << "изменены строки " << span.first << "–" << std::max(span.first, span.last)
+          << ", отправлено " << sent << " из " << b.size() << " строк";
+        what = w.str();
+        return true;
+    }
+
+    // Результат применяется, только если за это время файл не поменялся снова
+    void finish(const std::string& rel, uint64_t gen, CacheEntry* entry, const std::string& text) {
+        std::lock_guard<std::mutex> lock(m_);
+        auto it = inflight_.find(rel);
+        if (it == inflight_.end() || it->second.generation != gen) return;
+        const bool cancelled = it->second.cancel->load();
+        it->second.cancel.reset();
+        if (cancelled) return;
+        if (entry) {
+            cache_.put(rel, std::move(*entry));
+        } else if (!text.empty()) {
+            print("=== [" + clockTime() + "] " + rel + " ===\n" + text + "\n\n");
+            return;
+        }
+        print(text);
+    }
+
+    void print(const std::string& text) {
+        std::lock_guard<std::mutex> lock(out_m_);
+        out_ << text;
+        out_.flush();
+    }
+
+    const AiAgent& agent_;
+    fs::path root_;
+    const WatchOptions& opts_;
+    std::ostream& out_;
+    AnalysisCache cache_;
+    std::mutex m_;
+    std::mutex out_m_;
+    std::unordered_map<std::string, InFlight> inflight_;
+    uint64_t generation_ = 0;
+    WorkStealingPool pool_;   // последним: потоки останавливаются до разрушения остального
+};
+
+}
+
+bool watchDirectory(const AiAgent& agent, const std::string& root, const WatchOptions& opts,
+                    const std::atomic<bool>& stop, std::ostream& out, std::string* err) {
+    std::string walk_err;
+    const std::vector<SourceFile> files = collectSourceFiles(root, opts.files, &walk_err);
+    if (!walk_err.empty()) {
+        if (err) *err = walk_err;
+        return false;
+    }
+
+    InotifyWatcher inotify;
+    if (!inotify.open(root, opts.files, err)) return false;
+
+    Watcher watcher(agent, root, opts, out);
+    watcher.cache().load();
+
+    // Старт: неизмененные с прошлого запуска файлы берутся из кэша
+    size_t queued = 0;
+    for (const auto& f : files) queued += watcher.schedule(f.rel);
+    out << "Слежу за " << root << " (" << inotify.directories() << " каталогов, " << files.size()
+        << " файлов; без изменений с прошлого запуска: " << files.size() - queued
+        << ", на анализ: " << queued << "). Ctrl+C — выход\n\n";
+    out.flush();
+
+    // Сохранения подряд (редактор пишет файл в несколько приемов, форматтер
+    // правит его сразу после) склеиваются: файл анализируется, когда по нему
+    // debounce_ms не было событий
+    std::map<std::string, Clock::time_point> pending;
+    auto last_save = Clock::now();
+    while (!stop.load()) {
+        std::set<std::string> changed, removed;
+        inotify.poll(100, changed, removed);
+        const auto now = Clock::now();
+        for (const auto& rel : changed) pending[rel] = now;
+        for (const auto& rel : removed) {
+            pending.erase(rel);
+            watcher.remove(rel);
+        }
+
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (now - it->second < std::chrono::milliseconds(opts.debounce_ms)) {
+                ++it;
+                continue;
+            }
+            watcher.schedule(it->first);
+            it = pending.erase(it);
+        }
+
+        if (watcher.cache().dirty() && now - last_save > std::chrono::seconds(2)) {
+            watcher.cache().save();
+            last_save = now;
+        }
+    }
+
+    out << "\nОстановка: незавершенные запросы отменены\n";
+    watcher.stop();
+    if (!watcher.cache().save()) {
+        if (err) *err = "Не удалось сохранить кэш";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "DirectoryAnalyzer.h"
+#include <atomic>
+#include <ostream>
+#include <string>
+
+class AiAgent;
+
+// Параметры analyze --watch
+struct WatchOptions {
+    DirAnalysisOptions files;           // какие файлы смотреть (include/exclude/lang/max-size, jobs)
+    unsigned debounce_ms = 300;         // тишина после последнего события до анализа
+    std::string cache_path;             // пусто — <каталог>/.ai_agent_cache.json
+    size_t context_lines = 3;           // окно вокруг изменения в огромной функции
+    // Изменено больше этой доли строк файла — анализируется весь файл
+    double full_reanalysis_ratio = 0.5;
+};
+
+// Непрерывный анализ каталога (inotify): после сохранения файла заново
+// анализируется только он, а если есть прошлый отчет — только функции
+// вокруг измененных строк (SourceChunker.h, как в analyze --diff); остальные
+// замечания сдвигаются на новые номера строк. Файл сравнивается по хешу
+// содержимого, запрос по файлу, который успели изменить еще раз, отменяется
+// (RequestCancelScope). Отчеты и хеши строк хранятся в кэше, так что после
+// перезапуска неизмененные файлы модели не отправляются.
+// Работает, пока не поднят stop (SIGINT в main); false — не удалось начать (err)
+bool watchDirectory(const AiAgent& agent, const std::string& root, const WatchOptions& opts,
+                    const std::atomic<bool>& stop, std::ostream& out, std::string* err = nullptr);
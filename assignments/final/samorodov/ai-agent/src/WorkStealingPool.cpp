@@ -0,0 +1,120 @@
+#include "WorkStealingPool.h"
+
+namespace {
+// Пул и номер очереди текущего потока; nullptr — поток не из пула
+thread_local const WorkStealingPool* tls_pool = nullptr;
+thread_local unsigned tls_index = 0;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned workers) {
+    if (workers == 0) workers = 1;
+    for (unsigned i = 0; i < workers; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < workers; ++i) {
+        threads_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::unique_lock<std::mutex> lock(state_m_);
+        done_cv_.wait(lock, [this] { return pending_ == 0; });
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void WorkStealingPool::submit(Task task) {
+    const bool nested = tls_pool == this;
+    unsigned target = tls_index;
+    // Счётчики растут до того, как задачу увидят: поток, вернувшийся из
+    // прошлой задачи, зовёт take() сразу и может выполнить её раньше, чем
+    // submit() дойдёт до следующей строки
+    {
+        std::lock_guard<std::mutex> lock(state_m_);
+        if (!nested) target = next_queue_++ % queues_.size();
+        ++queued_;
+        ++pending_;
+    }
+    try {
+        std::lock_guard<std::mutex> lock(queues_[target]->m);
+        if (nested) queues_[target]->tasks.push_front(std::move(task));
+        else queues_[target]->tasks.push_back(std::move(task));
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(state_m_);
+        --queued_;
+        if (--pending_ == 0) done_cv_.notify_all();
+        throw;
+    }
+    work_cv_.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(state_m_);
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+    if (error_) {
+        std::exception_ptr e = error_;
+        error_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+bool WorkStealingPool::take(unsigned self, Task& out) {
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.m);
+        if (!own.tasks.empty()) {
+            out = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // Своё кончилось — крадём у соседей, начиная со следующего
+    const unsigned n = (unsigned)queues_.size();
+    for (unsigned k = 1; k < n; ++k) {
+        Queue& victim = *queues_[(self + k) % n];
+        std::lock_guard<std::mutex> lock(victim.m);
+        if (!victim.tasks.empty()) {
+            out = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned self) {
+    tls_pool = this;
+    tls_index = self;
+
+    Task task;
+    while (true) {
+        if (!take(self, task)) {
+            std::unique_lock<std::mutex> lock(state_m_);
+            // queued_ растёт до push и уменьшается после take(), поэтому
+            // queued_ > 0 при пустых очередях лишь означает, что задачу как
+            // раз кладут или забирают
+            work_cv_.wait(lock, [this] { return queued_ > 0 || stop_; });
+            if (stop_ && queued_ == 0) return;
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_m_);
+            --queued_;
+        }
+
+        std::exception_ptr failure;
+        try {
+            task();
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        task = nullptr;  // захваченное задачей освобождается до отчёта о ней
+
+        std::lock_guard<std::mutex> lock(state_m_);
+        if (failure && !error_) error_ = failure;
+        if (--pending_ == 0) done_cv_.notify_all();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с кражей задач.
+//
+// У каждого потока своя очередь. Снаружи задачи раздаются по кругу в хвосты
+// очередей, а подзадача, отправленная из потока пула, встаёт в голову его же
+// очереди. Поток берёт свои задачи с головы: внешние — в порядке отправки
+// (так результаты analyze-dir готовы примерно по порядку), свои подзадачи —
+// сразу. Опустевший поток крадёт с хвоста чужой очереди — самую дальнюю
+// работу. Так один долгий файл не держит за собой очередь остальных, а
+// фрагменты большого файла разбирают простаивающие соседи.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(unsigned workers);
+    ~WorkStealingPool();  // дожидается уже отправленных задач
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(Task task);
+
+    // Дождаться выполнения всех отправленных задач. Первое исключение
+    // из задачи пробрасывается здесь (остальные задачи при этом доделываются)
+    void wait();
+
+    unsigned size() const { return (unsigned)queues_.size(); }
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(unsigned self);
+    bool take(unsigned self, Task& out);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex state_m_;
+    std::condition_variable work_cv_;   // появились задачи или стоп
+    std::condition_variable done_cv_;   // pending_ стал 0
+    size_t queued_ = 0;                 // лежат в очередях
+    size_t pending_ = 0;                // отправлены и ещё не выполнены
+    unsigned next_queue_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+};
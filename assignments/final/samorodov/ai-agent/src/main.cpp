@@ -1,27 +1,59 @@
 #include "AiAgent.h"
+#include "DirectoryAnalyzer.h"
+#include "DiffAnalyzer.h"
+#include "WatchMode.h"
+#include "LanguageDetector.h"
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
 
 namespace fs = std::filesystem;
 
+static std::atomic<bool> g_stop{false};
+
+static void onInterrupt(int) {
+    g_stop.store(true);
+}
+
 void printUsage() {
-    std::cout << "AI Code Analyzer - Анализ кода на C++ и Python\n\n";
+    std::cout << "AI Code Analyzer - Анализ исходного кода (C++, C, Python, Java, JS/TS, Go, Rust, shell)\n\n";
     std::cout << "Использование:\n";
     std::cout << "  ./ai_agent analyze <файл> [язык]   - Анализ файла\n";
+    std::cout << "  ./ai_agent analyze --diff [диапазон] [параметры] - Анализ только измененного кода (git diff)\n";
+    std::cout << "  ./ai_agent analyze --watch <каталог> [параметры] - Повторный анализ при сохранении файлов\n";
+    std::cout << "  ./ai_agent analyze-dir <каталог> [параметры] - Анализ всех исходников каталога\n";
     std::cout << "  ./ai_agent code \"<код>\" [язык]     - Анализ кода из строки\n";
     std::cout << "  ./ai_agent interactive             - Интерактивный режим\n";
-    std::cout << "  ./ai_agent saved                   - Показать сохраненные ответы\n";
+    std::cout << "  ./ai_agent saved [параметры]       - Показать сохраненные ответы\n";
     std::cout << "  ./ai_agent clear                   - Очистить сохраненные ответы\n";
+    std::cout << "  ./ai_agent stats                   - Сжатие сохраненных ответов\n";
+    std::cout << "  ./ai_agent export-session <файл>   - Выгрузить сохраненные ответы в файл\n";
+    std::cout << "  ./ai_agent import-session <файл>   - Загрузить ответы из файла\n";
     std::cout << "  ./ai_agent help                    - Показать справку\n\n";
     
     std::cout << "Параметры:\n";
-    std::cout << "  язык: cpp, python, auto (определить автоматически)\n\n";
+    std::cout << "  язык: cpp, c, python, java, javascript, typescript, go, rust, shell,\n";
+    std::cout << "        auto (определить по содержимому, расширению и #!)\n";
+    std::cout << "  saved: --offset N, --limit N (по умолчанию 10, 0 — все),\n";
+    std::cout << "         --since/--until \"YYYY-MM-DD[ HH:MM:SS]\" (UTC), --grep <текст>\n";
+    std::cout << "  analyze-dir: --jobs N (по умолчанию 4), --include <glob>, --exclude <glob>\n";
+    std::cout << "         (можно повторять), --lang <язык>|any, --max-size <байт>, --slowest N\n";
+    std::cout << "  analyze --diff: диапазон git (main..HEAD, HEAD~3; без него — незакоммиченные\n";
+    std::cout << "         изменения), --jobs N, --context N, --repo <каталог>, --lang <язык>\n";
+    std::cout << "  analyze --watch: параметры analyze-dir, а также --debounce <мс> (300),\n";
+    std::cout << "         --cache <файл> (<каталог>/.ai_agent_cache.json), --context N\n\n";
     
     std::cout << "Примеры:\n";
     std::cout << "  ./ai_agent analyze main.cpp\n";
     std::cout << "  ./ai_agent analyze script.py python\n";
+    std::cout << "  ./ai_agent analyze --diff origin/main..HEAD --jobs 4\n";
+    std::cout << "  ./ai_agent analyze --watch src --jobs 2\n";
+    std::cout << "  ./ai_agent analyze-dir src --jobs 8 --exclude \"third_party\" --lang cpp\n";
     std::cout << "  ./ai_agent code \"def test(): return 1\" python\n";
     std::cout << "  ./ai_agent interactive\n";
+    std::cout << "  ./ai_agent saved --since 2024-05-01 --grep \"утечка памяти\" --limit 0\n";
 }
 
 bool fileExists(const std::string& path) {
@@ -68,7 +100,82 @@ int main(int argc, char* argv[]) {
     
     std::string command = argv[1];
     
-    if (command == "analyze" && argc >= 3) {
+    if (command == "analyze" && argc >= 3 && std::string(argv[2]) == "--diff") {
+        DiffAnalysisOptions opts;
+        int i = 3;
+        if (i < argc && std::string(argv[i]).compare(0, 2, "--") != 0) opts.range = argv[i++];
+        for (; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Не указано значение для " << opt << "\n";
+                return 1;
+            }
+            std::string value = argv[++i];
+            try {
+                if (opt == "--jobs") opts.jobs = (unsigned)std::max(1, std::stoi(value));
+                else if (opt == "--context") opts.context_lines = std::stoul(value);
+                else if (opt == "--repo") opts.repo = value;
+                else if (opt == "--lang") opts.language = value;
+                else {
+                    std::cerr << "Неизвестный параметр: " << opt << "\n";
+                    return 1;
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Неверное число для " << opt << ": " << value << "\n";
+                return 1;
+            }
+        }
+        if (opts.language != "auto" && !isKnownLanguage(opts.language)) {
+            std::cerr << "Неизвестный язык: " << opts.language << "\n";
+            return 1;
+        }
+
+        if (!analyzeDiff(agent, opts, std::cout, &err)) {
+            if (!err.empty()) std::cerr << "Ошибка: " << err << "\n";
+            return 1;
+        }
+
+    } else if (command == "analyze" && argc >= 4 && std::string(argv[2]) == "--watch") {
+        std::string root = argv[3];
+        WatchOptions opts;
+        for (int i = 4; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Не указано значение для " << opt << "\n";
+                return 1;
+            }
+            std::string value = argv[++i];
+            try {
+                if (opt == "--jobs") opts.files.jobs = (unsigned)std::max(1, std::stoi(value));
+                else if (opt == "--include") opts.files.include.push_back(value);
+                else if (opt == "--exclude") opts.files.exclude.push_back(value);
+                else if (opt == "--lang") opts.files.language = value;
+                else if (opt == "--max-size") opts.files.max_file_bytes = std::stoull(value);
+                else if (opt == "--debounce") opts.debounce_ms = (unsigned)std::stoul(value);
+                else if (opt == "--cache") opts.cache_path = value;
+                else if (opt == "--context") opts.context_lines = std::stoul(value);
+                else {
+                    std::cerr << "Неизвестный параметр: " << opt << "\n";
+                    return 1;
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Неверное число для " << opt << ": " << value << "\n";
+                return 1;
+            }
+        }
+        if (opts.files.language != "any" && !isKnownLanguage(opts.files.language)) {
+            std::cerr << "Неизвестный язык: " << opts.files.language << "\n";
+            return 1;
+        }
+
+        std::signal(SIGINT, onInterrupt);
+        std::signal(SIGTERM, onInterrupt);
+        if (!watchDirectory(agent, root, opts, g_stop, std::cout, &err)) {
+            std::cerr << "Ошибка: " << err << "\n";
+            return 1;
+        }
+
+    } else if (command == "analyze" && argc >= 3) {
         std::string filename = argv[2];
         std::string language = (argc >= 4) ? argv[3] : "auto";
         
@@ -85,6 +192,42 @@ int main(int argc, char* argv[]) {
         
         std::cout << *result << "\n";
         
+    } else if (command == "analyze-dir" && argc >= 3) {
+        std::string root = argv[2];
+        DirAnalysisOptions opts;
+        for (int i = 3; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Не указано значение для " << opt << "\n";
+                return 1;
+            }
+            std::string value = argv[++i];
+            try {
+                if (opt == "--jobs") opts.jobs = (unsigned)std::max(1, std::stoi(value));
+                else if (opt == "--include") opts.include.push_back(value);
+                else if (opt == "--exclude") opts.exclude.push_back(value);
+                else if (opt == "--lang") opts.language = value;
+                else if (opt == "--max-size") opts.max_file_bytes = std::stoull(value);
+                else if (opt == "--slowest") opts.slowest = std::stoul(value);
+                else {
+                    std::cerr << "Неизвестный параметр: " << opt << "\n";
+                    return 1;
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Неверное число для " << opt << ": " << value << "\n";
+                return 1;
+            }
+        }
+        if (opts.language != "any" && !isKnownLanguage(opts.language)) {
+            std::cerr << "Неизвестный язык: " << opts.language << "\n";
+            return 1;
+        }
+
+        if (!analyzeDirectory(agent, root, opts, std::cout, &err)) {
+            if (!err.empty()) std::cerr << "Ошибка: " << err << "\n";
+            return 1;
+        }
+        
     } else if (command == "code" && argc >= 3) {
         std::string code = argv[2];
         std::string language = (argc >= 4) ? argv[3] : "auto";
@@ -101,16 +244,54 @@ int main(int argc, char* argv[]) {
         agent.runInteractiveMode();
         
     } else if (command == "saved") {
-        auto responses = agent.getSavedResponses();
-        if (responses.empty()) {
-            std::cout << "Нет сохраненных ответов\n";
-        } else {
-            std::cout << "=== СОХРАНЕННЫЕ ОТВЕТЫ (" << responses.size() << ") ===\n";
-            for (size_t i = 0; i < responses.size(); ++i) {
-                std::cout << "[" << (i+1) << "] " << responses[i].timestamp << "\n";
-                std::cout << responses[i].response << "\n---\n";
+        SavedQuery query;
+        query.limit = 10;
+        for (int i = 2; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Не указано значение для " << opt << "\n";
+                return 1;
+            }
+            std::string value = argv[++i];
+            try {
+                if (opt == "--offset") query.offset = std::stoll(value);
+                else if (opt == "--limit") query.limit = std::stoll(value);
+                else if (opt == "--since") query.since = value;
+                else if (opt == "--until") query.until = value;
+                else if (opt == "--grep") query.keyword = value;
+                else {
+                    std::cerr << "Неизвестный параметр: " << opt << "\n";
+                    return 1;
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Неверное число для " << opt << ": " << value << "\n";
+                return 1;
             }
         }
+        if (query.limit == 0) query.limit = -1;  // 0 — без ограничения
+
+        auto cursor = agent.querySavedResponses(query, &err);
+        if (!err.empty()) {
+            std::cerr << err << "\n";
+            return 1;
+        }
+
+        // Ответы выводятся по мере чтения, без загрузки всей выборки в память
+        SavedResponse resp;
+        int64_t shown = 0;
+        while (cursor.next(resp)) {
+            if (shown == 0) std::cout << "=== СОХРАНЕННЫЕ ОТВЕТЫ ===\n";
+            ++shown;
+            std::cout << "[" << (query.offset + shown) << "] " << resp.timestamp << "\n";
+            std::cout << resp.text() << "\n---\n";
+        }
+        if (!cursor.error().empty()) {
+            std::cerr << cursor.error() << "\n";
+            return 1;
+        }
+        if (shown == 0) {
+            std::cout << "Нет сохраненных ответов\n";
+        }
         
     } else if (command == "clear") {
         if (agent.clearSavedResponses()) {
@@ -119,6 +300,19 @@ int main(int argc, char* argv[]) {
             std::cout << "✗ Ошибка очистки\n";
         }
         
+    } else if ((command == "export-session" || command == "import-session") && argc >= 3) {
+        const std::string path = argv[2];
+        SavedQuery query;  // экспортируются все ответы
+        const bool ok = (command == "export-session") ? agent.exportResponses(path, query, &err)
+                                                      : agent.importResponses(path, &err);
+        if (!ok) {
+            std::cerr << "Ошибка: " << err << "\n";
+            return 1;
+        }
+        
+    } else if (command == "stats") {
+        std::cout << agent.getStorageStats() << "\n";
+        
     } else if (command == "help" || command == "--help" || command == "-h") {
         printUsage();
         
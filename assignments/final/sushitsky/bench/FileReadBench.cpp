@@ -0,0 +1,159 @@
+// Чтение файла для --file: ifstream + ostringstream против FileView (mmap).
+//
+//   ./file_read_bench [файл] [повторов]
+//
+// Без файла во временный каталог пишется сгенерированный текст (~64 MB).
+// Каждый способ меряется в отдельном процессе (fork), чтобы пиковый RSS
+// одного не смешивался с другим. Файл к этому моменту уже в кэше страниц:
+// меряется работа самого процесса, а не диска.
+#include "FileView.h"
+#include "JsonWriter.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const std::string kInstruction = "Суммаризируй текст:\n";
+const std::string kModeSuffix = " (режим суммаризации)";
+
+std::string writeSyntheticFile(size_t target) {
+    static const char* lines[] = {
+        "Протокол встречи от 12 марта: обсудили перенос релиза на \"следующую неделю\".\n",
+        "\tЗадача 1. Переписать разбор конфигурации, C:\\\\config\\\\app.json больше не нужен.\n",
+        "Решение: ответственный — Иванов, срок — пятница.\r\n",
+        "The quick brown fox jumps over the lazy dog; 0123456789.\n\n",
+    };
+    char path[] = "/tmp/file_read_bench_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) return {};
+    std::string block;
+    for (size_t i = 0; block.size() < (1u << 20); ++i) block += lines[i % (sizeof(lines) / sizeof(*lines))];
+    for (size_t written = 0; written < target; written += block.size()) {
+        if (write(fd, block.data(), block.size()) != (ssize_t)block.size()) break;
+    }
+    close(fd);
+    return path;
+}
+
+// Тело запроса local_http, как в AiAgent::execute()
+void writeBody(std::string& body, std::initializer_list<std::string_view> user) {
+    size_t reserve = 512;
+    for (std::string_view part : user) reserve += part.size();
+    json_writer::Writer w(body, reserve);
+    w.beginObject()
+        .field("model", "local-gguf")
+        .beginArray("messages")
+            .beginObject().field("role", "system").field("content", "Ты — полезный AI-ассистент.").endObject()
+            .beginObject().field("role", "user").field("content", user).endObject()
+        .endArray()
+        .field("max_tokens", 500)
+    .endObject();
+}
+
+// Как было: файл -> ostringstream -> строка -> команда -> промпт -> тело
+bool viaStream(const std::string& path, std::string& body) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    const std::string content = ss.str();
+    const std::string command = kInstruction + content;
+    const std::string prompt = command + kModeSuffix;
+    writeBody(body, {prompt});
+    return true;
+}
+
+// Теперь: файл отображен в память и экранируется прямо в тело
+bool viaView(const std::string& path, std::string& body) {
+    FileView file;
+    if (!file.open(path)) return false;
+    writeBody(body, {kInstruction, file.view(), kModeSuffix});
+    return true;
+}
+
+long currentRssKb() {
+    long pages = 0, resident = 0;
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Замер в дочернем процессе: время на повтор и прирост пикового RSS
+void runChild(const char* name, const std::function<bool(std::string&)>& fn, int reps, size_t bytes) {
+    std::cout.flush();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        std::perror("fork");
+        return;
+    }
+    if (pid > 0) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return;
+    }
+
+    const long start_kb = currentRssKb();
+    std::string body;
+    if (!fn(body)) {
+        std::cerr << "  " << name << ": не удалось прочитать файл\n";
+        _exit(1);
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; ++i) fn(body);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / reps;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    std::cout << "  " << name << ": " << ms << " ms/файл, "
+              << (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) << " MB/s, пиковый RSS +"
+              << (ru.ru_maxrss - start_kb) / 1024 << " MB (тело запроса " << body.size() / (1024 * 1024)
+              << " MB)\n";
+    std::cout.flush();
+    _exit(0);
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : writeSyntheticFile(64u << 20);
+    const bool temporary = argc <= 1;
+    if (path.empty()) {
+        std::cerr << "Cannot create temporary file\n";
+        return 1;
+    }
+    const int reps = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    std::string check;
+    if (!FileView::readAll(path, check)) {
+        std::cerr << "Cannot open " << path << "\n";
+        return 1;
+    }
+    const size_t bytes = check.size();
+    // Оба способа должны давать одно и то же тело
+    std::string a, b;
+    viaStream(path, a);
+    viaView(path, b);
+    if (a != b) {
+        std::cerr << "Bodies differ\n";
+        return 1;
+    }
+    check = std::string();
+    a = std::string();
+    b = std::string();
+
+    std::cout << "Файл: " << bytes / 1024 << " KB, повторов: " << reps << "\n";
+    runChild("ifstream + ostringstream", [&](std::string& body) { return viaStream(path, body); }, reps, bytes);
+    runChild("FileView (mmap)", [&](std::string& body) { return viaView(path, body); }, reps, bytes);
+
+    if (temporary) std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Сравнение json_writer с json::dump() на теле запроса с большим промптом.
+//
+//   ./request_writer_bench [файл] [повторов]
+//
+// Без файла промптом служит сгенерированный исходник (~4 MB): код с
+// кавычками, табами, переводами строк и кириллицей в комментариях.
+#include "JsonWriter.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <functional>
+
+using nlohmann::json;
+
+namespace {
+
+std::string syntheticSource(size_t target) {
+    static const char* lines[] = {
+        "#include <string>\n",
+        "// Разбор строки конфигурации: ключ=\"значение\"\n",
+        "static int parse(const char* s, size_t n) {\n",
+        "\tif (s[0] == '\\\\') return -1;  /* экранирование */\n",
+        "\tprintf(\"value: %s\\n\", s);\n",
+        "\tfor (size_t i = 0; i < n; ++i) total += weights[i] * values[i];\n",
+        "\treturn (int)total;\r\n",
+        "}\n\n",
+    };
+    std::string out;
+    out.reserve(target + 128);
+    for (size_t i = 0; out.size() < target; ++i) out += lines[i % (sizeof(lines) / sizeof(*lines))];
+    return out;
+}
+
+std::string buildWithDom(const std::string& prompt) {
+    json messages;
+    messages.push_back({{"role", "system"}, {"content", "Ты — полезный AI-ассистент."}});
+    messages.push_back({{"role", "user"}, {"content", prompt}});
+    json payload = {
+        {"model", "local-gguf"},
+        {"messages", messages},
+        {"max_tokens", 500},
+        {"temperature", 0.7},
+        {"top_p", 0.9}
+    };
+    return payload.dump();
+}
+
+void buildWithWriter(std::string& body, const std::string& prompt, json_writer::Simd simd) {
+    body.clear();
+    body += "{\"model\":\"local-gguf\",\"messages\":[{\"role\":\"system\",\"content\":\"Ты — полезный AI-ассистент.\"},"
+            "{\"role\":\"user\",\"content\":\"";
+    json_writer::appendEscaped(body, prompt, simd);
+    body += "\"}],\"max_tokens\":500,\"temperature\":0.7,\"top_p\":0.9}";
+}
+
+void buildWithWriterApi(std::string& body, const std::string& prompt) {
+    json_writer::Writer w(body, prompt.size() + 512);
+    w.beginObject()
+        .field("model", "local-gguf")
+        .beginArray("messages")
+            .beginObject().field("role", "system").field("content", "Ты — полезный AI-ассистент.").endObject()
+            .beginObject().field("role", "user").field("content", prompt).endObject()
+        .endArray()
+        .field("max_tokens", 500)
+        .field("temperature", 0.7)
+        .field("top_p", 0.9)
+    .endObject();
+}
+
+double measure(int reps, const std::function<void()>& fn) {
+    fn();  // прогрев
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; ++i) fn();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count() / reps;
+}
+
+void report(const char* name, double ms, size_t bytes, double base_ms) {
+    std::cout << "  " << name << ": " << ms << " ms/запрос, "
+              << (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) << " MB/s";
+    if (base_ms > 0) std::cout << ", x" << base_ms / ms;
+    std::cout << "\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string prompt;
+    if (argc > 1) {
+        std::ifstream in(argv[1], std::ios::binary);
+        if (!in) { std::cerr << "Cannot open " << argv[1] << "\n"; return 1; }
+        std::ostringstream ss; ss << in.rdbuf();
+        prompt = ss.str();
+    } else {
+        prompt = syntheticSource(4 << 20);
+    }
+    int reps = argc > 2 ? std::stoi(argv[2]) : 20;
+
+    // Экранирование должно совпадать с dump() байт в байт
+    const std::string expected = json(prompt).dump();
+    std::string body;
+    for (auto simd : {json_writer::Simd::Scalar, json_writer::Simd::SSE2, json_writer::Simd::AVX2}) {
+        if (simd > json_writer::detectSimd()) continue;
+        body = "\"";
+        json_writer::appendEscaped(body, prompt, simd);
+        body += "\"";
+        if (body != expected) {
+            std::cerr << "Mismatch with json::dump() (" << json_writer::simdName(simd) << ")\n";
+            return 1;
+        }
+    }
+    buildWithWriterApi(body, prompt);
+    if (json::parse(body) != json::parse(buildWithDom(prompt))) {
+        std::cerr << "Writer output differs from DOM payload\n";
+        return 1;
+    }
+
+    std::cout << "Промпт: " << prompt.size() / 1024 << " KB, повторов: " << reps
+              << ", лучший SIMD: " << json_writer::simdName(json_writer::detectSimd()) << "\n";
+
+    std::string dom_body;
+    double dom_ms = measure(reps, [&] { dom_body = buildWithDom(prompt); });
+    report("json payload + dump()", dom_ms, prompt.size(), 0);
+
+    for (auto simd : {json_writer::Simd::Scalar, json_writer::Simd::SSE2, json_writer::Simd::AVX2}) {
+        if (simd > json_writer::detectSimd()) continue;
+        double ms = measure(reps, [&] { buildWithWriter(body, prompt, simd); });
+        std::string name = std::string("json_writer (") + json_writer::simdName(simd) + ")";
+        report(name.c_str(), ms, prompt.size(), dom_ms);
+    }
+    double api_ms = measure(reps, [&] { buildWithWriterApi(body, prompt); });
+    report("json_writer::Writer", api_ms, prompt.size(), dom_ms);
+    return 0;
+}
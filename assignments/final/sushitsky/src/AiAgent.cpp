@@ -1,11 +1,15 @@
 #include "AiAgent.h"
-#include <fstream>
 #include <sstream>
 #include <vector>
 #include <cstring>
 
 #include <iostream> //CLI
 #include <algorithm> //CLI
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <cstdlib>
+#include <csignal>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -14,6 +18,11 @@
 #include <unistd.h>
 
 #include "curl/curl.h"
+#include "SessionArchive.h"
+#include "AnswerExtractor.h"
+#include "JsonWriter.h"
+#include "DocumentSummarizer.h"
+#include "StreamSummarizer.h"
 
 using nlohmann::json;
 
@@ -22,7 +31,6 @@ AiAgent::AiAgent() {
 #ifdef NO_SQLITE
     context_enabled_ = false;
 #else
-    db_ = nullptr;
     context_enabled_ = false;
     
     // Устанавливаем абсолютный путь к базе данных в текущей директории
@@ -42,11 +50,7 @@ AiAgent::~AiAgent() {
 
 // --------- utils IO ----------
 bool AiAgent::readWholeFile(const std::string& path, std::string& out, std::string* err) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) { if (err) *err = "Cannot open file: " + path; return false; }
-    std::ostringstream ss; ss << f.rdbuf();
-    out = std::move(ss).str();
-    return true;
+    return FileView::readAll(path, out, err);
 }
 
 // --------- JSON loaders ----------
@@ -67,6 +71,12 @@ bool AiAgent::loadConfig(const std::string& path, std::string* err) {
         if (j.contains("local_http_port")) cfg_.local_http_port = j.at("local_http_port").get<std::string>();
         if (j.contains("local_model_path")) cfg_.local_model_path = j.at("local_model_path").get<std::string>();
         if (j.contains("local_model_n_ctx")) cfg_.local_model_n_ctx = j.at("local_model_n_ctx").get<int>();
+        if (j.contains("local_model_threads")) cfg_.local_model_threads = j.at("local_model_threads").get<int>();
+        if (j.contains("local_model_gpu_layers")) cfg_.local_model_gpu_layers = j.at("local_model_gpu_layers").get<int>();
+        if (j.contains("summary_chunk_tokens")) cfg_.summary_chunk_tokens = j.at("summary_chunk_tokens").get<int>();
+        if (j.contains("summary_jobs")) cfg_.summary_jobs = std::max(1u, j.at("summary_jobs").get<unsigned>());
+        if (j.contains("stream_interval_sec")) cfg_.stream_interval_sec = j.at("stream_interval_sec").get<unsigned>();
+        if (j.contains("stream_window_kb")) cfg_.stream_window_kb = j.at("stream_window_kb").get<int>();
 
         return true;
     } catch (const std::exception& e) {
@@ -96,26 +106,38 @@ bool AiAgent::loadPrompt(const std::string& path, std::string* err) {
     }
 }
 
-// ------- Простейший разбор JSON: ожидаем { "text": "<строка>" } -------
+// ------- Разбор ответа: ожидаем { "text": "<строка>" } -------
 std::string AiAgent::extractTextFromJsonBody(const std::string& body) {
-    // Если вместе с HTTP-хедерами — отрежем их
-    const auto p = body.find("\r\n\r\n");
-    const std::string json_part = (p != std::string::npos) ? body.substr(p + 4) : body;
+    // Если вместе с HTTP-хедерами — отрежем их (без копирования тела)
+    std::string_view json_part = body;
+    const auto p = json_part.find("\r\n\r\n");
+    if (p != std::string_view::npos) json_part.remove_prefix(p + 4);
 
-    try {
-        auto j = json::parse(json_part);
-        return j.at("text").get<std::string>();  // строго ожидаем поле "text"
-    } catch (...) {
-        return {};
-    }
+    std::string text;
+    if (!extractAnswer(json_part, text)) return {};
+    return text;
+}
+
+// Глобальная инициализация OpenSSL и curl — один раз на процесс.
+// curl_global_init/cleanup не потокобезопасны, поэтому из запросов их
+// больше не зовём: иначе параллельный execute() мог снести curl соседу.
+static void initNetworkOnce() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        SSL_library_init();
+        SSL_load_error_strings();
+        OpenSSL_add_all_algorithms();
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        std::atexit(curl_global_cleanup);
+    });
 }
 
 // -------- Низкоуровневый HTTPS POST на /api/generate --------
 std::optional<std::string> AiAgent::httpsPostGenerate(
-        const AiConfig& cfg, const std::string& jsonBody, std::string* err) {
-    SSL_library_init();
-    SSL_load_error_strings();
-    OpenSSL_add_all_algorithms();
+        const AiConfig& cfg, const std::string& jsonBody, std::string* err,
+        const std::atomic<bool>* cancel) {
+    initNetworkOnce();
+    auto cancelled = [cancel] { return cancel && cancel->load(std::memory_order_relaxed); };
 
     SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
     if (!ctx) { if (err) *err = "SSL_CTX_new failed"; return std::nullopt; }
@@ -138,6 +160,11 @@ std::optional<std::string> AiAgent::httpsPostGenerate(
     }
     freeaddrinfo(res);
 
+    if (cancelled()) {
+        if (err) *err = "Request cancelled";
+        close(sock); SSL_CTX_free(ctx); return std::nullopt;
+    }
+
     SSL* ssl = SSL_new(ctx);
     SSL_set_fd(ssl, sock);
     if (SSL_connect(ssl) <= 0) {
@@ -145,34 +172,50 @@ std::optional<std::string> AiAgent::httpsPostGenerate(
         SSL_free(ssl); close(sock); SSL_CTX_free(ctx); return std::nullopt;
     }
 
-    // HTTP запрос
+    // HTTP запрос: заголовки и тело уходят отдельными SSL_write,
+    // чтобы не склеивать (и не копировать) большое тело с заголовками
     std::ostringstream req;
     req << "POST /api/generate HTTP/1.1\r\n"
         << "Host: " << cfg.host << "\r\n"
         << "Content-Type: application/json\r\n"
         << "Connection: close\r\n";
     if (!cfg.api_key.empty()) req << "x-api-key: " << cfg.api_key << "\r\n";
-    req << "Content-Length: " << jsonBody.size() << "\r\n\r\n"
-        << jsonBody;
+    req << "Content-Length: " << jsonBody.size() << "\r\n\r\n";
 
-    const std::string request_str = req.str();
-    if (SSL_write(ssl, request_str.c_str(), (int)request_str.size()) <= 0) {
+    const std::string request_head = req.str();
+    if (SSL_write(ssl, request_head.data(), (int)request_head.size()) <= 0 ||
+        (!jsonBody.empty() && SSL_write(ssl, jsonBody.data(), (int)jsonBody.size()) <= 0)) {
         if (err) *err = "SSL_write failed";
         SSL_free(ssl); close(sock); SSL_CTX_free(ctx); return std::nullopt;
     }
 
+    // Таймаут ставится только после рукопожатия и отправки запроса: иначе
+    // медленный SSL_connect оборвался бы через 200 мс, даже без отмены.
+    // Чтобы заметить отмену, пока сервер думает, чтение не блокируется дольше 200 мс
+    if (cancel) {
+        struct timeval tv = {0, 200 * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
     char buf[4096];
     std::string response;
-    int bytes;
-    while ((bytes = SSL_read(ssl, buf, sizeof(buf)-1)) > 0) {
-        buf[bytes] = '\0';
-        response += buf;
+    while (true) {
+        int bytes = SSL_read(ssl, buf, sizeof(buf));
+        if (bytes > 0) { response.append(buf, bytes); continue; }
+        // Таймаут чтения (есть только с cancel) — проверяем отмену и ждём дальше
+        if (cancel && !cancelled() && SSL_get_error(ssl, bytes) == SSL_ERROR_WANT_READ) continue;
+        break;
     }
 
     SSL_free(ssl);
     close(sock);
     SSL_CTX_free(ctx);
 
+    if (cancelled()) {
+        if (err) *err = "Request cancelled";
+        return std::nullopt;
+    }
+
     // ----- Используем nlohmann::json для извлечения "text" -----
     std::string text = extractTextFromJsonBody(response);
     if (text.empty()) {
@@ -183,39 +226,77 @@ std::optional<std::string> AiAgent::httpsPostGenerate(
 }
 
 std::optional<std::string> AiAgent::ask(std::string* outErr) const {
-    if (prompt_.empty()) {
+    return execute(AiRequest(prompt_), outErr);
+}
+
+LlamaBackend& AiAgent::llamaBackend() const {
+    std::lock_guard<std::mutex> lock(llama_mutex_);
+    if (!llama_) {
+        LlamaBackend::Options opts;
+        opts.model_path = cfg_.local_model_path;
+        opts.n_ctx = cfg_.local_model_n_ctx;
+        opts.n_threads = cfg_.local_model_threads;
+        opts.n_gpu_layers = cfg_.local_model_gpu_layers;
+        llama_ = std::make_unique<LlamaBackend>(std::move(opts));
+    }
+    return *llama_;
+}
+
+std::optional<std::string> AiAgent::execute(const AiRequest& req, std::string* outErr) const {
+    if (!req.hasPrompt() && req.messages.empty()) {
         if (outErr) *outErr = "Prompt is empty (load it first)";
         return std::nullopt;
     }
+    if (req.cancelled()) {
+        if (outErr) *outErr = "Request cancelled";
+        return std::nullopt;
+    }
+
+    // РАЗНЫЕ ФОРМАТЫ ДЛЯ РАЗНЫХ ТИПОВ МОДЕЛЕЙ.
+    // Тело пишется сразу в буфер, без json-дерева и копии промпта; буфер
+    // свой у каждого потока и живёт между вызовами, так что после первого
+    // большого файла память под запрос больше не выделяется.
+    thread_local std::string body;
+
+    if (cfg_.model_type == "local_lib") {
+        // Модель в процессе: ни тела запроса, ни HTTP
+        return llamaBackend().generate(req, outErr);
+
+    } else if (cfg_.model_type == "local_http") {
+        // Формат OpenAI API для локального сервера:
+        // системный промпт + история + пользовательский запрос
+        size_t reserve = req.prompt.size() + req.attachment.size() + req.system.size() + 512;
+        for (const auto& m : req.messages) reserve += m.content.size() + 64;
+
+        json_writer::Writer w(body, reserve);
+        w.beginObject()
+            .field("model", "local-gguf")
+            .beginArray("messages");
+        if (!req.system.empty()) {
+            w.beginObject().field("role", "system").field("content", req.system).endObject();
+        }
+        for (const auto& m : req.messages) {
+            w.beginObject().field("role", m.role).field("content", m.content).endObject();
+        }
+        if (req.hasPrompt()) {
+            w.beginObject().field("role", "user").field("content", {req.prompt, req.attachment}).endObject();
+        }
+        w.endArray()
+            .field("max_tokens", req.max_tokens)
+            .field("temperature", req.temperature)
+            .field("top_p", req.top_p)
+        .endObject();
+        return localHttpPostGenerate(cfg_, body, outErr, req.cancel);
 
-    // РАЗНЫЕ ФОРМАТЫ ДЛЯ РАЗНЫХ ТИПОВ МОДЕЛЕЙ
-    std::string body;
-    
-    if (cfg_.model_type == "local_http") {
-        // Формат OpenAI API для локального сервера
-        json messages;
-        
-        // Базовый системный промпт + пользовательский запрос
-        std::string system_prompt = "Ты — полезный AI-ассистент. Отвечай кратко и информативно.";
-        messages.push_back({{"role", "system"}, {"content", system_prompt}});
-        messages.push_back({{"role", "user"}, {"content", prompt_}});
-        
-        json payload = {
-            {"model", "local-gguf"},
-            {"messages", messages},
-            {"max_tokens", 500},
-            {"temperature", 0.7},
-            {"top_p", 0.9}
-        };
-        
-        body = payload.dump();
-        return localHttpPostGenerate(cfg_, body, outErr);
-        
     } else {
-        // Оригинальный формат для удаленного API
-        json payload = { {"prompt", prompt_} };
-        body = payload.dump();
-        return httpsPostGenerate(cfg_, body, outErr);
+        // Оригинальный формат для удаленного API: только промпт
+        json_writer::Writer w(body, req.prompt.size() + req.attachment.size() + 32);
+        if (req.messages.empty()) {
+            w.beginObject().field("prompt", {req.prompt, req.attachment}).endObject();
+        } else {
+            w.beginObject().field("prompt", req.flatPrompt()).endObject();
+        }
+        return httpsPostGenerate(cfg_, body, outErr, req.cancel);
     }
 }
 
@@ -226,38 +307,21 @@ std::optional<std::string> AiAgent::ask(std::string* outErr) const {
 
 
 bool AiAgent::initDatabase() {
-    if (sqlite3_open(db_path_.c_str(), &db_) != SQLITE_OK) {
-        std::cerr << "Cannot open database: " << sqlite3_errmsg(db_) << \
-            std::endl;
-        return false;
-    }
-    return createTables();
-}
-
-bool AiAgent::createTables() {
-    const char* sql = "CREATE TABLE IF NOT EXISTS chat_history ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "session_id TEXT NOT NULL,"
-        "role TEXT NOT NULL,"
-        "content TEXT NOT NULL,"
-        "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP"
-        ");"
-        "CREATE INDEX IF NOT EXISTS idx_session ON chat_history(session_id);"
-        "CREATE INDEX IF NOT EXISTS idx_timestamp ON chat_history(timestamp);";
-    
-    char* errMsg = nullptr;
-    if (sqlite3_exec(db_, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
-        std::cerr << "SQL error: " << errMsg << std::endl;
-        sqlite3_free(errMsg);
+    store_ = std::make_unique<ContextStore>(db_path_);
+    std::string err;
+    if (!store_->open(&err)) {
+        std::cerr << err << std::endl;
+        store_.reset();
         return false;
     }
     return true;
 }
 
 void AiAgent::closeDatabase() {
-    if (db_) {
-        sqlite3_close(db_);
-        db_ = nullptr;
+    if (store_) {
+        // close() дожидается записи всей очереди
+        store_->close();
+        store_.reset();
     }
 }
 
@@ -296,106 +360,155 @@ bool AiAgent::disableContext() {
     return true;
 }
 
-bool AiAgent::saveToContext(const std::string& role, const std::string& content) {
+bool AiAgent::saveToContext(ChatRole role, const std::string& content) {
 #ifdef NO_SQLITE
     return false;
 #else
-    if (!context_enabled_ || !db_) {
+    if (!context_enabled_ || !store_) {
         std::cerr << "Context not enabled or database not initialized" << std::endl;
         return false;
     }
 
-    const char* sql = "INSERT INTO chat_history (session_id, role, content) VALUES (?, ?, ?)";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
-        return false;
-    }
-    
-    sqlite3_bind_text(stmt, 1, current_session_.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, role.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, content.c_str(), -1, SQLITE_STATIC);
-    
-    int result = sqlite3_step(stmt);
-    bool success = (result == SQLITE_DONE);
-    
-    if (!success) {
-        std::cerr << "Failed to save to context: " << sqlite3_errmsg(db_) << std::endl;
-    }
-    
-    sqlite3_finalize(stmt);
-    return success;
+    // Запись уходит в фоновый поток и попадает в ближайшую транзакцию
+    return store_->append(current_session_, role, content);
 #endif
 }
 
-std::vector<ChatMessage> AiAgent::getContextHistory(int limit) const {
-    std::vector<ChatMessage> history;
+ChatHistory AiAgent::getContextHistory(int limit) const {
 #ifdef NO_SQLITE
-    return history;
+    return {};
 #else
-    if (!context_enabled_ || !db_) return history;
-
-    const char* sql = "SELECT role, content, timestamp FROM chat_history WHERE session_id = ? ORDER BY timestamp DESC LIMIT ?";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
-        return history;
-    }
-    
-    sqlite3_bind_text(stmt, 1, current_session_.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, limit);
-    
-    int step_result;
-    while ((step_result = sqlite3_step(stmt)) == SQLITE_ROW) {
-        ChatMessage msg;
-        const char* role_ptr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        const char* content_ptr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        const char* timestamp_ptr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        
-        if (role_ptr) msg.role = role_ptr;
-        if (content_ptr) msg.content = content_ptr;
-        if (timestamp_ptr) msg.timestamp = timestamp_ptr;
-        
-        history.push_back(msg);
-    }
-    
-    if (step_result != SQLITE_DONE) {
-        std::cerr << "Error reading context: " << sqlite3_errmsg(db_) << std::endl;
-    }
-    
-    sqlite3_finalize(stmt);
-    
-    // Переворачиваем чтобы получить в хронологическом порядке
-    std::reverse(history.begin(), history.end());
-    return history;
+    if (!context_enabled_ || !store_) return {};
+    return store_->history(current_session_, limit);
 #endif
 }
 
 bool AiAgent::clearContext() {
-    if (!context_enabled_ || !db_) return false;
+    if (!context_enabled_ || !store_) return false;
 
-    const char* sql = "DELETE FROM chat_history WHERE session_id = ?";
-    sqlite3_stmt* stmt;
+    bool success = store_->clear(current_session_);
+    if (success) {
+        std::cout << "Context cleared for session: " << current_session_ << \
+            std::endl;
+    }
+
+    return success;
+}
 
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << \
-            sqlite3_errmsg(db_) << std::endl;
+std::string AiAgent::getContextStats() const {
+    if (!context_enabled_ || !store_) return "Context not enabled";
+
+    auto st = store_->stats(current_session_);
+    std::ostringstream out;
+    out << "Context database: " << db_path_ << " (schema v" << ContextStore::kSchemaVersion << ")\n";
+    out << "  Сообщений: " << st.rows << ", сессий: " << st.sessions << "\n";
+    out << "  Размер базы: " << st.db_bytes / 1024 << " KB, ~" << (int64_t)st.bytes_per_row << " байт на сообщение\n";
+    out << "  Выборка истории (10 сообщений): " << st.history_query_us << " мкс\n";
+    out << "  Сжатие ответов: " << (ContentCodec::available() ? "zstd" : "выключено (собрано без zstd)")
+        << (st.dictionary ? ", со словарём" : ", без словаря") << "\n";
+    if (st.content_stored_bytes > 0) {
+        out << "  Текст сообщений: " << st.content_raw_bytes / 1024 << " KB -> "
+            << st.content_stored_bytes / 1024 << " KB (x"
+            << static_cast<double>(st.content_raw_bytes) / st.content_stored_bytes << ")\n";
+    }
+    out << "  В этом запуске: сжато " << st.codec.encoded << " (" << st.codec.compress_ns / 1000
+        << " мкс CPU), распаковано " << st.codec.decoded << " (" << st.codec.decompress_ns / 1000 << " мкс CPU)";
+    return out.str();
+}
+
+bool AiAgent::exportSession(const std::string& path, std::string* err) {
+    if (!context_enabled_ || !store_) {
+        if (err) *err = "Context not enabled";
         return false;
     }
 
-    sqlite3_bind_text(stmt, 1, current_session_.c_str(), -1, SQLITE_STATIC);
+    const auto started = std::chrono::steady_clock::now();
+    session_archive::Writer writer;
+    nlohmann::json header = {
+        {"kind", "chat_history"},
+        {"session", current_session_},
+        {"schema", ContextStore::kSchemaVersion}
+    };
+    if (!writer.open(path, std::move(header), err)) return false;
+
+    // Сообщения идут в файл кадрами по мере чтения из базы
+    bool write_ok = true;
+    const bool scan_ok = store_->scan(current_session_,
+        [&](ChatRole role, int64_t timestamp_us, std::string_view text) {
+            write_ok = writer.add({{"role", static_cast<int>(role)},
+                                   {"ts_us", timestamp_us},
+                                   {"content", text}}, err);
+            return write_ok;
+        }, err);
+    if (!scan_ok || !write_ok || !writer.finish(err)) {
+        std::remove(path.c_str());  // недописанный файл всё равно не пройдёт проверку
+        return false;
+    }
 
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    sqlite3_finalize(stmt);
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "✓ Exported " << writer.count() << " messages of session '" << current_session_
+              << "' to " << path << " (" << writer.bytes() / 1024 << " KB, "
+              << static_cast<int64_t>(secs * 1000) << " ms)" << std::endl;
+    return true;
+}
 
-    if (success) {
-        std::cout << "Context cleared for session: " << current_session_ << \
-            std::endl;
+bool AiAgent::importSession(const std::string& path, std::string* err) {
+    if (!context_enabled_ || !store_) {
+        if (err) *err = "Context not enabled";
+        return false;
     }
 
-    return success;
+    // Сначала проверяем файл целиком, чтобы не импортировать половину испорченного
+    uint64_t expected = 0;
+    if (!session_archive::Reader::verify(path, err, &expected)) return false;
+
+    session_archive::Reader reader;
+    if (!reader.open(path, err)) return false;
+    if (reader.header().value("kind", "") != "chat_history") {
+        if (err) *err = "Not a chat session archive: " + path;
+        return false;
+    }
+
+    // Одна транзакция: число сообщений сверяется до COMMIT, так что
+    // оборванный или испорченный файл не оставляет в сессии ничего
+    const auto started = std::chrono::steady_clock::now();
+    uint64_t imported = 0;
+    const bool ok = store_->importMessages(current_session_, [&](const ContextStore::AddFn& add) {
+        std::vector<nlohmann::json> records;
+        std::string read_err;
+        while (reader.next(records, &read_err)) {
+            for (const auto& r : records) {
+                try {
+                    if (!add(static_cast<ChatRole>(r.at("role").get<int>()), r.at("ts_us").get<int64_t>(),
+                             r.at("content").get<std::string>())) {
+                        return false;
+                    }
+                } catch (const std::exception& e) {
+                    if (err) *err = std::string("Bad message in archive: ") + e.what();
+                    return false;
+                }
+                ++imported;
+            }
+        }
+        if (!read_err.empty()) {
+            if (err) *err = read_err;
+            return false;
+        }
+        if (imported != expected) {
+            if (err) *err = "Archive declares " + std::to_string(expected) + " messages, read " +
+                            std::to_string(imported);
+            return false;
+        }
+        return true;
+    }, err);
+    if (!ok) return false;
+
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "✓ Imported " << imported << " messages from session '"
+              << reader.header().value("session", "") << "' into '" << current_session_ << "' in "
+              << static_cast<int64_t>(secs * 1000) << " ms ("
+              << static_cast<int64_t>(secs > 0 ? imported / secs : 0) << " msg/s)" << std::endl;
+    return true;
 }
 
 // ============== CLI ==================
@@ -438,6 +551,7 @@ void AiAgent::printCLIUsage() const {
     
     std::cout << "Выбор модели:\n";
     std::cout << "  --local    - использовать локальную модель\n";
+    std::cout << "  --local-lib - локальная модель в процессе (llama.cpp, local_model_path)\n";
     std::cout << "  --remote  - использовать удаленный API\n";
     std::cout << "  --model-info              - показать текущие настройки модели\n\n";
     
@@ -453,7 +567,16 @@ void AiAgent::printCLIUsage() const {
     std::cout << "  --enable-context [сессия] - включить сохранение контекста\n";
     std::cout << "  --disable-context         - выключить контекст\n";
     std::cout << "  --clear-context           - очистить историю текущей сессии\n";
-    std::cout << "  --show-context            - показать историю текущей сессии\n\n";
+    std::cout << "  --show-context            - показать историю текущей сессии\n";
+    std::cout << "  --context-stats           - размер базы и время выборки истории\n";
+    std::cout << "  --export-session <файл>   - сохранить текущую сессию в файл\n";
+    std::cout << "  --import-session <файл>   - добавить сообщения из файла в текущую сессию\n\n";
+    
+    std::cout << "Суммаризация (--mode summary):\n";
+    std::cout << "  --file <файл>             - файл; большой излагается по частям\n";
+    std::cout << "  -  (или --file -)         - поток из stdin, сводки по ходу чтения\n";
+    std::cout << "  --interval <сек>          - сводка потока не реже (по умолчанию 60, 0 — только по размеру)\n";
+    std::cout << "  --window <КБ>             - новых данных потока в одном запросе\n\n";
     
     std::cout << "Примеры:\n";
     std::cout << "  ./ai_agent --cli --local \"привет!\"\n";
@@ -466,13 +589,16 @@ std::string AiAgent::buildPromptForCommand(const std::string& command, CLIMode m
     //ТОЛЬКО пользовательский запрос, системный промпт в методе ask
     std::string final_command = command;
     
+    // local_lib получает историю репликами (addHistoryMessages)
     std::string context_str;
-    if (context_enabled_) {
+    if (context_enabled_ && cfg_.model_type != "local_lib") {
         auto history = getContextHistory(3);
         if (!history.empty()) {
             context_str = "\n\nКонтекст предыдущего разговора:\n";
-            for (const auto& msg : history) {
-                context_str += (msg.role == "user" ? "Пользователь: " : "Ассистент: ") + msg.content + "\n";
+            for (auto& msg : history) {
+                context_str += (msg.role == ChatRole::User ? "Пользователь: " : "Ассистент: ");
+                context_str += history.text(msg);
+                context_str += "\n";
             }
             context_str += "\nУчитывай этот контекст в ответе.";
         }
@@ -494,12 +620,161 @@ std::string AiAgent::buildPromptForCommand(const std::string& command, CLIMode m
     return final_command + mode_str + context_str;
 }
 
-std::string AiAgent::readInputFile(const std::string& filepath) const {
-    std::ifstream file(filepath);
-    if (!file.is_open()) return "";
-    std::ostringstream ss;
-    ss << file.rdbuf();
-    return ss.str();
+void AiAgent::addHistoryMessages(AiRequest& req) const {
+    if (!context_enabled_ || cfg_.model_type != "local_lib") return;
+    // Окно шире, чем в промпте удаленной модели: пока оно не сдвинулось,
+    // диалог растет только с конца. Старые реплики отбрасываются, чтобы
+    // история занимала не больше половины контекста
+    auto history = getContextHistory(20);
+    std::vector<AiRequest::Message> messages;
+    for (auto& msg : history) {
+        messages.push_back({msg.role == ChatRole::User ? "user" : "assistant", std::string(history.text(msg))});
+    }
+    const size_t budget = (size_t)std::max(256, cfg_.local_model_n_ctx / 2);
+    size_t tokens = 0, first = messages.size();
+    while (first > 0 && tokens + doc_summary::estimateTokens(messages[first - 1].content) <= budget) {
+        tokens += doc_summary::estimateTokens(messages[--first].content);
+    }
+    req.messages.assign(std::make_move_iterator(messages.begin() + first),
+                        std::make_move_iterator(messages.end()));
+}
+
+bool AiAgent::readInputFile(const std::string& filepath, FileView& file, std::string* err) const {
+    if (!file.open(filepath, err)) return false;
+    if (file.empty()) {
+        if (err) *err = "File is empty: " + filepath;
+        return false;
+    }
+    return true;
+}
+
+size_t AiAgent::summaryChunkTokens() const {
+    if (cfg_.summary_chunk_tokens > 0) return (size_t)cfg_.summary_chunk_tokens;
+    // Контекст модели минус ответ и инструкция
+    const int budget = cfg_.local_model_n_ctx - AiRequest().max_tokens - 512;
+    return (size_t)std::max(256, budget);
+}
+
+// Ctrl+C во время сводки потока: дочитать окно и выдать итог; второй
+// Ctrl+C (обработчик уже сброшен) завершает процесс как обычно
+static std::atomic<bool> g_stream_stop{false};
+
+static void onStreamInterrupt(int) {
+    g_stream_stop = true;
+}
+
+std::optional<std::string> AiAgent::summarizeStream(std::string* outErr) {
+    stream_summary::Options opts;
+    opts.interval_sec = cfg_.stream_interval_sec;
+    // Окно и изложение вместе должны поместиться в бюджет части
+    opts.window_bytes = cfg_.stream_window_kb > 0
+        ? (size_t)cfg_.stream_window_kb * 1024
+        : (summaryChunkTokens() - std::min<size_t>(summaryChunkTokens() / 2, AiRequest().max_tokens)) *
+              doc_summary::kBytesPerToken;
+
+    std::cerr << "Reading stdin: окно " << opts.window_bytes / 1024 << " KB, сводка "
+              << (opts.interval_sec ? "каждые " + std::to_string(opts.interval_sec) + " с или " : "")
+              << "по заполнению окна; Ctrl+C — итоговая сводка" << std::endl;
+
+    g_stream_stop = false;
+    struct sigaction sa = {}, old_sa = {};
+    sa.sa_handler = onStreamInterrupt;
+    sa.sa_flags = SA_RESETHAND;   // без SA_RESTART: poll() прерывается сразу
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old_sa);
+
+    stream_summary::Stats stats;
+    auto result = stream_summary::summarize(STDIN_FILENO, opts,
+        [this](const AiRequest& req, std::string* err) { return execute(req, err); },
+        [](const std::string& summary, const stream_summary::Stats& st) {
+            std::cout << "\n--- Сводка #" << st.windows << " (прочитано " << st.bytes_read
+                      << " байт) ---\n" << summary << std::endl;
+        },
+        &g_stream_stop, &stats, outErr);
+    sigaction(SIGINT, &old_sa, nullptr);
+
+    if (!result) return std::nullopt;
+    if (context_enabled_) {
+        saveToContext(ChatRole::User, "Суммаризируй поток stdin (" + std::to_string(stats.bytes_read) + " байт)");
+        saveToContext(ChatRole::Assistant, *result);
+    }
+    return "\n=== Итоговая сводка (прочитано " + std::to_string(stats.bytes_read) + " байт, окон " +
+           std::to_string(stats.windows) + (stats.failed ? ", пропущено " + std::to_string(stats.failed) : "") +
+           ") ===\n" + *result;
+}
+
+std::optional<std::string> AiAgent::summarizeFile(const std::string& filepath, std::string* outErr) {
+    if (filepath == "-") return summarizeStream(outErr);
+    FileView file;
+    if (!readInputFile(filepath, file, outErr)) return std::nullopt;
+    std::cout << "Reading file: " << filepath << " (" << file.size() << " bytes"
+              << (file.mapped() ? ", mmap" : "") << ")\n";
+
+    // Инструкция и контекст — перед текстом, сам текст уходит в тело
+    // запроса прямо из файла
+    const std::string instruction = buildPromptForCommand("Суммаризируй текст", cli_mode_);
+    const size_t budget = summaryChunkTokens();
+    if (doc_summary::estimateTokens(file.view()) <= budget) {
+        AiRequest req(instruction + "\n\nТекст:\n");
+        req.attachment = file.view();
+        addHistoryMessages(req);
+        auto result = execute(req, outErr);
+
+        if (context_enabled_ && result) {
+            std::string command = "Суммаризируй текст:\n";
+            command += file.view();
+            saveToContext(ChatRole::User, command);
+            saveToContext(ChatRole::Assistant, *result);
+        }
+        return result;
+    }
+
+    // Изложения частей кэшируются в той же базе, что и контекст; без
+    // включенного контекста база открывается только на время суммаризации
+    ContextStore* cache = store_.get();
+#ifndef NO_SQLITE
+    std::unique_ptr<ContextStore> own_cache;
+    if (!cache) {
+        own_cache = std::make_unique<ContextStore>(db_path_);
+        std::string err;
+        if (own_cache->open(&err)) {
+            cache = own_cache.get();
+        } else {
+            std::cerr << "Summary cache disabled: " << err << std::endl;
+        }
+    }
+#endif
+
+    // Map-reduce идет минутами, а отображение держится только на один запрос
+    // (укороченный файл — SIGBUS): текст копируется, отображение снимается
+    const std::string text(file.view());
+    file = FileView();
+
+    doc_summary::Options opts;
+    opts.chunk_tokens = budget;
+    opts.jobs = cfg_.summary_jobs;
+    opts.cache_salt = cfg_.model_type + "|" +
+        (cfg_.model_type == "remote" ? cfg_.host : cfg_.local_model_path);
+    opts.final_prompt = instruction +
+        "\n\nТекст слишком длинный, поэтому дан краткими изложениями его частей по порядку:\n";
+
+    const auto started = std::chrono::steady_clock::now();
+    doc_summary::Stats stats;
+    auto result = doc_summary::summarize(text, opts,
+        [this](const AiRequest& req, std::string* err) { return execute(req, err); },
+        cache, &stats, outErr);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Map-reduce: частей " << stats.chunks << " (до ~" << budget << " токенов), из кэша "
+              << stats.cached << ", запросов " << stats.requests << ", уровней объединения "
+              << stats.levels << ", " << seconds << " с\n";
+
+    // В историю — не весь документ: он не поместился бы и в следующий промпт
+    if (context_enabled_ && result) {
+        saveToContext(ChatRole::User, "Суммаризируй файл " + filepath + " (" +
+                                      std::to_string(text.size()) + " байт)");
+        saveToContext(ChatRole::Assistant, *result);
+    }
+    return result;
 }
 
 std::optional<std::string> AiAgent::executeCLICommand(const std::string& \
@@ -511,36 +786,21 @@ command, std::string* outErr) {
         return std::nullopt;
     }
 
-    std::string final_command = command;
-    if (cli_mode_ == CLIMode::SUMMARY && command.substr(0, 6) == "--file") {
-        std::string filepath = command.substr(7);
-        std::string file_content = readInputFile(filepath);
-        if (!file_content.empty()) {
-            final_command = "Суммаризируй текст:\n" + file_content; 
-            std::cout << "Reading file: " << filepath << " (" << \
-            file_content.length() << " chars)\n";
-        }
-        else {
-            if (outErr) {
-                *outErr = "Cannot read file or file is empty: " + filepath;
-                return std::nullopt;
-            }
-        }
+    if (cli_mode_ == CLIMode::SUMMARY && command.compare(0, 7, "--file ") == 0) {
+        return summarizeFile(command.substr(7), outErr);
     }
  
-    std::string saved_prompt = prompt_;
-
-    prompt_ = buildPromptForCommand(final_command, cli_mode_);
-
-    auto result = ask(outErr);
+    // Промпт едет в запросе — prompt_ агента не трогаем
+    AiRequest req(buildPromptForCommand(command, cli_mode_));
+    addHistoryMessages(req);
+    req.on_token = on_token_;
+    auto result = execute(req, outErr);
 
     if (context_enabled_ && result) {
-        saveToContext("user", final_command);
-        saveToContext("assistant", *result);
+        saveToContext(ChatRole::User, command);
+        saveToContext(ChatRole::Assistant, *result);
     }
 
-    prompt_ = saved_prompt;
-
     return result;
 }
 
@@ -567,6 +827,12 @@ std::optional<std::string> AiAgent::processCLICommand(int argc, char* argv[], st
                 std::cout << "Модель: " << cfg_.local_model_path << std::endl;
             }
         }
+        else if (arg == "--local-lib") {
+            cfg_.model_type = "local_lib";
+            std::cout << "Режим изменен на: ЛОКАЛЬНАЯ МОДЕЛЬ (в процессе)" << std::endl;
+            std::cout << "Модель: " << (cfg_.local_model_path.empty() ? \
+                "не указана" : cfg_.local_model_path) << std::endl;
+        }
         else if (arg == "--remote") {
             cfg_.model_type = "remote";
             std::cout << "Режим изменен на: УДАЛЕННЫЙ API" << std::endl;
@@ -582,6 +848,12 @@ std::optional<std::string> AiAgent::processCLICommand(int argc, char* argv[], st
                 info += "  Модель: " + (cfg_.local_model_path.empty() ? \
                     "не указана" : cfg_.local_model_path);
             }
+            else if (cfg_.model_type == "local_lib") {
+                info += "ЛОКАЛЬНАЯ МОДЕЛЬ (в процессе, llama.cpp)\n";
+                info += "  Модель: " + (cfg_.local_model_path.empty() ? \
+                    "не указана" : cfg_.local_model_path) + "\n";
+                info += "  Контекст: " + std::to_string(cfg_.local_model_n_ctx) + " токенов";
+            }
             else {
                 info += "УДАЛЕННЫЙ API\n";
                 info += "  Сервер: " + cfg_.host + ":" + cfg_.port;
@@ -609,6 +881,12 @@ std::optional<std::string> AiAgent::processCLICommand(int argc, char* argv[], st
         } else if (arg == "--file" && i + 1 < argc) {
             file_for_summary = argv[i + 1];
             i++; //пропускаем следующий аргумент
+        } else if (arg == "-") {
+            file_for_summary = "-";   // суммаризация stdin
+        } else if (arg == "--interval" && i + 1 < argc) {
+            cfg_.stream_interval_sec = (unsigned)std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--window" && i + 1 < argc) {
+            cfg_.stream_window_kb = std::max(1, std::atoi(argv[++i]));
         } else if (arg == "--enable-context") {
             if (i + 1 < argc && argv[i + 1][0] != '-') {
                 enableContext(argv[i + 1]);
@@ -621,19 +899,30 @@ std::optional<std::string> AiAgent::processCLICommand(int argc, char* argv[], st
         } else if (arg == "--clear-context") {
             clearContext();
             return "Context cleared";
+        } else if (arg == "--context-stats") {
+            return getContextStats();
+        } else if ((arg == "--export-session" || arg == "--import-session") && i + 1 < argc) {
+            const std::string path = argv[++i];
+            const bool ok = (arg == "--export-session") ? exportSession(path, outErr)
+                                                         : importSession(path, outErr);
+            if (!ok) return std::nullopt;
+            return arg == "--export-session" ? "Session exported" : "Session imported";
         } else if (arg == "--show-context") {
             auto history = getContextHistory();
             if (history.empty()) {
                 return "No context history available";
             }
             std::string result = "Context history for session '" + current_session_ + "':\n";
-            for (const auto& msg : history) {
-                result += "[" + msg.timestamp + "] " + 
-                         (msg.role == "user" ? "Пользователь" : "Ассистент") + 
-                         ": " + msg.content + "\n";
+            for (auto& msg : history) {
+                result += "[" + formatTimestamp(msg.timestamp_us) + "] " +
+                         (msg.role == ChatRole::User ? "Пользователь" : "Ассистент") +
+                         ": ";
+                result += history.text(msg);
+                result += "\n";
             }
             return result;
-        } else if (arg != "--cli" && arg != "--help" && arg != "-h") {
+        } else if (arg != "--cli" && arg != "--help" && arg != "-h" &&
+                   arg != "--local" && arg != "--local-lib" && arg != "--remote") {
             if (!command.empty()) command += " ";
             command += arg;
         }
@@ -641,13 +930,7 @@ std::optional<std::string> AiAgent::processCLICommand(int argc, char* argv[], st
     
     //Если есть файл для суммаризации, обрабатываем его
     if (!file_for_summary.empty() && cli_mode_ == CLIMode::SUMMARY) {
-        std::string file_content = readInputFile(file_for_summary);
-        if (!file_content.empty()) {
-            command = "Суммаризируй следующий текст:\n" + file_content;
-        } else {
-            if (outErr) *outErr = "Cannot read file or file is empty: " + file_for_summary;
-            return std::nullopt;
-        }
+        return summarizeFile(file_for_summary, outErr);
     }
     
     if (!command.empty()) {
@@ -661,13 +944,16 @@ std::optional<std::string> AiAgent::processCLICommand(int argc, char* argv[], st
 void AiAgent::runInteractiveMode() {
     std::cout << "AI Agent CLI - Интерактивный режим\n";
     std::cout << "Команды: 'quit' - выход, 'help' - справка, 'mode <режим>' - смена режима\n";
-    std::cout << "Модель: 'local' - локальная, 'remote' - удаленная, 'model-info' - информация\n";
+    std::cout << "Модель: 'local' - локальная, 'local-lib' - локальная в процессе, 'remote' - удаленная, 'model-info' - информация\n";
     
     std::cout << "Текущая модель: ";
     if (cfg_.model_type == "local_http") {
         std::cout << "ЛОКАЛЬНАЯ (" << cfg_.local_http_host << ":" << \
             cfg_.local_http_port << ")";
     }
+    else if (cfg_.model_type == "local_lib") {
+        std::cout << "ЛОКАЛЬНАЯ В ПРОЦЕССЕ (" << cfg_.local_model_path << ")";
+    }
     else {
         std::cout << "УДАЛЕННАЯ (" << cfg_.host << ":" << cfg_.port << ")";
     }
@@ -691,6 +977,9 @@ void AiAgent::runInteractiveMode() {
         if (cfg_.model_type == "local_http") {
             std::cout << "[LOCAL]";
         }
+        else if (cfg_.model_type == "local_lib") {
+            std::cout << "[LOCAL-LIB]";
+        }
         else {
             std::cout << "[REMOTE]";
         }
@@ -712,6 +1001,13 @@ void AiAgent::runInteractiveMode() {
                 cfg_.local_http_port << std::endl;
             continue;
         }
+        if (input == "local-lib") {
+            cfg_.model_type = "local_lib";
+            std::cout << "Переключено на ЛОКАЛЬНУЮ МОДЕЛЬ В ПРОЦЕССЕ" << std::endl;
+            std::cout << "Модель: " << (cfg_.local_model_path.empty() ? \
+                "не указана" : cfg_.local_model_path) << std::endl;
+            continue;
+        }
         if (input == "remote") {
             cfg_.model_type = "remote";
             std::cout << "Переключено на УДАЛЕННЫЙ API" << std::endl;
@@ -728,6 +1024,12 @@ void AiAgent::runInteractiveMode() {
                 std::cout << "Модель: " << (cfg_.local_model_path.empty() ? \
                     "не указана" : cfg_.local_model_path) << std::endl;
             }
+            else if (cfg_.model_type == "local_lib") {
+                std::cout << "ЛОКАЛЬНАЯ (в процессе, llama.cpp)" << std::endl;
+                std::cout << "Модель: " << (cfg_.local_model_path.empty() ? \
+                    "не указана" : cfg_.local_model_path) << std::endl;
+                std::cout << "Контекст: " << cfg_.local_model_n_ctx << " токенов" << std::endl;
+            }
             else {
                 std::cout << "УДАЛЕННЫЙ API" << std::endl;
                 std::cout << "Сервер: " << cfg_.host << ":" << cfg_.port << \
@@ -750,14 +1052,25 @@ void AiAgent::runInteractiveMode() {
                 std::cout << "История контекста пуста\n";
             } else {
                 std::cout << "История контекста (" << history.size() << " сообщений):\n";
-                for (const auto& msg : history) {
-                    std::cout << "[" << msg.timestamp << "] " 
-                             << (msg.role == "user" ? "Пользователь" : "Ассистент") 
-                             << ": " << msg.content << "\n";
+                for (auto& msg : history) {
+                    std::cout << "[" << formatTimestamp(msg.timestamp_us) << "] "
+                             << (msg.role == ChatRole::User ? "Пользователь" : "Ассистент") 
+                             << ": " << history.text(msg) << "\n";
                 }
             }
             continue;
         }
+        if (input == "context-stats") {
+            std::cout << getContextStats() << "\n";
+            continue;
+        }
+        if (input.rfind("export-session ", 0) == 0 || input.rfind("import-session ", 0) == 0) {
+            const std::string path = input.substr(input.find(' ') + 1);
+            std::string err;
+            const bool ok = input[0] == 'e' ? exportSession(path, &err) : importSession(path, &err);
+            if (!ok) std::cout << "✗ " << err << "\n";
+            continue;
+        }
         if (input == "enable-context") {
             if (enableContext()) {
                 std::cout << "✓ Контекст включен\n";
@@ -777,9 +1090,17 @@ void AiAgent::runInteractiveMode() {
             continue;
         }
         
+        // Ответ local_lib печатается по мере генерации
+        bool streamed = false;
+        on_token_ = [&streamed](std::string_view piece) {
+            std::cout << piece << std::flush;
+            streamed = true;
+            return true;
+        };
         auto result = executeCLICommand(input, nullptr);
+        on_token_ = nullptr;
         if (result) {
-            std::cout << *result << "\n";
+            std::cout << (streamed ? std::string() : *result) << "\n";
         } else {
             std::cout << "✗ Ошибка выполнения команды\n";
         }
@@ -802,12 +1123,19 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb, \
     return total_size;
 }
 
-std::optional<std::string> AiAgent::localHttpPostGenerate(const AiConfig& cfg, const std::string& jsonBody, std::string* err) {
+// Прогресс curl: ненулевой ответ прерывает передачу (CURLE_ABORTED_BY_CALLBACK)
+static int CancelCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    auto* cancel = static_cast<const std::atomic<bool>*>(clientp);
+    return cancel->load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+std::optional<std::string> AiAgent::localHttpPostGenerate(const AiConfig& cfg, const std::string& jsonBody, std::string* err,
+        const std::atomic<bool>* cancel) {
     CURL* curl;
     CURLcode res;
     std::string response;
     
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    initNetworkOnce();
     curl = curl_easy_init();
     
     if(!curl) {
@@ -829,40 +1157,33 @@ std::optional<std::string> AiAgent::localHttpPostGenerate(const AiConfig& cfg, c
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);  // таймауты без SIGALRM — безопасно в потоках
+    if (cancel) {
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, cancel);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    }
     
     res = curl_easy_perform(curl);
     
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
-    curl_global_cleanup();
     
+    if (res == CURLE_ABORTED_BY_CALLBACK) {
+        if (err) *err = "Request cancelled";
+        return std::nullopt;
+    }
     if(res != CURLE_OK) {
         if (err) *err = std::string("curl_easy_perform() failed: ") + curl_easy_strerror(res);
         return std::nullopt;
     }
     
-    try {
-        auto j = json::parse(response);
-        
-        //Проверяем наличие ошибки
-        if (j.contains("error")) {
-            if (err) *err = "Server error: " + j["error"].dump();
-            return std::nullopt;
-        }
-        
-        //Проверяем структуру успешного ответа
-        if (j.contains("choices") && j["choices"].is_array() && !j["choices"].empty()) {
-            auto choice = j["choices"][0];
-            if (choice.contains("message") && choice["message"].contains("content")) {
-                return choice["message"]["content"].get<std::string>();
-            }
-        }
-        
-        if (err) *err = "Unexpected response format: " + response;
-        return std::nullopt;
-        
-    } catch (const std::exception& e) {
-        if (err) *err = std::string("JSON parse error: ") + e.what() + "\nResponse: " + response;
+    //choices[0].message.content или error — одним проходом, без дерева JSON
+    std::string content;
+    std::string parse_err;
+    if (!extractAnswer(response, content, &parse_err)) {
+        if (err) *err = parse_err + "\nResponse: " + response;
         return std::nullopt;
     }
+    return content;
 }
\ No newline at end of file
@@ -2,8 +2,13 @@
 #include <string>
 #include <optional>
 #include <nlohmann/json.hpp>
-#include <sqlite3.h>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include "ContextStore.h"
+#include "AiRequest.h"
+#include "FileView.h"
+#include "LlamaBackend.h"
 
 struct AiConfig {
     std::string model_type = "remote"; // "remote", "local_http", "local_lib"
@@ -15,13 +20,16 @@ struct AiConfig {
     std::string local_http_port = "8080";
     std::string local_model_path;
     int local_model_n_ctx = 4096;
-};
-
-//Структура для хранения истории сообщений
-struct ChatMessage {
-    std::string role;    //"user" или "assistant"
-    std::string content;
-    std::string timestamp;
+    // local_lib: llama.cpp в процессе (LlamaBackend.h)
+    int local_model_threads = 0;      // 0 — по числу ядер
+    int local_model_gpu_layers = 0;
+
+    // Суммаризация больших файлов по частям (DocumentSummarizer.h)
+    int summary_chunk_tokens = 0;   // текста в одном запросе; 0 — по local_model_n_ctx
+    unsigned summary_jobs = 4;      // одновременных запросов
+    // Сводка потока ("-" вместо файла, StreamSummarizer.h)
+    unsigned stream_interval_sec = 60;   // промежуточная сводка не реже; 0 — только по размеру
+    int stream_window_kb = 0;            // новых данных в запросе; 0 — по бюджету части
 };
 
 class AiAgent {
@@ -46,8 +54,13 @@ public:
     // Загрузить промпт из JSON-файла (принимает либо строку, либо объект с ключом "prompt")
     bool loadPrompt(const std::string& path, std::string* err = nullptr);
 
-    // Выполнить запрос и вернуть распарсенный "text" из ответа
-    // Возвращает std::nullopt при ошибке (описание в outErr, если передан)
+    // Выполнить запрос и вернуть текст ответа.
+    // Возвращает std::nullopt при ошибке (описание в outErr, если передан).
+    // Агент не меняется, так что execute() можно вызывать одновременно из
+    // нескольких потоков.
+    std::optional<std::string> execute(const AiRequest& req, std::string* outErr = nullptr) const;
+
+    // execute() с промптом из loadPrompt()/setPrompt()
     std::optional<std::string> ask(std::string* outErr = nullptr) const;
 
     // Явно задать промпт программно (не из файла)
@@ -70,15 +83,20 @@ public:
     //Методы для работы с контекстом/историей
     bool enableContext(const std::string& session_id = "default");
     bool disableContext();
-    bool saveToContext(const std::string& role, const std::string& content);
-    std::vector<ChatMessage> getContextHistory(int limit = 10) const;
+    bool saveToContext(ChatRole role, const std::string& content);
+    ChatHistory getContextHistory(int limit = 10) const;
     bool clearContext();
+    std::string getContextStats() const;
+    // Перенос текущей сессии между машинами (см. SessionArchive.h)
+    bool exportSession(const std::string& path, std::string* err = nullptr);
+    bool importSession(const std::string& path, std::string* err = nullptr);
     std::string getCurrentSession() const { return current_session_; }
 
 private:
     // ---- низкоуровневые помощники ----
     static std::optional<std::string> httpsPostGenerate(
-        const AiConfig& cfg, const std::string& jsonBody, std::string* err);
+        const AiConfig& cfg, const std::string& jsonBody, std::string* err,
+        const std::atomic<bool>* cancel = nullptr);
 
     // Простой разбор JSON: ожидаем { "text": "<строка>" }
     static std::string extractTextFromJsonBody(const std::string& body);
@@ -88,17 +106,29 @@ private:
     //CLI
     std::string buildPromptForCommand(const std::string& command, \
         CLIMode mode) const;
-    std::string readInputFile(const std::string& filepath) const;
+    // Файл для --file: отображается в память (FileView.h); пустой — ошибка
+    bool readInputFile(const std::string& filepath, FileView& file, std::string* err) const;
+    // Суммаризация файла: текст из FileView уходит в запрос без копий.
+    // Не помещается в контекст модели — изложение по частям (map-reduce)
+    std::optional<std::string> summarizeFile(const std::string& filepath, std::string* outErr);
+    // "-": stdin читается окнами, промежуточные сводки печатаются по ходу
+    std::optional<std::string> summarizeStream(std::string* outErr);
+    size_t summaryChunkTokens() const;
     std::optional<std::string> executeCLICommand(const std::string& command, \
         std::string* outErr);
 
     //Методы для работы с SQLite
     bool initDatabase();
-    bool createTables();
     void closeDatabase();
 
     //Local model
-    static std::optional<std::string> localHttpPostGenerate(const AiConfig& cfg, const std::string& jsonBody, std::string* err);
+    static std::optional<std::string> localHttpPostGenerate(const AiConfig& cfg, const std::string& jsonBody, std::string* err,
+        const std::atomic<bool>* cancel = nullptr);
+    // Модель local_lib: создаётся при первом запросе и живёт вместе с агентом
+    LlamaBackend& llamaBackend() const;
+    // История сессии репликами запроса (local_lib): префикс диалога от хода
+    // к ходу не меняется, и его KV-кэш используется повторно
+    void addHistoryMessages(AiRequest& req) const;
 
 private:
     AiConfig cfg_;
@@ -107,9 +137,15 @@ private:
     //CLI
     CLIMode cli_mode_ = CLIMode::DEFAULT;
     std::string original_prompt_;
+    // Куски ответа local_lib по мере генерации (интерактивный режим)
+    std::function<bool(std::string_view)> on_token_;
+
+    //Модель в процессе (local_lib)
+    mutable std::mutex llama_mutex_;
+    mutable std::unique_ptr<LlamaBackend> llama_;
 
     //Контекст и база данных
-    sqlite3* db_ = nullptr;
+    std::unique_ptr<ContextStore> store_;
     bool context_enabled_ = false;
     std::string current_session_;
     std::string db_path_ = "chat_context.db";
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <functional>
+
+// Один запрос к модели: промпт, история, параметры генерации и отмена.
+// Всё, что нужно для ответа, едет в самом запросе, поэтому
+// AiAgent::execute() не трогает состояние агента — один агент можно
+// звать из нескольких потоков без внешних блокировок.
+struct AiRequest {
+    struct Message {
+        std::string role;      // "system" / "user" / "assistant"
+        std::string content;
+    };
+
+    std::string prompt;             // новое сообщение пользователя
+    // Большой текст (файл на суммаризацию), который идёт сразу после
+    // prompt. Не копируется, а экранируется прямо в тело запроса — данные
+    // (обычно FileView) должны жить до конца execute()
+    std::string_view attachment;
+    std::vector<Message> messages;  // реплики до него (для local_http уходят как есть)
+    std::string system = "Ты — полезный AI-ассистент. Отвечай кратко и информативно.";
+
+    // Параметры генерации (удаленный /api/generate их не принимает)
+    int max_tokens = 500;
+    double temperature = 0.7;
+    double top_p = 0.9;
+
+    // Отмена из любого потока: запрос прерывается при ближайшей проверке,
+    // в том числе пока ждём ответ сервера. Флагом владеет вызывающий.
+    const std::atomic<bool>* cancel = nullptr;
+
+    // Куски ответа по мере генерации (только local_lib, остальные отдают
+    // ответ целиком). false — остановить генерацию, ответ будет неполным
+    std::function<bool(std::string_view piece)> on_token;
+
+    AiRequest() = default;
+    AiRequest(std::string p) : prompt(std::move(p)) {}
+
+    bool cancelled() const { return cancel && cancel->load(std::memory_order_relaxed); }
+
+    bool hasPrompt() const { return !prompt.empty() || !attachment.empty(); }
+
+    // Промпт одной строкой для API без ролей: история перед сообщением
+    std::string flatPrompt() const {
+        std::string out;
+        for (const auto& m : messages) {
+            out += m.role;
+            out += ": ";
+            out += m.content;
+            out += '\n';
+        }
+        out += prompt;
+        out += attachment;
+        return out;
+    }
+};
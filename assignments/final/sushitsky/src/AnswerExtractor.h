@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Достать текст ответа модели из JSON-тела за один проход SAX-разбором,
+// без построения дерева. Понимает оба формата:
+//   { "text": "..." }                                  — Hurated API;
+//   { "choices": [ { "message": { "content": "..." } } ] } — OpenAI / llama-server
+//   (а также choices[0].text).
+// Разбор останавливается, как только найден ответ; в out декодируется
+// только нужная строка.
+// Если в теле есть "error" (строка или объект с "message") — false и
+// "Server error: ..." в err.
+bool extractAnswer(std::string_view body, std::string& out, std::string* err = nullptr);
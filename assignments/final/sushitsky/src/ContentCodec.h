@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+// Как текст лежит в базе (колонка codec)
+enum class Codec : int {
+    Plain = 0,      // как есть
+    Zstd = 1,       // zstd без словаря
+    ZstdDict = 2    // zstd со словарём из codec_dicts (id словаря записан в кадре)
+};
+
+// Сжатие хранимых ответов zstd со словарём, обученным на строках таблицы.
+// Ответы ассистента длинные и похожи друг на друга, поэтому словарь
+// даёт основную часть выигрыша даже на коротких записях.
+// Методы можно вызывать из разных потоков.
+class ContentCodec {
+public:
+    struct Stats {
+        uint64_t raw_bytes = 0;       // сколько текста пришло на сжатие
+        uint64_t stored_bytes = 0;    // сколько из этого легло в базу
+        uint64_t compress_ns = 0;     // CPU-время сжатия
+        uint64_t decompress_ns = 0;   // CPU-время распаковки
+        uint64_t encoded = 0;
+        uint64_t decoded = 0;
+        double ratio() const { return stored_bytes ? (double)raw_bytes / stored_bytes : 1.0; }
+    };
+
+    // Текст короче min_size хранится как есть
+    explicit ContentCodec(int level = 6, size_t min_size = 128);
+    ~ContentCodec();
+
+    ContentCodec(const ContentCodec&) = delete;
+    ContentCodec& operator=(const ContentCodec&) = delete;
+
+    // false, если собрано без zstd (NO_ZSTD)
+    static bool available();
+
+    // Обучить словарь на образцах; nullopt, если образцов недостаточно
+    static std::optional<std::string> trainDictionary(const std::vector<std::string>& samples,
+                                                      size_t dict_size,
+                                                      std::string* err = nullptr);
+
+    // id словаря из его заголовка (0 — не словарь zstd или собрано без zstd)
+    static uint32_t dictionaryId(const std::string& dict);
+
+    // Зарегистрировать словарь. Для чтения нужны все словари,
+    // запись идёт с последним добавленным. Возвращает id словаря (0 — ошибка)
+    uint32_t addDictionary(const std::string& dict, std::string* err = nullptr);
+    bool hasDictionary() const;
+
+    // Сжать text в out. Если выигрыша нет — Codec::Plain и out = text
+    Codec encode(std::string_view text, std::string& out);
+
+    bool decode(Codec codec, std::string_view data, std::string& out,
+                std::string* err = nullptr) const;
+
+    Stats stats() const;
+
+private:
+    // Кадр больше kDirectDecodeLimit: распаковка потоком, строка растет по
+    // мере вывода, а не по размеру из заголовка. Вызывается под dec_mutex_
+    bool decodeStream(const ZSTD_DDict_s* ddict, std::string_view data, std::string& out,
+                      std::string* err) const;
+
+    int level_;
+    size_t min_size_;
+
+    mutable std::mutex enc_mutex_;
+    ZSTD_CCtx_s* cctx_ = nullptr;
+    ZSTD_CDict_s* cdict_ = nullptr;   // словарь для записи (последний)
+
+    mutable std::mutex dec_mutex_;
+    ZSTD_DCtx_s* dctx_ = nullptr;
+    std::map<uint32_t, ZSTD_DDict_s*> ddicts_;
+
+    mutable std::mutex stats_mutex_;
+    mutable Stats stats_;
+};
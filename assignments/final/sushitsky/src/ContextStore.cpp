@@ -0,0 +1,786 @@
+#include "ContextStore.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+namespace {
+// Сколько вставок максимум объединять в одну транзакцию
+constexpr size_t kMaxBatch = 256;
+// Окно группировки: даём соседним вставкам (user + assistant) попасть в одну транзакцию
+constexpr auto kGroupCommitWindow = std::chrono::milliseconds(5);
+// Словарь сжатия: размер и сколько последних ответов брать для обучения
+constexpr size_t kDictSize = 16 * 1024;
+constexpr int kDictSamples = 1000;
+const char* kHistoryTable = "chat_history";
+
+int64_t nowMicros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+}
+
+// ---------- TextArena ----------
+
+std::string_view TextArena::store(const char* data, size_t size) {
+    if (size == 0) return {};
+    if (blocks_.empty() || capacity_ - used_ < size) {
+        // Длинные тексты получают собственный блок нужного размера
+        capacity_ = std::max(kBlockSize, size);
+        blocks_.push_back(std::make_unique<char[]>(capacity_));
+        used_ = 0;
+    }
+    char* dst = blocks_.back().get() + used_;
+    std::memcpy(dst, data, size);
+    used_ += size;
+    return std::string_view(dst, size);
+}
+
+// ---------- ChatHistory ----------
+
+std::string_view ChatHistory::text(ChatMessage& msg) {
+    if (msg.codec == Codec::Plain) return msg.content;
+
+    std::string decoded, err;
+    if (!codec || !codec->decode(msg.codec, msg.content, decoded, &err)) {
+        decoded = "[failed to decompress message: " + (codec ? err : std::string("no codec")) + "]";
+    }
+    msg.content = arena.store(decoded.data(), decoded.size());
+    msg.codec = Codec::Plain;
+    return msg.content;
+}
+
+std::string formatTimestamp(int64_t timestamp_us) {
+    std::time_t secs = static_cast<std::time_t>(timestamp_us / 1000000);
+    std::tm tm{};
+    gmtime_r(&secs, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+// ---------- ContextStore ----------
+
+ContextStore::ContextStore(std::string db_path) : db_path_(std::move(db_path)) {}
+
+ContextStore::~ContextStore() {
+    close();
+}
+
+bool ContextStore::exec(const char* sql, std::string* err) {
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db_, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        if (err) *err = std::string("SQL error: ") + (errMsg ? errMsg : "unknown");
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+int64_t ContextStore::queryInt(const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    int64_t value = 0;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+int ContextStore::schemaVersion() {
+    return static_cast<int>(queryInt("PRAGMA user_version;"));
+}
+
+bool ContextStore::tableExists(const char* name) {
+    sqlite3_stmt* stmt = nullptr;
+    bool exists = false;
+    if (sqlite3_prepare_v2(db_, "SELECT 1 FROM sqlite_master WHERE type='table' AND name=?",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        exists = (sqlite3_step(stmt) == SQLITE_ROW);
+    }
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+bool ContextStore::open(std::string* err) {
+    if (db_) return true;
+
+    if (sqlite3_open(db_path_.c_str(), &db_) != SQLITE_OK) {
+        if (err) *err = std::string("Cannot open database: ") + sqlite3_errmsg(db_);
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+
+    // WAL: читатели не блокируют писателя, а fsync нужен только на checkpoint.
+    // synchronous=NORMAL в WAL не портит базу при сбое, но может потерять
+    // последнюю транзакцию при отключении питания — для истории чата это приемлемо.
+    if (!exec("PRAGMA journal_mode=WAL;", err) ||
+        !exec("PRAGMA synchronous=NORMAL;", err) ||
+        !exec("PRAGMA busy_timeout=5000;", err) ||
+        !createSchema(err) ||
+        !loadDictionaries(err) ||
+        !prepareStatements(err)) {
+        finalizeStatements();
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = false;
+        write_failed_ = false;
+        enqueued_ = committed_ = 0;
+    }
+    assistant_rows_ = queryInt("SELECT COUNT(*) FROM chat_history WHERE role = 1;");
+    writer_ = std::thread(&ContextStore::writerLoop, this);
+    return true;
+}
+
+bool ContextStore::createSchema(std::string* err) {
+    int version = schemaVersion();
+
+    // Базы до появления версий: user_version = 0, но таблица уже есть
+    if (version == 0 && tableExists("chat_history")) version = 1;
+
+    if (version == 1) {
+        if (!migrateV1toV2(err)) return false;
+        version = 2;
+    }
+
+    if (version == 2) {
+        if (!migrateV2toV3(err)) return false;
+        version = 3;
+    }
+
+    if (version > kSchemaVersion) {
+        if (err) *err = "Database schema version " + std::to_string(version) +
+                        " is newer than supported (" + std::to_string(kSchemaVersion) + ")";
+        return false;
+    }
+
+    const char* sql = "CREATE TABLE IF NOT EXISTS sessions ("
+        "id INTEGER PRIMARY KEY,"
+        "name TEXT NOT NULL UNIQUE"
+        ");"
+        "CREATE TABLE IF NOT EXISTS chat_history ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "session_id INTEGER NOT NULL REFERENCES sessions(id),"
+        "role INTEGER NOT NULL,"
+        "content TEXT NOT NULL,"  // BLOB, если codec != 0
+        "ts_us INTEGER NOT NULL,"
+        "codec INTEGER NOT NULL DEFAULT 0,"
+        "raw_len INTEGER"
+        ");"
+        "CREATE TABLE IF NOT EXISTS codec_dicts ("
+        "table_name TEXT NOT NULL,"
+        "dict_id INTEGER NOT NULL,"
+        "dict BLOB NOT NULL,"
+        "created_us INTEGER NOT NULL,"
+        "PRIMARY KEY (table_name, dict_id)"
+        ");"
+        // Версия 4 только добавляет эту таблицу, отдельная миграция не нужна
+        "CREATE TABLE IF NOT EXISTS summary_cache ("
+        "key INTEGER PRIMARY KEY,"   // хеш текста части (64 бита как знаковое)
+        "summary TEXT NOT NULL,"
+        "created_us INTEGER NOT NULL"
+        ");"
+        // (session_id, id): выборка истории сессии — диапазон по индексу без сортировки
+        "CREATE INDEX IF NOT EXISTS idx_session_id ON chat_history(session_id, id);"
+        "PRAGMA user_version = 4;";
+    return exec(sql, err);
+}
+
+bool ContextStore::migrateV1toV2(std::string* err) {
+    const int64_t rows = queryInt("SELECT COUNT(*) FROM chat_history;");
+    const int64_t bytes_before = queryInt("PRAGMA page_count;") * queryInt("PRAGMA page_size;");
+    const auto started = std::chrono::steady_clock::now();
+
+    // Индексы переезжают вместе с переименованной таблицей — удаляем их,
+    // чтобы освободить имена для новой схемы
+    const char* sql = "BEGIN IMMEDIATE;"
+        "ALTER TABLE chat_history RENAME TO chat_history_v1;"
+        "DROP INDEX IF EXISTS idx_session;"
+        "DROP INDEX IF EXISTS idx_session_id;"
+        "DROP INDEX IF EXISTS idx_timestamp;"
+        "CREATE TABLE sessions ("
+        "id INTEGER PRIMARY KEY,"
+        "name TEXT NOT NULL UNIQUE"
+        ");"
+        "CREATE TABLE chat_history ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "session_id INTEGER NOT NULL REFERENCES sessions(id),"
+        "role INTEGER NOT NULL,"
+        "content TEXT NOT NULL,"
+        "ts_us INTEGER NOT NULL"
+        ");"
+        "INSERT INTO sessions (name) SELECT DISTINCT session_id FROM chat_history_v1;"
+        "INSERT INTO chat_history (id, session_id, role, content, ts_us) "
+        "SELECT h.id, s.id, "
+        "CASE h.role WHEN 'user' THEN 0 WHEN 'assistant' THEN 1 ELSE 2 END, "
+        "h.content, "
+        "COALESCE(CAST(strftime('%s', h.timestamp) AS INTEGER), 0) * 1000000 "
+        "FROM chat_history_v1 h JOIN sessions s ON s.name = h.session_id "
+        "ORDER BY h.id;"
+        "DROP TABLE chat_history_v1;"
+        "CREATE INDEX idx_session_id ON chat_history(session_id, id);"
+        "PRAGMA user_version = 2;"
+        "COMMIT;";
+
+    if (!exec(sql, err)) {
+        exec("ROLLBACK;");
+        return false;
+    }
+
+    // Возвращаем освободившиеся страницы файлу, чтобы выигрыш был виден сразу
+    exec("VACUUM;");
+
+    const int64_t bytes_after = queryInt("PRAGMA page_count;") * queryInt("PRAGMA page_size;");
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    std::cout << "✓ Context database migrated to schema v2: " << rows << " messages, "
+              << bytes_before / 1024 << " KB -> " << bytes_after / 1024 << " KB ("
+              << ms << " ms)" << std::endl;
+    return true;
+}
+
+bool ContextStore::migrateV2toV3(std::string* err) {
+    // Старые строки остаются как есть (codec = 0), сжимается только новое
+    // и то, что попадёт в выборку для обучения словаря
+    const char* sql = "BEGIN IMMEDIATE;"
+        "ALTER TABLE chat_history ADD COLUMN codec INTEGER NOT NULL DEFAULT 0;"
+        "ALTER TABLE chat_history ADD COLUMN raw_len INTEGER;"
+        "UPDATE chat_history SET raw_len = length(CAST(content AS BLOB));"
+        "PRAGMA user_version = 3;"
+        "COMMIT;";
+
+    if (!exec(sql, err)) {
+        exec("ROLLBACK;");
+        return false;
+    }
+    return true;
+}
+
+bool ContextStore::loadDictionaries(std::string* err) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT dict FROM codec_dicts WHERE table_name = ? ORDER BY created_us",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        if (err) *err = std::string("Failed to load dictionaries: ") + sqlite3_errmsg(db_);
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, kHistoryTable, -1, SQLITE_STATIC);
+
+    // Последний загруженный словарь становится словарём для записи
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void* data = sqlite3_column_blob(stmt, 0);
+        std::string dict(static_cast<const char*>(data), sqlite3_column_bytes(stmt, 0));
+        std::string dict_err;
+        if (!codec_->addDictionary(dict, &dict_err)) {
+            std::cerr << "Skipping compression dictionary: " << dict_err << std::endl;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool ContextStore::prepareStatements(std::string* err) {
+    const char* insert_sql =
+        "INSERT INTO chat_history (session_id, role, content, ts_us, codec, raw_len) "
+        "VALUES (?, ?, ?, ?, ?, ?)";
+    const char* history_sql =
+        "SELECT role, content, ts_us, codec FROM chat_history "
+        "WHERE session_id = ? ORDER BY id DESC LIMIT ?";
+    const char* clear_sql = "DELETE FROM chat_history WHERE session_id = ?";
+    const char* find_session_sql = "SELECT id FROM sessions WHERE name = ?";
+    const char* add_session_sql = "INSERT INTO sessions (name) VALUES (?)";
+    const char* find_summary_sql = "SELECT summary FROM summary_cache WHERE key = ?";
+    const char* store_summary_sql =
+        "INSERT OR REPLACE INTO summary_cache (key, summary, created_us) VALUES (?, ?, ?)";
+
+    if (sqlite3_prepare_v2(db_, insert_sql, -1, &insert_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, history_sql, -1, &history_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, clear_sql, -1, &clear_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, find_session_sql, -1, &find_session_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, add_session_sql, -1, &add_session_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, find_summary_sql, -1, &find_summary_stmt_, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db_, store_summary_sql, -1, &store_summary_stmt_, nullptr) != SQLITE_OK) {
+        if (err) *err = std::string("Failed to prepare statement: ") + sqlite3_errmsg(db_);
+        return false;
+    }
+    return true;
+}
+
+void ContextStore::finalizeStatements() {
+    sqlite3_finalize(insert_stmt_);
+    sqlite3_finalize(history_stmt_);
+    sqlite3_finalize(clear_stmt_);
+    sqlite3_finalize(find_session_stmt_);
+    sqlite3_finalize(add_session_stmt_);
+    sqlite3_finalize(find_summary_stmt_);
+    sqlite3_finalize(store_summary_stmt_);
+    insert_stmt_ = history_stmt_ = clear_stmt_ = nullptr;
+    find_session_stmt_ = add_session_stmt_ = nullptr;
+    find_summary_stmt_ = store_summary_stmt_ = nullptr;
+}
+
+void ContextStore::close() {
+    if (!db_) return;
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    // Поток записи опустошает очередь перед выходом
+    if (writer_.joinable()) writer_.join();
+
+    finalizeStatements();
+    sqlite3_close(db_);
+    db_ = nullptr;
+    session_ids_.clear();
+}
+
+int64_t ContextStore::sessionId(const std::string& name, bool create) {
+    auto it = session_ids_.find(name);
+    if (it != session_ids_.end()) return it->second;
+
+    int64_t id = -1;
+    sqlite3_bind_text(find_session_stmt_, 1, name.c_str(), (int)name.size(), SQLITE_STATIC);
+    if (sqlite3_step(find_session_stmt_) == SQLITE_ROW) {
+        id = sqlite3_column_int64(find_session_stmt_, 0);
+    }
+    sqlite3_reset(find_session_stmt_);
+    sqlite3_clear_bindings(find_session_stmt_);
+
+    if (id < 0 && create) {
+        sqlite3_bind_text(add_session_stmt_, 1, name.c_str(), (int)name.size(), SQLITE_STATIC);
+        if (sqlite3_step(add_session_stmt_) == SQLITE_DONE) {
+            id = sqlite3_last_insert_rowid(db_);
+        } else {
+            std::cerr << "Failed to add session: " << sqlite3_errmsg(db_) << std::endl;
+        }
+        sqlite3_reset(add_session_stmt_);
+        sqlite3_clear_bindings(add_session_stmt_);
+    }
+
+    if (id >= 0) session_ids_.emplace(name, id);
+    return id;
+}
+
+bool ContextStore::append(const std::string& session, ChatRole role,
+                          const std::string& content, int64_t timestamp_us) {
+    if (!db_) return false;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (stopping_) return false;
+        queue_.push_back({session, content, timestamp_us ? timestamp_us : nowMicros(), role});
+        ++enqueued_;
+    }
+    queue_cv_.notify_one();
+    return true;
+}
+
+bool ContextStore::flush() {
+    if (!db_) return false;
+
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    const uint64_t target = enqueued_;
+    ++flush_waiters_;
+    queue_cv_.notify_one();  // не ждать окна группировки
+    committed_cv_.wait(lock, [&] { return committed_ >= target; });
+    --flush_waiters_;
+
+    const bool ok = !write_failed_;
+    write_failed_ = false;
+    return ok;
+}
+
+void ContextStore::writerLoop() {
+    std::vector<PendingWrite> batch;
+    batch.reserve(kMaxBatch);
+
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    while (true) {
+        queue_cv_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) break;  // stopping_ и писать нечего
+
+        // Немного подождать, чтобы собрать соседние вставки в одну транзакцию
+        queue_cv_.wait_for(lock, kGroupCommitWindow, [&] {
+            return stopping_ || flush_waiters_ > 0 || queue_.size() >= kMaxBatch;
+        });
+
+        const size_t n = std::min(queue_.size(), kMaxBatch);
+        for (size_t i = 0; i < n; ++i) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+
+        lock.unlock();
+        const bool ok = writeBatch(batch);
+        if (ok) {
+            std::lock_guard<std::mutex> db_lock(db_mutex_);
+            trainDictionaryIfNeeded();
+        }
+        lock.lock();
+
+        if (!ok) write_failed_ = true;
+        committed_ += batch.size();
+        batch.clear();
+        committed_cv_.notify_all();
+    }
+}
+
+void ContextStore::encode(PendingWrite& w) {
+    w.raw_len = w.content.size();
+    if (w.role == ChatRole::Assistant) {
+        std::string packed;
+        w.codec = codec_->encode(w.content, packed);
+        w.content = std::move(packed);
+    }
+}
+
+bool ContextStore::insertRow(const PendingWrite& w) {
+    const int64_t session_id = sessionId(w.session, true);
+    if (session_id < 0) return false;
+
+    sqlite3_bind_int64(insert_stmt_, 1, session_id);
+    sqlite3_bind_int(insert_stmt_, 2, static_cast<int>(w.role));
+    if (w.codec == Codec::Plain) {
+        sqlite3_bind_text(insert_stmt_, 3, w.content.c_str(), (int)w.content.size(), SQLITE_STATIC);
+    } else {
+        sqlite3_bind_blob(insert_stmt_, 3, w.content.data(), (int)w.content.size(), SQLITE_STATIC);
+    }
+    sqlite3_bind_int64(insert_stmt_, 4, w.timestamp_us);
+    sqlite3_bind_int(insert_stmt_, 5, static_cast<int>(w.codec));
+    sqlite3_bind_int64(insert_stmt_, 6, (sqlite3_int64)w.raw_len);
+
+    const bool ok = sqlite3_step(insert_stmt_) == SQLITE_DONE;
+    if (!ok) std::cerr << "Failed to save to context: " << sqlite3_errmsg(db_) << std::endl;
+    sqlite3_reset(insert_stmt_);
+    sqlite3_clear_bindings(insert_stmt_);
+    return ok;
+}
+
+bool ContextStore::writeBatch(std::vector<PendingWrite>& batch) {
+    // Сжимаем до захвата соединения, чтобы не задерживать читателей
+    for (auto& w : batch) encode(w);
+
+    std::lock_guard<std::mutex> lock(db_mutex_);
+
+    std::string err;
+    if (!exec("BEGIN IMMEDIATE;", &err)) {
+        std::cerr << "Failed to begin transaction: " << err << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    for (const auto& w : batch) {
+        if (!insertRow(w)) { ok = false; break; }
+    }
+
+    if (!exec(ok ? "COMMIT;" : "ROLLBACK;", &err)) {
+        std::cerr << "Failed to commit transaction: " << err << std::endl;
+        exec("ROLLBACK;");
+        ok = false;
+    }
+    // После отката id новых сессий в кэше недействительны
+    if (!ok) session_ids_.clear();
+    if (ok) {
+        for (const auto& w : batch) {
+            if (w.role == ChatRole::Assistant) ++assistant_rows_;
+        }
+    }
+    return ok;
+}
+
+bool ContextStore::importMessages(const std::string& session, const std::function<bool(const AddFn& add)>& fn,
+                                  std::string* err) {
+    if (!db_) return false;
+
+    // Сообщения из очереди — раньше импортированных
+    if (!flush()) {
+        if (err) *err = "Failed to write queued messages";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    if (!exec("BEGIN IMMEDIATE;", err)) return false;
+
+    int64_t assistant_rows = 0;
+    bool insert_ok = true;
+    PendingWrite w;
+    w.session = session;
+    const AddFn add = [&](ChatRole role, int64_t timestamp_us, const std::string& content) {
+        w.role = role;
+        w.timestamp_us = timestamp_us ? timestamp_us : nowMicros();
+        w.content = content;
+        w.codec = Codec::Plain;
+        encode(w);
+        if (!insertRow(w)) {
+            insert_ok = false;
+            return false;
+        }
+        if (role == ChatRole::Assistant) ++assistant_rows;
+        return true;
+    };
+
+    bool ok = fn(add);
+    if (!insert_ok) {
+        if (err) *err = std::string("Failed to write imported messages: ") + sqlite3_errmsg(db_);
+        ok = false;
+    }
+    std::string commit_err;
+    if (!exec(ok ? "COMMIT;" : "ROLLBACK;", &commit_err)) {
+        exec("ROLLBACK;");
+        if (ok && err) *err = "Failed to commit import: " + commit_err;
+        ok = false;
+    }
+    if (!ok) {
+        session_ids_.clear();
+        return false;
+    }
+    assistant_rows_ += assistant_rows;
+    trainDictionaryIfNeeded();
+    return true;
+}
+
+void ContextStore::trainDictionaryIfNeeded() {
+    if (!ContentCodec::available() || codec_->hasDictionary() || assistant_rows_ < train_threshold_) return;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT id, codec, content FROM chat_history "
+                                "WHERE role = 1 ORDER BY id DESC LIMIT ?",
+                           -1, &stmt, nullptr) != SQLITE_OK) return;
+    sqlite3_bind_int(stmt, 1, kDictSamples);
+
+    std::vector<int64_t> ids;
+    std::vector<std::string> samples;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 2));
+        std::string_view stored(data ? data : "", sqlite3_column_bytes(stmt, 2));
+        std::string text;
+        if (codec_->decode(static_cast<Codec>(sqlite3_column_int(stmt, 1)), stored, text)) {
+            ids.push_back(sqlite3_column_int64(stmt, 0));
+            samples.push_back(std::move(text));
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    std::string err;
+    auto dict = ContentCodec::trainDictionary(samples, kDictSize, &err);
+    const uint32_t dict_id = dict ? ContentCodec::dictionaryId(*dict) : 0;
+    if (!dict_id) {
+        // Образцов мало или они однообразны — попробуем, когда наберётся вдвое больше
+        train_threshold_ *= 2;
+        return;
+    }
+
+    // Сначала словарь на диск: строки, сжатые незаписанным словарём,
+    // после перезапуска будет нечем прочитать
+    bool ok = false;
+    if (sqlite3_prepare_v2(db_, "INSERT OR REPLACE INTO codec_dicts (table_name, dict_id, dict, created_us) "
+                                "VALUES (?, ?, ?, ?)", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, kHistoryTable, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, dict_id);
+        sqlite3_bind_blob(stmt, 3, dict->data(), (int)dict->size(), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, nowMicros());
+        ok = (sqlite3_step(stmt) == SQLITE_DONE);
+    }
+    sqlite3_finalize(stmt);
+    if (!ok || !codec_->addDictionary(*dict, &err)) {
+        std::cerr << "Failed to save compression dictionary: "
+                  << (ok ? err : std::string(sqlite3_errmsg(db_))) << std::endl;
+        train_threshold_ *= 2;
+        return;
+    }
+
+    // Пережимаем выборку словарём: это самые свежие и чаще всего читаемые строки
+    if (exec("BEGIN IMMEDIATE;") &&
+        sqlite3_prepare_v2(db_, "UPDATE chat_history SET codec = ?, content = ? WHERE id = ?",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        for (size_t i = 0; i < ids.size() && ok; ++i) {
+            std::string packed;
+            const Codec codec = codec_->encode(samples[i], packed);
+            sqlite3_bind_int(stmt, 1, static_cast<int>(codec));
+            if (codec == Codec::Plain) {
+                sqlite3_bind_text(stmt, 2, packed.data(), (int)packed.size(), SQLITE_STATIC);
+            } else {
+                sqlite3_bind_blob(stmt, 2, packed.data(), (int)packed.size(), SQLITE_STATIC);
+            }
+            sqlite3_bind_int64(stmt, 3, ids[i]);
+            ok = (sqlite3_step(stmt) == SQLITE_DONE);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        // Неудача здесь не страшна: строки просто останутся в прежнем виде
+        exec(ok ? "COMMIT;" : "ROLLBACK;");
+    }
+
+    std::cout << "✓ Trained compression dictionary for chat history ("
+              << dict->size() << " bytes, " << samples.size() << " samples)" << std::endl;
+}
+
+ChatHistory ContextStore::history(const std::string& session, int limit) {
+    ChatHistory result;
+    if (!db_) return result;
+    result.codec = codec_;
+
+    // Читаем свои же записи: сначала дожидаемся очереди
+    flush();
+
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    const int64_t session_id = sessionId(session, false);
+    if (session_id < 0) return result;
+
+    sqlite3_bind_int64(history_stmt_, 1, session_id);
+    sqlite3_bind_int(history_stmt_, 2, limit);
+
+    int step_result;
+    while ((step_result = sqlite3_step(history_stmt_)) == SQLITE_ROW) {
+        ChatMessage msg;
+        msg.role = static_cast<ChatRole>(sqlite3_column_int(history_stmt_, 0));
+        // Сжатое не распаковываем: это сделает ChatHistory::text() при чтении
+        msg.codec = static_cast<Codec>(sqlite3_column_int(history_stmt_, 3));
+        const char* content_ptr = static_cast<const char*>(sqlite3_column_blob(history_stmt_, 1));
+        if (content_ptr) {
+            msg.content = result.arena.store(content_ptr, sqlite3_column_bytes(history_stmt_, 1));
+        }
+        msg.timestamp_us = sqlite3_column_int64(history_stmt_, 2);
+        result.messages.push_back(msg);
+    }
+
+    if (step_result != SQLITE_DONE) {
+        std::cerr << "Error reading context: " << sqlite3_errmsg(db_) << std::endl;
+    }
+
+    sqlite3_reset(history_stmt_);
+    sqlite3_clear_bindings(history_stmt_);
+
+    // Переворачиваем чтобы получить в хронологическом порядке
+    std::reverse(result.messages.begin(), result.messages.end());
+    return result;
+}
+
+bool ContextStore::clear(const std::string& session) {
+    if (!db_) return false;
+
+    flush();
+
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    const int64_t session_id = sessionId(session, false);
+    if (session_id < 0) return true;  // очищать нечего
+
+    sqlite3_bind_int64(clear_stmt_, 1, session_id);
+    const bool success = (sqlite3_step(clear_stmt_) == SQLITE_DONE);
+    if (!success) {
+        std::cerr << "Failed to clear context: " << sqlite3_errmsg(db_) << std::endl;
+    }
+    sqlite3_reset(clear_stmt_);
+    sqlite3_clear_bindings(clear_stmt_);
+    return success;
+}
+
+bool ContextStore::findSummary(uint64_t key, std::string& out) {
+    if (!db_) return false;
+
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    sqlite3_bind_int64(find_summary_stmt_, 1, static_cast<int64_t>(key));
+    const bool found = (sqlite3_step(find_summary_stmt_) == SQLITE_ROW);
+    if (found) {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(find_summary_stmt_, 0));
+        out.assign(text ? text : "", sqlite3_column_bytes(find_summary_stmt_, 0));
+    }
+    sqlite3_reset(find_summary_stmt_);
+    sqlite3_clear_bindings(find_summary_stmt_);
+    return found;
+}
+
+bool ContextStore::storeSummary(uint64_t key, std::string_view summary) {
+    if (!db_) return false;
+
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    sqlite3_bind_int64(store_summary_stmt_, 1, static_cast<int64_t>(key));
+    sqlite3_bind_text(store_summary_stmt_, 2, summary.data(), (int)summary.size(), SQLITE_STATIC);
+    sqlite3_bind_int64(store_summary_stmt_, 3, nowMicros());
+    const bool success = (sqlite3_step(store_summary_stmt_) == SQLITE_DONE);
+    if (!success) {
+        std::cerr << "Failed to store summary: " << sqlite3_errmsg(db_) << std::endl;
+    }
+    sqlite3_reset(store_summary_stmt_);
+    sqlite3_clear_bindings(store_summary_stmt_);
+    return success;
+}
+
+bool ContextStore::scan(const std::string& session, const ScanFn& fn, std::string* err) {
+    if (!db_) return false;
+
+    flush();
+
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    const int64_t session_id = sessionId(session, false);
+    if (session_id < 0) return true;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT role, ts_us, codec, content FROM chat_history "
+                                "WHERE session_id = ? ORDER BY id",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        if (err) *err = std::string("Failed to prepare statement: ") + sqlite3_errmsg(db_);
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, session_id);
+
+    bool ok = true;
+    std::string text;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 3));
+        std::string_view stored(data ? data : "", sqlite3_column_bytes(stmt, 3));
+        std::string decode_err;
+        if (!codec_->decode(static_cast<Codec>(sqlite3_column_int(stmt, 2)), stored, text, &decode_err)) {
+            if (err) *err = decode_err;
+            ok = false;
+            break;
+        }
+        if (!fn(static_cast<ChatRole>(sqlite3_column_int(stmt, 0)), sqlite3_column_int64(stmt, 1), text)) {
+            break;
+        }
+    }
+    if (ok && rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        if (err) *err = std::string("Error reading context: ") + sqlite3_errmsg(db_);
+        ok = false;
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+ContextStore::Stats ContextStore::stats(const std::string& session) {
+    Stats s;
+    if (!db_) return s;
+
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(db_mutex_);
+        s.rows = queryInt("SELECT COUNT(*) FROM chat_history;");
+        s.sessions = queryInt("SELECT COUNT(*) FROM sessions;");
+        s.db_bytes = queryInt("PRAGMA page_count;") * queryInt("PRAGMA page_size;");
+        s.content_raw_bytes = queryInt("SELECT SUM(raw_len) FROM chat_history;");
+        s.content_stored_bytes = queryInt("SELECT SUM(length(CAST(content AS BLOB))) FROM chat_history;");
+    }
+    s.dictionary = codec_->hasDictionary();
+    if (s.rows > 0) s.bytes_per_row = static_cast<double>(s.db_bytes) / s.rows;
+
+    constexpr int kRuns = 100;
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRuns; ++i) {
+        history(session, 10);
+    }
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    s.history_query_us = static_cast<double>(us) / kRuns;
+    s.codec = codec_->stats();
+    return s;
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <sqlite3.h>
+#include "ContentCodec.h"
+
+// Роль хранится в базе маленьким целым
+enum class ChatRole : uint8_t {
+    User = 0,
+    Assistant = 1,
+    System = 2
+};
+
+//Структура для хранения истории сообщений.
+//Текст не копируется в каждое сообщение, а лежит в арене ChatHistory.
+//Пока codec != Plain, content — сжатые байты; читать через ChatHistory::text()
+struct ChatMessage {
+    std::string_view content;
+    int64_t timestamp_us = 0;   // микросекунды с начала эпохи (UTC)
+    ChatRole role = ChatRole::User;
+    Codec codec = Codec::Plain;
+};
+
+// Арена для текста сообщений: блоки выделяются крупно и не перемещаются,
+// поэтому string_view на них остаются валидными и после перемещения арены
+class TextArena {
+public:
+    TextArena() = default;
+    TextArena(TextArena&&) = default;
+    TextArena& operator=(TextArena&&) = default;
+    TextArena(const TextArena&) = delete;
+    TextArena& operator=(const TextArena&) = delete;
+
+    std::string_view store(const char* data, size_t size);
+
+private:
+    static constexpr size_t kBlockSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t used_ = 0;      // занято в последнем блоке
+    size_t capacity_ = 0;  // размер последнего блока
+};
+
+// Выборка истории: сообщения + арена, которой они принадлежат
+struct ChatHistory {
+    TextArena arena;
+    std::vector<ChatMessage> messages;
+    std::shared_ptr<const ContentCodec> codec;
+
+    bool empty() const { return messages.empty(); }
+    size_t size() const { return messages.size(); }
+    std::vector<ChatMessage>::iterator begin() { return messages.begin(); }
+    std::vector<ChatMessage>::iterator end() { return messages.end(); }
+    std::vector<ChatMessage>::const_iterator begin() const { return messages.begin(); }
+    std::vector<ChatMessage>::const_iterator end() const { return messages.end(); }
+
+    // Текст сообщения. Сжатое распаковывается в арену при первом обращении
+    std::string_view text(ChatMessage& msg);
+};
+
+// "YYYY-MM-DD HH:MM:SS" (UTC), как раньше выдавал CURRENT_TIMESTAMP
+std::string formatTimestamp(int64_t timestamp_us);
+
+// Хранилище контекста чата (chat_history).
+// Соединение открывается в режиме WAL, запросы подготавливаются один раз,
+// а вставки уходят в фоновый поток, который группирует их в транзакции.
+//
+// Схема версионируется через PRAGMA user_version:
+//   1 — исходная: session_id/role TEXT в каждой строке, timestamp DATETIME;
+//   2 — sessions(id, name), role INTEGER, ts_us INTEGER;
+//   3 — codec/raw_len в chat_history и словари сжатия в codec_dicts;
+//   4 — summary_cache: краткие изложения частей документа по хешу текста.
+// Старые базы мигрируют автоматически при open().
+//
+// Ответы ассистента сжимаются zstd в потоке записи; когда их накопится
+// достаточно, там же обучается словарь и им пережимаются последние строки.
+class ContextStore {
+public:
+    static constexpr int kSchemaVersion = 4;
+
+    struct Stats {
+        int64_t rows = 0;
+        int64_t sessions = 0;
+        int64_t db_bytes = 0;          // page_count * page_size
+        double bytes_per_row = 0;
+        double history_query_us = 0;   // среднее время history(session, 10)
+        int64_t content_raw_bytes = 0;     // исходный размер текста сообщений
+        int64_t content_stored_bytes = 0;  // сколько он занимает в базе
+        bool dictionary = false;           // обучен ли словарь
+        ContentCodec::Stats codec;         // сжатие/распаковка в этом процессе
+    };
+
+    explicit ContextStore(std::string db_path);
+    ~ContextStore();
+
+    ContextStore(const ContextStore&) = delete;
+    ContextStore& operator=(const ContextStore&) = delete;
+
+    // Открыть базу, при необходимости мигрировать схему и запустить поток записи
+    bool open(std::string* err = nullptr);
+    // Дождаться записи очереди, остановить поток и закрыть базу
+    void close();
+    bool isOpen() const { return db_ != nullptr; }
+
+    // Поставить сообщение в очередь на запись (не ждёт fsync).
+    // timestamp_us = 0 — текущее время
+    bool append(const std::string& session, ChatRole role, const std::string& content,
+                int64_t timestamp_us = 0);
+
+    // Барьер: вернуться, когда всё поставленное ранее зафиксировано на диске.
+    // false — если какая-то из транзакций завершилась ошибкой
+    bool flush();
+
+    // Последние limit сообщений сессии в хронологическом порядке
+    ChatHistory history(const std::string& session, int limit);
+
+    bool clear(const std::string& session);
+
+    // Все сообщения сессии по порядку, уже распакованные; без загрузки всей истории.
+    // fn возвращает false, чтобы остановиться. Пока идёт обход, запись ждёт
+    using ScanFn = std::function<bool(ChatRole role, int64_t timestamp_us, std::string_view text)>;
+    bool scan(const std::string& session, const ScanFn& fn, std::string* err = nullptr);
+
+    // Импорт в сессию одной транзакцией, мимо очереди записи: fn вызывает
+    // add для каждого сообщения, в памяти держится только текущее. Если fn
+    // вернула false или вставка не удалась — откатывается всё
+    using AddFn = std::function<bool(ChatRole role, int64_t timestamp_us, const std::string& content)>;
+    bool importMessages(const std::string& session, const std::function<bool(const AddFn& add)>& fn,
+                        std::string* err = nullptr);
+
+    // Размер строк и время выборки — чтобы было видно эффект схемы
+    Stats stats(const std::string& session);
+
+    // Кэш кратких изложений (DocumentSummarizer.h): ключ — хеш текста части.
+    // Пишется сразу, мимо очереди: изложение нужно следующему запуску, даже
+    // если этот прервут
+    bool findSummary(uint64_t key, std::string& out);
+    bool storeSummary(uint64_t key, std::string_view summary);
+
+private:
+    struct PendingWrite {
+        std::string session;
+        std::string content;
+        int64_t timestamp_us;
+        ChatRole role;
+        Codec codec = Codec::Plain;
+        size_t raw_len = 0;
+    };
+
+    int schemaVersion();
+    bool tableExists(const char* name);
+    bool createSchema(std::string* err);
+    bool migrateV1toV2(std::string* err);
+    bool migrateV2toV3(std::string* err);
+    bool loadDictionaries(std::string* err);
+    bool prepareStatements(std::string* err);
+    void finalizeStatements();
+    bool exec(const char* sql, std::string* err = nullptr);
+    int64_t queryInt(const char* sql);
+
+    // id сессии по имени (кэшируется); create=false — не создавать новую
+    int64_t sessionId(const std::string& name, bool create);
+
+    void writerLoop();
+    bool writeBatch(std::vector<PendingWrite>& batch);
+    // Сжать ответ ассистента перед вставкой
+    void encode(PendingWrite& w);
+    // Одна строка chat_history; транзакция и db_mutex_ — у вызывающего
+    bool insertRow(const PendingWrite& w);
+    // Вызывается потоком записи под db_mutex_
+    void trainDictionaryIfNeeded();
+
+private:
+    std::string db_path_;
+    sqlite3* db_ = nullptr;
+
+    // Подготовленные один раз запросы
+    sqlite3_stmt* insert_stmt_ = nullptr;
+    sqlite3_stmt* history_stmt_ = nullptr;
+    sqlite3_stmt* clear_stmt_ = nullptr;
+    sqlite3_stmt* find_session_stmt_ = nullptr;
+    sqlite3_stmt* add_session_stmt_ = nullptr;
+    sqlite3_stmt* find_summary_stmt_ = nullptr;
+    sqlite3_stmt* store_summary_stmt_ = nullptr;
+
+    // Соединение общее для писателя и читателей
+    std::mutex db_mutex_;
+    std::unordered_map<std::string, int64_t> session_ids_;
+
+    // Сжатие ответов ассистента
+    std::shared_ptr<ContentCodec> codec_ = std::make_shared<ContentCodec>();
+    int64_t assistant_rows_ = 0;
+    int64_t train_threshold_ = 64;  // после скольких ответов обучать словарь
+
+    // Очередь записи
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::condition_variable committed_cv_;
+    std::deque<PendingWrite> queue_;
+    uint64_t enqueued_ = 0;
+    uint64_t committed_ = 0;
+    int flush_waiters_ = 0;
+    bool write_failed_ = false;
+    bool stopping_ = false;
+    std::thread writer_;
+};
@@ -0,0 +1,264 @@
+#include "DocumentSummarizer.h"
+#include "ContextStore.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace doc_summary {
+
+namespace {
+
+// Меняется вместе с текстом промптов: старые изложения в кэше не подходят
+const char* kPromptVersion = "v1";
+
+const char* kMapPrompt =
+    "Ниже — часть длинного документа. Кратко изложи её содержание: сохрани "
+    "ключевые факты, числа, имена, решения и выводы, ничего не добавляй от себя. "
+    "Пиши связным текстом, без вступлений.\n\nЧАСТЬ ДОКУМЕНТА:\n";
+
+const char* kReducePrompt =
+    "Ниже — краткие изложения идущих подряд частей одного документа. Объедини их "
+    "в одно краткое изложение: сохрани порядок, ключевые факты и выводы, убери "
+    "повторы, ничего не добавляй от себя.\n\nИЗЛОЖЕНИЯ ЧАСТЕЙ:\n";
+
+// FNV-1a, 64 бита
+uint64_t hashText(uint64_t h, std::string_view s) {
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t cacheKey(std::string_view kind, const std::string& salt, std::string_view text) {
+    uint64_t h = 14695981039346656037ull;
+    h = hashText(h, kPromptVersion);
+    h = hashText(h, kind);
+    h = hashText(h, salt);
+    return hashText(h, text);
+}
+
+bool isBlank(std::string_view line) {
+    return line.find_first_not_of(" \t\r") == std::string_view::npos;
+}
+
+// Заголовок Markdown: до трёх пробелов, 1-6 '#' и пробел (или конец строки)
+bool isHeading(std::string_view line) {
+    size_t i = 0;
+    while (i < line.size() && i < 3 && line[i] == ' ') ++i;
+    size_t hashes = 0;
+    while (i < line.size() && line[i] == '#') ++i, ++hashes;
+    if (hashes == 0 || hashes > 6) return false;
+    return i == line.size() || line[i] == ' ' || line[i] == '\t' || line[i] == '\r';
+}
+
+// Абзац вместе с пустыми строками после него
+struct Block {
+    size_t begin = 0;
+    size_t end = 0;
+    bool heading = false;
+};
+
+std::vector<Block> splitBlocks(std::string_view text) {
+    std::vector<Block> blocks;
+    bool after_blank = true;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        const size_t next = nl == std::string_view::npos ? text.size() : nl + 1;
+        const std::string_view line = text.substr(pos, next - pos);
+        const bool blank = isBlank(line);
+        const bool heading = !blank && isHeading(line);
+        // Новый блок — с первой непустой строки после пустой и с заголовка
+        if (blocks.empty() || (!blank && (after_blank || heading))) {
+            blocks.push_back({pos, next, heading});
+        } else {
+            blocks.back().end = next;
+        }
+        after_blank = blank;
+        pos = next;
+    }
+    return blocks;
+}
+
+// Не резать посреди символа UTF-8
+size_t utf8Boundary(std::string_view text, size_t pos) {
+    while (pos > 0 && pos < text.size() && (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80) --pos;
+    return pos;
+}
+
+// Блок больше бюджета — на куски по строкам, иначе по пробелам, иначе по байтам
+void splitOversized(std::string_view text, Block block, size_t max_bytes, std::vector<Block>& out) {
+    size_t begin = block.begin;
+    bool heading = block.heading;
+    while (block.end - begin > max_bytes) {
+        const std::string_view window = text.substr(begin, max_bytes);
+        size_t cut = window.rfind('\n');
+        if (cut == std::string_view::npos || cut < max_bytes / 2) {
+            const size_t space = window.find_last_of(" \t");
+            if (space != std::string_view::npos && space >= max_bytes / 2) cut = space;
+        }
+        size_t end = cut != std::string_view::npos && cut >= max_bytes / 2
+            ? begin + cut + 1
+            : utf8Boundary(text, begin + max_bytes);
+        if (end <= begin) end = begin + max_bytes;   // не UTF-8: режем как есть
+        out.push_back({begin, end, heading});
+        heading = false;
+        begin = end;
+    }
+    out.push_back({begin, block.end, heading});
+}
+
+// Запустить fn(0..n-1) в jobs потоках
+template <typename Fn>
+void runParallel(size_t n, unsigned jobs, Fn fn) {
+    const unsigned threads = (unsigned)std::max<size_t>(1, std::min<size_t>(jobs, n));
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i = next++; i < n; i = next++) fn(i);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+}
+
+// Изложения подряд, с номером внутри группы
+std::string joinSummaries(const std::vector<std::string>& items, size_t begin, size_t end) {
+    std::string out;
+    for (size_t i = begin; i < end; ++i) {
+        if (i > begin) out += "\n\n";
+        out += "[Часть " + std::to_string(i - begin + 1) + "]\n";
+        out += items[i];
+    }
+    return out;
+}
+
+// Изложения набора текстов (частей или групп): из кэша или запросом
+bool summarizeAll(const std::vector<std::string_view>& texts, const char* prompt, std::string_view kind,
+                  const Options& opts, const AskFn& ask, ContextStore* cache,
+                  std::vector<std::string>& out, Stats& stats, std::string* err) {
+    out.assign(texts.size(), {});
+    std::vector<std::string> errors(texts.size());
+    std::atomic<size_t> cached{0}, requests{0};
+
+    runParallel(texts.size(), opts.jobs, [&](size_t i) {
+        const uint64_t key = cacheKey(kind, opts.cache_salt, texts[i]);
+        if (cache && cache->findSummary(key, out[i]) && !out[i].empty()) {
+            ++cached;
+            return;
+        }
+        AiRequest req(prompt);
+        req.attachment = texts[i];
+        ++requests;
+        std::optional<std::string> r;
+        try {
+            r = ask(req, &errors[i]);
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+        if (!r || r->empty()) {
+            out[i].clear();
+            if (errors[i].empty()) errors[i] = "пустой ответ";
+            return;
+        }
+        out[i] = std::move(*r);
+        if (cache) cache->storeSummary(key, out[i]);
+    });
+
+    stats.cached += cached;
+    stats.requests += requests;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        if (!errors[i].empty()) {
+            if (err) *err = std::string(kind == "map" ? "Часть " : "Группа ") + std::to_string(i + 1) +
+                            " из " + std::to_string(texts.size()) + ": " + errors[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+size_t estimateTokens(std::string_view text) {
+    return (text.size() + kBytesPerToken - 1) / kBytesPerToken;
+}
+
+std::vector<std::string_view> splitDocument(std::string_view text, size_t max_tokens) {
+    const size_t max_bytes = std::max<size_t>(max_tokens, 16) * kBytesPerToken;
+    // Короче этого часть режется только перед заголовком
+    const size_t heading_min = max_bytes / 4;
+    // Дальше — после любого абзаца, хеш которого делится на 4: такие
+    // границы не зависят от того, где началась часть
+    const size_t content_min = max_bytes / 2;
+
+    std::vector<Block> blocks;
+    for (const Block& b : splitBlocks(text)) splitOversized(text, b, max_bytes, blocks);
+
+    std::vector<std::string_view> chunks;
+    size_t begin = 0;
+    for (const Block& b : blocks) {
+        const size_t size = b.begin - begin;
+        if (size > 0 && (size + (b.end - b.begin) > max_bytes || (b.heading && size >= heading_min))) {
+            chunks.push_back(text.substr(begin, b.begin - begin));
+            begin = b.begin;
+        }
+        if (b.end - begin >= content_min && (hashText(0, text.substr(b.begin, b.end - b.begin)) & 3) == 0) {
+            chunks.push_back(text.substr(begin, b.end - begin));
+            begin = b.end;
+        }
+    }
+    if (begin < text.size()) chunks.push_back(text.substr(begin));
+    return chunks;
+}
+
+std::optional<std::string> summarize(std::string_view text, const Options& opts, const AskFn& ask,
+                                     ContextStore* cache, Stats* stats_out, std::string* err) {
+    Stats stats;
+    const std::vector<std::string_view> chunks = splitDocument(text, opts.chunk_tokens);
+    stats.chunks = chunks.size();
+
+    // map: части документа уходят в запросы прямо из text, без копий
+    std::vector<std::string> level;
+    if (chunks.size() > 1 &&
+        !summarizeAll(chunks, kMapPrompt, "map", opts, ask, cache, level, stats, err)) {
+        if (stats_out) *stats_out = stats;
+        return std::nullopt;
+    }
+
+    // reduce: соседние изложения — в группы по бюджету, пока не поместятся в
+    // итоговый запрос. В группе не меньше двух, так что уровней не больше log2
+    std::string joined = chunks.size() > 1 ? joinSummaries(level, 0, level.size()) : std::string();
+    const size_t max_bytes = opts.chunk_tokens * kBytesPerToken;
+    while (chunks.size() > 1 && estimateTokens(joined) > opts.chunk_tokens && level.size() > 1) {
+        std::vector<std::string> groups;
+        for (size_t i = 0; i < level.size();) {
+            size_t end = i + 1, bytes = level[i].size();
+            while (end < level.size() && (end - i < 2 || bytes + level[end].size() + 16 <= max_bytes)) {
+                bytes += level[end].size() + 16;
+                ++end;
+            }
+            groups.push_back(joinSummaries(level, i, end));
+            i = end;
+        }
+        const std::vector<std::string_view> views(groups.begin(), groups.end());
+        std::vector<std::string> next;
+        if (!summarizeAll(views, kReducePrompt, "reduce", opts, ask, cache, next, stats, err)) {
+            if (stats_out) *stats_out = stats;
+            return std::nullopt;
+        }
+        level = std::move(next);
+        joined = joinSummaries(level, 0, level.size());
+        ++stats.levels;
+    }
+
+    // Итоговый запрос — с режимом и контекстом, поэтому не кэшируется
+    AiRequest req(opts.final_prompt);
+    req.attachment = chunks.size() > 1 ? std::string_view(joined) : text;
+    ++stats.requests;
+    auto result = ask(req, err);
+    if (stats_out) *stats_out = stats;
+    return result;
+}
+
+}
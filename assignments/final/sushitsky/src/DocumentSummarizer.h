@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AiRequest.h"
+
+class ContextStore;
+
+// Суммаризация документа, который не помещается в контекст модели.
+//
+// map: документ режется на части по абзацам и заголовкам, каждая часть
+// излагается кратко отдельным запросом (несколько запросов одновременно).
+// reduce: изложения соседних частей объединяются группами, пока всё не
+// поместится в один запрос; последний запрос делает итоговое изложение.
+//
+// Изложения частей и промежуточных групп кэшируются в ContextStore по хешу
+// текста. Границы частей зависят от содержимого (заголовки и хеш абзаца), а
+// не только от смещения, поэтому правка в середине документа сдвигает
+// только соседние части — остальные берутся из кэша.
+namespace doc_summary {
+
+// Грубая оценка числа токенов: 3 байта UTF-8 на токен. Для латиницы это
+// с запасом, для кириллицы (2 байта на букву) — около 1.5 букв на токен
+constexpr size_t kBytesPerToken = 3;
+size_t estimateTokens(std::string_view text);
+
+// Части документа подряд, без пропусков, каждая не больше max_tokens.
+// Режется перед заголовком ("# ...") или после абзаца; абзац больше бюджета
+// делится по строкам, затем по пробелам
+std::vector<std::string_view> splitDocument(std::string_view text, size_t max_tokens);
+
+struct Options {
+    size_t chunk_tokens = 2048;   // сколько текста идёт в один запрос
+    unsigned jobs = 4;            // одновременных запросов
+    // Модель и версия промптов: изложения разных моделей в кэше не смешиваются
+    std::string cache_salt;
+    // Инструкция итогового запроса (режим, контекст разговора); текст
+    // изложений идёт сразу после неё
+    std::string final_prompt;
+};
+
+struct Stats {
+    size_t chunks = 0;     // частей документа
+    size_t cached = 0;     // изложений (частей и групп) из кэша
+    size_t requests = 0;   // запросов к модели, включая итоговый
+    size_t levels = 0;     // шагов объединения между map и итоговым запросом
+};
+
+// Запрос к модели (AiAgent::execute)
+using AskFn = std::function<std::optional<std::string>(const AiRequest& req, std::string* err)>;
+
+// cache == nullptr — без кэша. Ошибка любой части — ошибка всего изложения,
+// но уже полученные изложения остаются в кэше и при повторе не запрашиваются
+std::optional<std::string> summarize(std::string_view text, const Options& opts, const AskFn& ask,
+                                     ContextStore* cache, Stats* stats = nullptr,
+                                     std::string* err = nullptr);
+
+}
@@ -0,0 +1,227 @@
+#include "JsonWriter.h"
+#include <charconv>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define JSON_WRITER_X86 1
+#endif
+
+namespace json_writer {
+
+namespace {
+
+inline bool needsEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Индекс первого байта в [i, n), который нужно экранировать (или n)
+size_t scanScalar(const char* p, size_t i, size_t n) {
+    while (i < n && !needsEscape((unsigned char)p[i])) ++i;
+    return i;
+}
+
+#ifdef JSON_WRITER_X86
+// c < 0x20 (без знака) <=> min(c, 0x1F) == c
+size_t scanSse2(const char* p, size_t i, size_t n) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return scanScalar(p, i, n);
+}
+
+__attribute__((target("avx2")))
+size_t scanAvx2(const char* p, size_t i, size_t n) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i ctl = _mm256_set1_epi8(0x1F);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bslash)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return scanSse2(p, i, n);
+}
+#endif
+
+using ScanFn = size_t (*)(const char*, size_t, size_t);
+
+ScanFn scanFor(Simd simd) {
+#ifdef JSON_WRITER_X86
+    switch (simd) {
+        case Simd::AVX2: return scanAvx2;
+        case Simd::SSE2: return scanSse2;
+        case Simd::Scalar: break;
+    }
+#else
+    (void)simd;
+#endif
+    return scanScalar;
+}
+
+void appendEscapedChar(std::string& out, unsigned char c) {
+    static const char hex[] = "0123456789abcdef";
+    switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: {
+            char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            out.append(u, sizeof(u));
+        }
+    }
+}
+
+void appendEscapedWith(std::string& out, std::string_view s, ScanFn scan) {
+    const char* p = s.data();
+    const size_t n = s.size();
+    // Обычно экранировать почти нечего — место под чуть больший объём
+    out.reserve(out.size() + n + n / 16 + 16);
+
+    size_t i = 0;
+    while (i < n) {
+        size_t j = scan(p, i, n);
+        out.append(p + i, j - i);
+        if (j == n) break;
+        appendEscapedChar(out, (unsigned char)p[j]);
+        i = j + 1;
+    }
+}
+
+}
+
+Simd detectSimd() {
+#ifdef JSON_WRITER_X86
+    static const Simd best = __builtin_cpu_supports("avx2") ? Simd::AVX2 : Simd::SSE2;
+    return best;
+#else
+    return Simd::Scalar;
+#endif
+}
+
+const char* simdName(Simd simd) {
+    switch (simd) {
+        case Simd::AVX2: return "avx2";
+        case Simd::SSE2: return "sse2";
+        case Simd::Scalar: break;
+    }
+    return "scalar";
+}
+
+void appendEscaped(std::string& out, std::string_view s) {
+    static const ScanFn scan = scanFor(detectSimd());
+    appendEscapedWith(out, s, scan);
+}
+
+void appendEscaped(std::string& out, std::string_view s, Simd simd) {
+    appendEscapedWith(out, s, scanFor(simd));
+}
+
+// ---------------- Writer ----------------
+
+Writer::Writer(std::string& out, size_t reserve) : out_(out) {
+    out_.clear();
+    if (reserve) out_.reserve(reserve);
+}
+
+void Writer::separator(std::string_view key) {
+    if (!first_) out_ += ',';
+    first_ = false;
+    if (!key.empty()) {
+        out_ += '"';
+        appendEscaped(out_, key);
+        out_ += "\":";
+    }
+}
+
+Writer& Writer::beginObject(std::string_view key) {
+    separator(key);
+    out_ += '{';
+    first_ = true;
+    return *this;
+}
+
+Writer& Writer::endObject() {
+    out_ += '}';
+    first_ = false;
+    return *this;
+}
+
+Writer& Writer::beginArray(std::string_view key) {
+    separator(key);
+    out_ += '[';
+    first_ = true;
+    return *this;
+}
+
+Writer& Writer::endArray() {
+    out_ += ']';
+    first_ = false;
+    return *this;
+}
+
+Writer& Writer::field(std::string_view key, std::string_view value) {
+    separator(key);
+    out_ += '"';
+    appendEscaped(out_, value);
+    out_ += '"';
+    return *this;
+}
+
+Writer& Writer::field(std::string_view key, std::initializer_list<std::string_view> parts) {
+    separator(key);
+    out_ += '"';
+    for (std::string_view part : parts) appendEscaped(out_, part);
+    out_ += '"';
+    return *this;
+}
+
+Writer& Writer::field(std::string_view key, int64_t value) {
+    separator(key);
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out_.append(buf, res.ptr);
+    return *this;
+}
+
+Writer& Writer::field(std::string_view key, double value) {
+    separator(key);
+    if (!std::isfinite(value)) {
+        out_ += "null";  // как json::dump()
+        return *this;
+    }
+    // Кратчайшая запись, которая читается обратно в то же число (0.7, а не 0.69999...)
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out_.append(buf, res.ptr);
+    // dump() всегда оставляет у дробного типа точку или экспоненту
+    bool has_point = false;
+    for (const char* c = buf; c != res.ptr; ++c) {
+        if (*c == '.' || *c == 'e') { has_point = true; break; }
+    }
+    if (!has_point) out_ += ".0";
+    return *this;
+}
+
+Writer& Writer::field(std::string_view key, bool value) {
+    separator(key);
+    out_ += value ? "true" : "false";
+    return *this;
+}
+
+}
@@ -0,0 +1,292 @@
+#include "LlamaBackend.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef NO_LLAMA
+#include <llama.h>
+#endif
+
+#ifdef NO_LLAMA
+
+struct LlamaBackend::Impl {};
+
+LlamaBackend::LlamaBackend(Options) {}
+LlamaBackend::~LlamaBackend() = default;
+
+bool LlamaBackend::load(std::string* err) {
+    if (err) *err = "Built without llama.cpp: reconfigure with -DAI_AGENT_WITH_LLAMA=ON";
+    return false;
+}
+
+bool LlamaBackend::loaded() const { return false; }
+
+std::optional<std::string> LlamaBackend::generate(const AiRequest&, std::string* err) {
+    load(err);
+    return std::nullopt;
+}
+
+#else
+
+namespace {
+
+// Сколько байт в начале s — целые символы UTF-8: кусок токена может
+// оборвать символ, хвост ждёт следующего токена
+size_t completeUtf8(const std::string& s) {
+    size_t lead = s.size();
+    while (lead > 0 && (static_cast<unsigned char>(s[lead - 1]) & 0xC0) == 0x80) --lead;
+    if (lead == 0) return s.size();
+    const unsigned char c = static_cast<unsigned char>(s[lead - 1]);
+    const size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    return lead - 1 + len > s.size() ? lead - 1 : s.size();
+}
+
+// Журнал llama.cpp (загрузка тензоров и т.п.) — только ошибки
+void logErrors(ggml_log_level level, const char* text, void*) {
+    if (level == GGML_LOG_LEVEL_ERROR) std::fputs(text, stderr);
+}
+
+void initBackendOnce() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        llama_log_set(logErrors, nullptr);
+        llama_backend_init();
+    });
+}
+
+}
+
+struct LlamaBackend::Impl {
+    Options opts;
+    std::mutex mutex;   // один контекст — один запрос за раз
+
+    llama_model* model = nullptr;
+    llama_context* ctx = nullptr;
+    const llama_vocab* vocab = nullptr;
+    std::string chat_template;
+
+    // Токены, которые сейчас лежат в KV-кэше (последовательность 0)
+    std::vector<llama_token> cached;
+
+    ~Impl() {
+        if (ctx) llama_free(ctx);
+        if (model) llama_model_free(model);
+    }
+
+    bool load(std::string* err) {
+        if (ctx) return true;
+        if (opts.model_path.empty()) {
+            if (err) *err = "local_model_path is not set";
+            return false;
+        }
+        initBackendOnce();
+        std::cerr << "Loading model: " << opts.model_path << std::endl;
+
+        llama_model_params mp = llama_model_default_params();
+        mp.use_mmap = true;
+        mp.n_gpu_layers = opts.n_gpu_layers;
+        model = llama_model_load_from_file(opts.model_path.c_str(), mp);
+        if (!model) {
+            if (err) *err = "Cannot load model: " + opts.model_path;
+            return false;
+        }
+
+        const int threads = opts.n_threads > 0 ? opts.n_threads
+                                               : (int)std::max(1u, std::thread::hardware_concurrency());
+        llama_context_params cp = llama_context_default_params();
+        cp.n_ctx = (uint32_t)std::max(512, opts.n_ctx);
+        cp.n_batch = std::min<uint32_t>(cp.n_ctx, 2048);
+        cp.n_threads = threads;
+        cp.n_threads_batch = threads;
+        ctx = llama_init_from_model(model, cp);
+        if (!ctx) {
+            llama_model_free(model);
+            model = nullptr;
+            if (err) *err = "Cannot create llama context (n_ctx " + std::to_string(cp.n_ctx) + ")";
+            return false;
+        }
+        vocab = llama_model_get_vocab(model);
+        // Шаблон из GGUF; у старых моделей его нет — ChatML
+        const char* tmpl = llama_model_chat_template(model, nullptr);
+        chat_template = tmpl ? tmpl : "chatml";
+        return true;
+    }
+
+    // Диалог целиком в текст по шаблону модели, с началом ответа ассистента
+    bool formatChat(const AiRequest& req, std::string& out, std::string* err) {
+        std::string user;
+        user.reserve(req.prompt.size() + req.attachment.size());
+        user += req.prompt;
+        user += req.attachment;
+
+        std::vector<llama_chat_message> chat;
+        if (!req.system.empty()) chat.push_back({"system", req.system.c_str()});
+        for (const auto& m : req.messages) chat.push_back({m.role.c_str(), m.content.c_str()});
+        if (req.hasPrompt()) chat.push_back({"user", user.c_str()});
+
+        size_t reserve = 256;
+        for (const auto& m : chat) reserve += std::char_traits<char>::length(m.content) + 32;
+        out.resize(reserve);
+        int n = llama_chat_apply_template(chat_template.c_str(), chat.data(), chat.size(), true,
+                                          &out[0], (int32_t)out.size());
+        if (n < 0 && chat_template != "chatml") {
+            // Шаблон, которого llama.cpp не знает (нестандартный Jinja)
+            chat_template = "chatml";
+            n = llama_chat_apply_template(chat_template.c_str(), chat.data(), chat.size(), true,
+                                          &out[0], (int32_t)out.size());
+        }
+        if (n < 0) {
+            if (err) *err = "Cannot apply chat template";
+            return false;
+        }
+        if ((size_t)n > out.size()) {
+            out.resize(n);
+            n = llama_chat_apply_template(chat_template.c_str(), chat.data(), chat.size(), true,
+                                          &out[0], (int32_t)out.size());
+        }
+        out.resize(n);
+        return true;
+    }
+
+    bool tokenize(const std::string& text, std::vector<llama_token>& out, std::string* err) {
+        out.resize(text.size() + 2);
+        int n = llama_tokenize(vocab, text.data(), (int32_t)text.size(), out.data(), (int32_t)out.size(),
+                               true, true);
+        if (n < 0) {
+            out.resize(-n);
+            n = llama_tokenize(vocab, text.data(), (int32_t)text.size(), out.data(), (int32_t)out.size(),
+                               true, true);
+        }
+        if (n < 0) {
+            if (err) *err = "Cannot tokenize prompt";
+            return false;
+        }
+        out.resize(n);
+        return true;
+    }
+
+    // Токены с позиции cached.size() — в контекст, порциями по n_batch
+    bool decode(const llama_token* tokens, size_t n) {
+        const size_t batch = std::max<uint32_t>(1, llama_n_batch(ctx));
+        for (size_t i = 0; i < n; i += batch) {
+            const size_t len = std::min(batch, n - i);
+            if (llama_decode(ctx, llama_batch_get_one(const_cast<llama_token*>(tokens + i), (int32_t)len)) != 0) {
+                return false;
+            }
+            cached.insert(cached.end(), tokens + i, tokens + i + len);
+        }
+        return true;
+    }
+
+    void resetCache() {
+        llama_memory_clear(llama_get_memory(ctx), true);
+        cached.clear();
+    }
+
+    std::optional<std::string> generate(const AiRequest& req, std::string* err) {
+        if (!load(err)) return std::nullopt;
+
+        std::string text;
+        std::vector<llama_token> prompt;
+        if (!formatChat(req, text, err) || !tokenize(text, prompt, err)) return std::nullopt;
+
+        const size_t n_ctx = llama_n_ctx(ctx);
+        if (prompt.size() + 1 >= n_ctx) {
+            if (err) *err = "Prompt does not fit into context: " + std::to_string(prompt.size()) +
+                            " tokens, n_ctx " + std::to_string(n_ctx);
+            return std::nullopt;
+        }
+
+        // Общий префикс с тем, что уже в KV-кэше, не пересчитывается. Хотя бы
+        // последний токен промпта декодируется заново — нужны его логиты
+        size_t n_past = 0;
+        while (n_past < cached.size() && n_past < prompt.size() && cached[n_past] == prompt[n_past]) ++n_past;
+        n_past = std::min(n_past, prompt.size() - 1);
+        if (!llama_memory_seq_rm(llama_get_memory(ctx), 0, (llama_pos)n_past, -1)) {
+            resetCache();
+            n_past = 0;
+        }
+        cached.resize(n_past);
+        if (!decode(prompt.data() + n_past, prompt.size() - n_past)) {
+            resetCache();
+            if (err) *err = "llama_decode failed on prompt";
+            return std::nullopt;
+        }
+
+        llama_sampler* sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+        if (req.temperature <= 0) {
+            llama_sampler_chain_add(sampler, llama_sampler_init_greedy());
+        } else {
+            llama_sampler_chain_add(sampler, llama_sampler_init_top_p((float)req.top_p, 1));
+            llama_sampler_chain_add(sampler, llama_sampler_init_temp((float)req.temperature));
+            llama_sampler_chain_add(sampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+        }
+
+        // Ответ не длиннее, чем осталось места в контексте
+        const size_t max_tokens = std::min<size_t>(std::max(1, req.max_tokens), n_ctx - cached.size());
+        std::string answer, pending;
+        bool ok = true, stopped = false;
+        char piece[256];
+        for (size_t i = 0; i < max_tokens && !stopped; ++i) {
+            if (req.cancelled()) {
+                if (err) *err = "Request cancelled";
+                ok = false;
+                break;
+            }
+            llama_token token = llama_sampler_sample(sampler, ctx, -1);
+            if (llama_vocab_is_eog(vocab, token)) break;
+
+            const int n = llama_token_to_piece(vocab, token, piece, sizeof(piece), 0, false);
+            if (n > 0) {
+                pending.append(piece, n);
+                const size_t ready = completeUtf8(pending);
+                if (ready > 0) {
+                    const std::string_view out(pending.data(), ready);
+                    answer += out;
+                    if (req.on_token && !req.on_token(out)) stopped = true;
+                    pending.erase(0, ready);
+                }
+            }
+            if (i + 1 < max_tokens && !stopped && !decode(&token, 1)) {
+                resetCache();
+                if (err) *err = "llama_decode failed during generation";
+                ok = false;
+                break;
+            }
+        }
+        llama_sampler_free(sampler);
+        if (!ok) return std::nullopt;
+
+        if (!pending.empty()) {
+            answer += pending;
+            if (req.on_token && !stopped) req.on_token(pending);
+        }
+        return answer;
+    }
+};
+
+LlamaBackend::LlamaBackend(Options opts) : impl_(std::make_unique<Impl>()) {
+    impl_->opts = std::move(opts);
+}
+
+LlamaBackend::~LlamaBackend() = default;
+
+bool LlamaBackend::load(std::string* err) {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->load(err);
+}
+
+bool LlamaBackend::loaded() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->ctx != nullptr;
+}
+
+std::optional<std::string> LlamaBackend::generate(const AiRequest& req, std::string* err) {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->generate(req, err);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <string>
+#include "AiRequest.h"
+
+// Модель GGUF прямо в процессе агента (model_type "local_lib"), без
+// llama-server и JSON по HTTP.
+//
+// Модель загружается при первом запросе (файл отображается в память, веса
+// не копируются) и вместе с контекстом живёт до конца процесса. В KV-кэше
+// остаются токены последнего диалога: следующий запрос пересчитывает только
+// то, что идёт после общего префикса (системный промпт, история сессии),
+// поэтому ход диалога стоит примерно как его новое сообщение.
+//
+// Без llama.cpp при сборке (NO_LLAMA) generate() возвращает ошибку.
+class LlamaBackend {
+public:
+    struct Options {
+        std::string model_path;
+        int n_ctx = 4096;
+        int n_threads = 0;      // 0 — по числу ядер
+        int n_gpu_layers = 0;   // слоёв на GPU, если llama.cpp собран с ним
+    };
+
+    explicit LlamaBackend(Options opts);
+    ~LlamaBackend();
+    LlamaBackend(const LlamaBackend&) = delete;
+    LlamaBackend& operator=(const LlamaBackend&) = delete;
+
+    // Загрузить модель заранее; generate() делает это сам при первом вызове
+    bool load(std::string* err = nullptr);
+    bool loaded() const;
+
+    // Ответ на запрос: system + messages + prompt/attachment по шаблону чата
+    // модели. Куски ответа по мере генерации уходят в req.on_token. Запросы
+    // выполняются по одному — контекст у модели один
+    std::optional<std::string> generate(const AiRequest& req, std::string* err = nullptr);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+struct evp_md_ctx_st;
+
+// Переносимый файл сессии (export-session / import-session).
+//
+//   "AISESS\0" <версия:1 байт>
+//   кадр*     : <длина:uint32 LE> <CBOR>
+//   окончание : <0:uint32> <число записей:uint64 LE> <SHA-256:32 байта>
+//
+// Первый кадр — заголовок (объект с описанием содержимого), остальные —
+// массивы по kChunkRecords записей. SHA-256 считается по всем байтам файла
+// до окончания, так что verify() проверяет файл без разбора CBOR, и обрыв
+// или порча видны ещё до импорта. Файл пишется и читается по кадрам —
+// целиком в память он не попадает.
+namespace session_archive {
+
+constexpr uint8_t kFormatVersion = 1;
+constexpr size_t kChunkRecords = 256;
+
+class Writer {
+public:
+    Writer();
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool open(const std::string& path, nlohmann::json header, std::string* err = nullptr);
+    // Запись буферизуется и уходит в файл целым кадром
+    bool add(nlohmann::json record, std::string* err = nullptr);
+    // Дописать остаток и кадр с контрольной суммой
+    bool finish(std::string* err = nullptr);
+
+    uint64_t count() const { return count_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    bool writeRaw(const void* data, size_t size, bool hashed = true);
+    bool writeFrame(const nlohmann::json& frame);
+    bool flushChunk();
+
+    std::ofstream out_;
+    evp_md_ctx_st* sha_ = nullptr;
+    nlohmann::json pending_ = nlohmann::json::array();
+    uint64_t count_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+class Reader {
+public:
+    // Пройти файл по кадрам и сверить контрольную сумму (без разбора CBOR).
+    // records — число записей, объявленное в окончании
+    static bool verify(const std::string& path, std::string* err = nullptr,
+                       uint64_t* records = nullptr);
+
+    bool open(const std::string& path, std::string* err = nullptr);
+    const nlohmann::json& header() const { return header_; }
+
+    // Записи следующего кадра; false — кадры кончились (или ошибка, см. err)
+    bool next(std::vector<nlohmann::json>& records, std::string* err = nullptr);
+
+private:
+    std::ifstream in_;
+    nlohmann::json header_;
+    std::string payload_;
+    bool done_ = false;
+};
+
+}
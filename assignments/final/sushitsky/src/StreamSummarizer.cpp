@@ -0,0 +1,132 @@
+#include "StreamSummarizer.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+
+namespace stream_summary {
+
+namespace {
+
+const char* kFirstPrompt =
+    "Ниже — начало потока текста (журнал, расшифровка), который продолжает поступать. "
+    "Кратко изложи его: события, ошибки и предупреждения, решения, важные числа. "
+    "Верни только изложение, без вступлений.\n\nФРАГМЕНТ ПОТОКА:\n";
+
+const char* kUpdatePrompt =
+    "Ты ведешь краткое изложение потока текста (журнал, расшифровка), который "
+    "поступает частями. Обнови изложение с учетом нового фрагмента: сохрани важное "
+    "из прежнего, добавь новое (события, ошибки, решения, числа), сократи "
+    "устаревшие подробности. Верни только обновленное изложение.\n\nТЕКУЩЕЕ ИЗЛОЖЕНИЕ:\n";
+
+// Пока данных нет, stop проверяется хотя бы так часто
+const int kStopPollMs = 500;
+
+using Clock = std::chrono::steady_clock;
+
+// Сколько байт окна отправить: до последнего перевода строки, чтобы не
+// резать строку журнала; неполная строка остается до следующего окна.
+// Строка без перевода во все окно режется по границе символа UTF-8
+size_t cutWindow(const std::string& window) {
+    const size_t nl = window.rfind('\n');
+    if (nl != std::string::npos) return nl + 1;
+    size_t lead = window.size();
+    while (lead > 0 && (static_cast<unsigned char>(window[lead - 1]) & 0xC0) == 0x80) --lead;
+    if (lead == 0) return window.size();
+    const unsigned char c = static_cast<unsigned char>(window[lead - 1]);
+    const size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    return lead - 1 + len > window.size() && lead > 1 ? lead - 1 : window.size();
+}
+
+}
+
+std::optional<std::string> summarize(int fd, const Options& opts, const doc_summary::AskFn& ask,
+                                     const EmitFn& emit, const std::atomic<bool>* stop,
+                                     Stats* stats_out, std::string* err) {
+    const size_t window_bytes = std::max<size_t>(opts.window_bytes, 256);
+    std::string window;
+    window.reserve(window_bytes);
+    std::string state;
+    Stats stats;
+    std::string last_error;
+
+    // Отправить первые n байт окна и обновить изложение
+    auto step = [&](size_t n, bool final_step) {
+        std::string prompt = state.empty() ? kFirstPrompt
+                                           : kUpdatePrompt + state + "\n\nНОВЫЙ ФРАГМЕНТ ПОТОКА:\n";
+        AiRequest req(std::move(prompt));
+        req.attachment = std::string_view(window).substr(0, n);
+        ++stats.windows;
+        std::string step_err;
+        std::optional<std::string> r;
+        try {
+            r = ask(req, &step_err);
+        } catch (const std::exception& e) {
+            step_err = e.what();
+        }
+        if (r && !r->empty()) {
+            state = std::move(*r);
+        } else {
+            ++stats.failed;
+            last_error = step_err.empty() ? "пустой ответ" : step_err;
+            std::cerr << "Окно " << stats.windows << " пропущено: " << last_error << std::endl;
+        }
+        window.erase(0, n);
+        if (!final_step && emit && !state.empty()) emit(state, stats);
+    };
+
+    auto last_emit = Clock::now();
+    const auto interval = std::chrono::seconds(opts.interval_sec);
+    bool eof = false;
+    while (!eof && !(stop && stop->load())) {
+        // Ждем данные, но не дольше, чем до следующей сводки по времени
+        int timeout = stop ? kStopPollMs : -1;
+        if (opts.interval_sec > 0 && !window.empty()) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                last_emit + interval - Clock::now()).count();
+            timeout = timeout < 0 ? (int)std::max<long long>(0, left)
+                                  : (int)std::max<long long>(0, std::min<long long>(timeout, left));
+        }
+        pollfd p{fd, POLLIN, 0};
+        const int ready = ::poll(&p, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            if (err) *err = std::string("poll: ") + std::strerror(errno);
+            return std::nullopt;
+        }
+        if (ready > 0) {
+            const size_t used = window.size();
+            window.resize(window_bytes);
+            const ssize_t n = ::read(fd, &window[used], window_bytes - used);
+            window.resize(used + (n > 0 ? (size_t)n : 0));
+            if (n == 0) {
+                eof = true;
+            } else if (n < 0 && errno != EINTR && errno != EAGAIN) {
+                if (err) *err = std::string("read: ") + std::strerror(errno);
+                return std::nullopt;
+            } else if (n > 0) {
+                stats.bytes_read += (size_t)n;
+            }
+        }
+
+        const bool full = window.size() >= window_bytes;
+        const bool due = opts.interval_sec > 0 && !window.empty() && Clock::now() - last_emit >= interval;
+        if (!eof && (full || due)) {
+            step(cutWindow(window), false);
+            last_emit = Clock::now();
+        }
+    }
+
+    // Конец входа или остановка: остаток окна — в итоговое изложение
+    if (!window.empty()) step(window.size(), true);
+    if (stats_out) *stats_out = stats;
+    if (state.empty()) {
+        if (err) *err = stats.bytes_read == 0 ? "Входной поток пуст" : last_error;
+        return std::nullopt;
+    }
+    return state;
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <string>
+#include "DocumentSummarizer.h"
+
+// Сводка потока, который может не кончиться (tail -f, расшифровка):
+//
+//   tail -f app.log | ./ai_agent --cli --mode summary -
+//
+// Вход читается окнами не больше window_bytes. Окно отправляется модели
+// вместе с текущим изложением, и ответ становится новым изложением, так
+// что в памяти всегда только окно и изложение (его размер ограничен
+// max_tokens ответа) — сколько бы ни пришло на вход.
+namespace stream_summary {
+
+struct Options {
+    size_t window_bytes = 8 * 1024;   // новых данных в одном запросе
+    // Сводка не реже, чем раз в столько секунд, если пришло хоть что-то;
+    // 0 — только по заполнению окна и в конце
+    unsigned interval_sec = 60;
+};
+
+struct Stats {
+    size_t bytes_read = 0;
+    size_t windows = 0;   // отправлено окон
+    size_t failed = 0;    // окон, по которым запрос не удался (пропущены)
+};
+
+// Промежуточная сводка: после каждого окна, кроме последнего
+using EmitFn = std::function<void(const std::string& summary, const Stats& stats)>;
+
+// Читает fd до конца или пока не поднят stop; возвращает итоговое изложение.
+// Окно, по которому запрос не удался, пропускается: держать его дальше —
+// значит расти без предела
+std::optional<std::string> summarize(int fd, const Options& opts, const doc_summary::AskFn& ask,
+                                     const EmitFn& emit, const std::atomic<bool>* stop = nullptr,
+                                     Stats* stats = nullptr, std::string* err = nullptr);
+
+}
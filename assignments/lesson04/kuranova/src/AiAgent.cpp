@@ -3,6 +3,7 @@
 #include <sstream>
 #include <vector>
 #include <cstring>
+#include <mutex>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -78,12 +79,23 @@ std::string AiAgent::extractTextFromJsonBody(const std::string& body) {
     }
 }
 
+// Глобальная инициализация OpenSSL — один раз на процесс, а не в каждом
+// запросе (параллельные execute() не должны в ней пересекаться)
+static void initSslOnce() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        SSL_library_init();
+        SSL_load_error_strings();
+        OpenSSL_add_all_algorithms();
+    });
+}
+
 // -------- Низкоуровневый HTTPS POST на /api/generate --------
 std::optional<std::string> AiAgent::httpsPostGenerate(
-        const AiConfig& cfg, const std::string& jsonBody, std::string* err) {
-    SSL_library_init();
-    SSL_load_error_strings();
-    OpenSSL_add_all_algorithms();
+        const AiConfig& cfg, const std::string& jsonBody, std::string* err,
+        const std::atomic<bool>* cancel) {
+    initSslOnce();
+    auto cancelled = [cancel] { return cancel && cancel->load(std::memory_order_relaxed); };
 
     SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
     if (!ctx) { if (err) *err = "SSL_CTX_new failed"; return std::nullopt; }
@@ -106,6 +118,11 @@ std::optional<std::string> AiAgent::httpsPostGenerate(
     }
     freeaddrinfo(res);
 
+    if (cancelled()) {
+        if (err) *err = "Request cancelled";
+        close(sock); SSL_CTX_free(ctx); return std::nullopt;
+    }
+
     SSL* ssl = SSL_new(ctx);
     SSL_set_fd(ssl, sock);
     if (SSL_connect(ssl) <= 0) {
@@ -129,18 +146,33 @@ std::optional<std::string> AiAgent::httpsPostGenerate(
         SSL_free(ssl); close(sock); SSL_CTX_free(ctx); return std::nullopt;
     }
 
+    // Таймаут ставится только после рукопожатия и отправки запроса: иначе
+    // медленный SSL_connect оборвался бы через 200 мс, даже без отмены.
+    // Чтобы заметить отмену, пока сервер думает, чтение не блокируется дольше 200 мс
+    if (cancel) {
+        struct timeval tv = {0, 200 * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
     char buf[4096];
     std::string response;
-    int bytes;
-    while ((bytes = SSL_read(ssl, buf, sizeof(buf)-1)) > 0) {
-        buf[bytes] = '\0';
-        response += buf;
+    while (true) {
+        int bytes = SSL_read(ssl, buf, sizeof(buf));
+        if (bytes > 0) { response.append(buf, bytes); continue; }
+        // Таймаут чтения (есть только с cancel) — проверяем отмену и ждём дальше
+        if (cancel && !cancelled() && SSL_get_error(ssl, bytes) == SSL_ERROR_WANT_READ) continue;
+        break;
     }
 
     SSL_free(ssl);
     close(sock);
     SSL_CTX_free(ctx);
 
+    if (cancelled()) {
+        if (err) *err = "Request cancelled";
+        return std::nullopt;
+    }
+
     // ----- Используем nlohmann::json для извлечения "text" -----
     std::string text = extractTextFromJsonBody(response);
     //std::cout << response << std::endl;
@@ -152,18 +184,22 @@ std::optional<std::string> AiAgent::httpsPostGenerate(
 }
 
 std::optional<std::string> AiAgent::ask(std::string* outErr) const {
+    return execute(AiRequest(prompt_), outErr);
+}
+
+std::optional<std::string> AiAgent::execute(const AiRequest& req, std::string* outErr) const {
     if (cfg_.host.empty() || cfg_.api_key.empty()) {
         if (outErr) *outErr = "Config not loaded or api_key/host missing";
         return std::nullopt;
     }
-    if (prompt_.empty()) {
+    if (req.prompt.empty() && req.messages.empty()) {
         if (outErr) *outErr = "Prompt is empty (load it first)";
         return std::nullopt;
     }
 
     // Формируем корректный JSON тела через nlohmann/json
-    json payload = { {"prompt", prompt_} };
+    json payload = { {"prompt", req.flatPrompt()} };
     const std::string body = payload.dump();
 
-    return httpsPostGenerate(cfg_, body, outErr);
+    return httpsPostGenerate(cfg_, body, outErr, req.cancel);
 }
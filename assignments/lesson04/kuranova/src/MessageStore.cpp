@@ -0,0 +1,137 @@
+#include "MessageStore.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+MessageStore::MessageStore(const std::string& path, size_t cache_size) : cache_size(cache_size) {
+	if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+		std::cerr << "Не удалось открыть базу данных: " << sqlite3_errmsg(db) << std::endl;
+		sqlite3_close(db);
+		db = nullptr;
+		return;
+	}
+
+	const char* createTableSQL =
+		"PRAGMA journal_mode=WAL;"
+		"PRAGMA synchronous=NORMAL;"
+		"CREATE TABLE IF NOT EXISTS message ("
+		"id INTEGER PRIMARY KEY AUTOINCREMENT,"
+		"message_text TEXT NOT NULL,"
+		"date DATETIME DEFAULT CURRENT_TIMESTAMP,"
+		"user INTEGER DEFAULT 0,"
+		"type INTEGER CHECK (type IN (0, 1)) DEFAULT 0"
+		");";
+
+	char* err = nullptr;
+	if (sqlite3_exec(db, createTableSQL, nullptr, nullptr, &err) != SQLITE_OK) {
+		std::cerr << "Ошибка создания таблицы: " << err << std::endl;
+		sqlite3_free(err);
+		sqlite3_close(db);
+		db = nullptr;
+		return;
+	}
+
+	if (!prepare()) {
+		sqlite3_close(db);
+		db = nullptr;
+		return;
+	}
+	load_cache();
+}
+
+MessageStore::~MessageStore() {
+	sqlite3_finalize(insert_stmt);
+	sqlite3_finalize(last_stmt);
+	sqlite3_close(db);
+}
+
+bool MessageStore::prepare() {
+	const char* insert_sql = "INSERT INTO message (message_text, type) VALUES (?, ?);";
+	// id DESC по первичному ключу — без сортировки, переворачиваем у себя
+	const char* last_sql = "SELECT message_text, type FROM message ORDER BY id DESC LIMIT ?;";
+
+	if (sqlite3_prepare_v2(db, insert_sql, -1, &insert_stmt, nullptr) != SQLITE_OK ||
+		sqlite3_prepare_v2(db, last_sql, -1, &last_stmt, nullptr) != SQLITE_OK) {
+		std::cerr << "Ошибка подготовки запроса: " << sqlite3_errmsg(db) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void MessageStore::load_cache() {
+	sqlite3_stmt* count_stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM message;", -1, &count_stmt, nullptr) == SQLITE_OK) {
+		if (sqlite3_step(count_stmt) == SQLITE_ROW) total = sqlite3_column_int64(count_stmt, 0);
+	}
+	sqlite3_finalize(count_stmt);
+
+	sqlite3_bind_int64(last_stmt, 1, (sqlite3_int64)cache_size);
+	while (sqlite3_step(last_stmt) == SQLITE_ROW) {
+		const char* text = reinterpret_cast<const char*>(sqlite3_column_text(last_stmt, 0));
+		cache.push_front({text ? text : "", sqlite3_column_int(last_stmt, 1)});
+	}
+	sqlite3_reset(last_stmt);
+}
+
+void MessageStore::remember(std::string text, int type) {
+	cache.push_back({std::move(text), type});
+	if (cache.size() > cache_size) cache.pop_front();
+}
+
+void MessageStore::append_formatted(std::string& out, const std::string& text, int type) {
+	if (!out.empty()) out += ", ";
+	out += (type == USER) ? "user" : "system";
+	out += ": ";
+	out += text;
+}
+
+int MessageStore::insert_text(const std::string& text, int type) {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (!db) return -1;
+
+	sqlite3_bind_text(insert_stmt, 1, text.data(), (int)text.size(), SQLITE_STATIC);
+	sqlite3_bind_int(insert_stmt, 2, type);
+	const int result = sqlite3_step(insert_stmt);
+	sqlite3_reset(insert_stmt);
+	sqlite3_clear_bindings(insert_stmt);
+
+	if (result != SQLITE_DONE) {
+		std::cerr << "Ошибка вставки сообщения: " << sqlite3_errmsg(db) << std::endl;
+		return -1;
+	}
+
+	++total;
+	remember(text, type);
+	return 0;
+}
+
+std::string MessageStore::get_lastN(int count) {
+	std::lock_guard<std::mutex> lock(mtx);
+	std::string result;
+	if (count <= 0) return result;
+
+	const size_t n = (size_t)count;
+	// Всё нужное есть в буфере (или в таблице меньше сообщений, чем в буфере)
+	if (n <= cache.size() || cache.size() == total) {
+		const size_t from = cache.size() - std::min(n, cache.size());
+		for (size_t i = from; i < cache.size(); ++i) {
+			append_formatted(result, cache[i].text, cache[i].type);
+		}
+		return result;
+	}
+
+	// Окно больше буфера — читаем из базы
+	if (!db) return result;
+	std::vector<Message> rows;
+	sqlite3_bind_int(last_stmt, 1, count);
+	while (sqlite3_step(last_stmt) == SQLITE_ROW) {
+		const char* text = reinterpret_cast<const char*>(sqlite3_column_text(last_stmt, 0));
+		rows.push_back({text ? text : "", sqlite3_column_int(last_stmt, 1)});
+	}
+	sqlite3_reset(last_stmt);
+
+	for (auto it = rows.rbegin(); it != rows.rend(); ++it) {
+		append_formatted(result, it->text, it->type);
+	}
+	return result;
+}
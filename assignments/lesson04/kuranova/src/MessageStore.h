@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <mutex>
+#include <sqlite3.h>
+
+// Хранилище переписки (таблица message).
+// Все обращения к базе идут через одно соединение под внутренним мьютексом,
+// запросы подготовлены заранее, а последние сообщения лежат в кольцевом буфере,
+// поэтому get_lastN() для обычного окна в 20 сообщений не ходит на диск.
+class MessageStore {
+public:
+	enum Type { SYSTEM = 0, USER = 1 };
+
+	explicit MessageStore(const std::string& path = "my_db.db", size_t cache_size = 64);
+	~MessageStore();
+
+	MessageStore(const MessageStore&) = delete;
+	MessageStore& operator=(const MessageStore&) = delete;
+
+	bool is_open() const { return db != nullptr; }
+
+	// Записать сообщение; возвращает 0 или -1 при ошибке (как раньше в BD)
+	int insert_text(const std::string& text, int type);
+
+	// Последние count сообщений в виде "user: ..., system: ..."
+	std::string get_lastN(int count);
+
+private:
+	struct Message {
+		std::string text;
+		int type;
+	};
+
+	bool prepare();
+	void load_cache();
+	void remember(std::string text, int type);
+	static void append_formatted(std::string& out, const std::string& text, int type);
+
+	sqlite3* db = nullptr;
+	sqlite3_stmt* insert_stmt = nullptr;
+	sqlite3_stmt* last_stmt = nullptr;
+
+	std::mutex mtx;
+	std::deque<Message> cache;  // последние cache_size сообщений, старые в начале
+	size_t cache_size;
+	size_t total = 0;           // сколько всего сообщений в таблице
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <thread>
+#include <utility>
+#include <semaphore.h>
+
+// Очередь «много писателей — один читатель» без блокировок (схема Вьюкова).
+//
+// push() — одна атомарная замена головы и sem_post, писатель никогда не
+// ждёт ни читателя, ни других писателей. Читатель спит в pop() на семафоре,
+// пока очередь пуста. Счётчик семафора равен числу элементов, поэтому
+// после sem_wait элемент точно есть; если писатель ещё не успел связать
+// узел (окно между exchange и store), pop() дожидается его через yield.
+//
+// try_pop()/pop() можно вызывать только из одного потока.
+template <class T>
+class MpscQueue {
+public:
+	MpscQueue() {
+		head.store(&stub, std::memory_order_relaxed);
+		tail = &stub;
+		sem_init(&ready, 0, 0);
+	}
+
+	~MpscQueue() {
+		T value;
+		while (try_pop(value)) {}
+		if (tail != &stub) delete tail;
+		sem_destroy(&ready);
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void push(T value) {
+		Node * node = new Node;
+		node->value = std::move(value);
+		Node * prev = head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+		sem_post(&ready);
+	}
+
+	bool try_pop(T& out) {
+		Node * next = tail->next.load(std::memory_order_acquire);
+		if (!next) return false;
+		// next становится новой заглушкой, его значение забираем
+		out = std::move(next->value);
+		if (tail != &stub) delete tail;
+		tail = next;
+		return true;
+	}
+
+	// Дождаться элемента
+	void pop(T& out) {
+		while (sem_wait(&ready) != 0 && errno == EINTR) {}
+		while (!try_pop(out)) std::this_thread::yield();
+	}
+
+private:
+	struct Node {
+		T value{};
+		std::atomic<Node *> next{nullptr};
+	};
+
+	Node stub;
+	std::atomic<Node *> head;
+	Node * tail;   // трогает только читатель
+	sem_t ready;
+};
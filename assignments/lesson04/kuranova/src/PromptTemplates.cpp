@@ -0,0 +1,91 @@
+#include "PromptTemplates.h"
+#include <fstream>
+#include <sstream>
+#include <nlohmann/json.hpp>
+
+using nlohmann::json;
+
+bool PromptTemplates::load(const std::string& path, std::string* err) {
+	std::ifstream f(path, std::ios::binary);
+	if (!f) { if (err) *err = "Cannot open file: " + path; return false; }
+	std::ostringstream ss; ss << f.rdbuf();
+
+	try {
+		auto j = json::parse(ss.str());
+		start    = j.at("start").get<std::string>();
+		start1   = j.value("start1", std::string());
+		remember = j.at("remember").get<std::string>();
+		is_end   = j.at("is_end").get<std::string>();
+		work1    = j.at("work1").get<std::string>();
+		work2    = j.at("work2").get<std::string>();
+		return true;
+	} catch (const std::exception& e) {
+		if (err) *err = "Templates parse error (" + path + "): " + e.what();
+		return false;
+	}
+}
+
+std::string PromptTemplates::reply(const std::string& history, const std::string& user) const {
+	std::string p;
+	p.reserve(work1.size() + history.size() + work2.size() + user.size());
+	p += work1;
+	p += history;
+	p += work2;
+	p += user;
+	return p;
+}
+
+std::string PromptTemplates::reminder(const std::string& history, long long elapsed, const std::string& unit) const {
+	return remember + history + "| последнее сообщение было " + std::to_string(elapsed) + unit + " назад.";
+}
+
+std::string PromptTemplates::end_check(const std::string& user) const {
+	return user + "|" + is_end;
+}
+
+namespace {
+
+// Нижний регистр для ASCII и русских букв в UTF-8 (А-Я, Ё)
+std::string to_lower_utf8(const std::string& s) {
+	std::string out;
+	out.reserve(s.size());
+	for (size_t i = 0; i < s.size(); ++i) {
+		unsigned char c = s[i];
+		if (c >= 'A' && c <= 'Z') {
+			out += (char)(c - 'A' + 'a');
+		} else if (c == 0xD0 && i + 1 < s.size()) {
+			unsigned char n = s[++i];
+			if (n >= 0x90 && n <= 0x9F) { out += (char)0xD0; out += (char)(n + 0x20); }        // А-П
+			else if (n >= 0xA0 && n <= 0xAF) { out += (char)0xD1; out += (char)(n - 0x20); }   // Р-Я
+			else if (n == 0x81) { out += (char)0xD1; out += (char)0x91; }                      // Ё
+			else { out += (char)c; out += (char)n; }
+		} else {
+			out += (char)c;
+		}
+	}
+	return out;
+}
+
+// Корни слов, с которыми обычно заканчивают разговор
+const char * const end_markers[] = {
+	"пока", "выход", "выйти", "выйд", "хватит", "законч", "заверш", "стоп",
+	"до свидан", "до встречи", "прощай", "всё на сегодня", "все на сегодня",
+	"больше не нужн", "спасибо, это вс", "bye", "exit", "quit", "stop",
+};
+
+}
+
+bool may_end_dialog(const std::string& user) {
+	const std::string text = to_lower_utf8(user);
+	for (const char * marker : end_markers) {
+		if (text.find(marker) != std::string::npos) return true;
+	}
+	return false;
+}
+
+bool dump_prompt(const std::string& path, const std::string& prompt, std::string* err) {
+	std::ofstream f(path);
+	if (!f) { if (err) *err = "Cannot write file: " + path; return false; }
+	f << json{{"prompt", prompt}}.dump(4);
+	return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+
+// Шаблоны промптов из text.json.
+// Файл разбирается один раз при старте, дальше промпты собираются в памяти
+// и уходят агенту в AiRequest через execute() — без записи prompt.json и
+// повторного json::parse на каждое сообщение.
+struct PromptTemplates {
+	std::string start;     // приветствие
+	std::string start1;    // составление плана
+	std::string remember;  // напоминание, когда пользователь долго молчит
+	std::string is_end;    // проверка, хочет ли пользователь закончить
+	std::string work1;     // перед историей переписки
+	std::string work2;     // между историей и новым сообщением
+
+	// Прочитать text.json; false и описание в err, если файла или ключа нет
+	bool load(const std::string& path, std::string* err = nullptr);
+
+	// Обычный ход: история + новое сообщение пользователя
+	std::string reply(const std::string& history, const std::string& user) const;
+	// Напоминание: история + сколько прошло с последнего сообщения
+	std::string reminder(const std::string& history, long long elapsed, const std::string& unit) const;
+	// Проверка на выход: ответ модели — 1 или 0
+	std::string end_check(const std::string& user) const;
+};
+
+// Дешёвая локальная проверка перед end_check: false, если в сообщении нет
+// ни одного слова-признака прощания/выхода и спрашивать модель незачем
+bool may_end_dialog(const std::string& user);
+
+// Отладочная копия промпта в виде {"prompt": "..."} (как раньше prompt.json)
+bool dump_prompt(const std::string& path, const std::string& prompt, std::string* err = nullptr);
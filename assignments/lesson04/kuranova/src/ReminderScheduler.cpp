@@ -0,0 +1,87 @@
+#include "ReminderScheduler.h"
+
+ReminderScheduler::ReminderScheduler(Callback on_fire) : on_fire(std::move(on_fire)) {}
+
+ReminderScheduler::~ReminderScheduler() {
+	stop();
+}
+
+void ReminderScheduler::start() {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (worker.joinable()) return;
+	stopping = false;
+	worker = std::thread(&ReminderScheduler::run, this);
+}
+
+void ReminderScheduler::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	cv.notify_all();
+	if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) worker.join();
+}
+
+void ReminderScheduler::touch(const std::string& conversation, Clock::duration interval) {
+	const auto now = Clock::now();
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		Conversation& c = conversations[conversation];
+		c.interval = interval;
+		c.last_activity = now;
+		c.generation = next_generation++;
+		deadlines.push({now + interval, c.generation, conversation});
+	}
+	// Новый дедлайн может оказаться раньше того, до которого спит поток
+	cv.notify_one();
+}
+
+void ReminderScheduler::cancel(const std::string& conversation) {
+	std::lock_guard<std::mutex> lock(mtx);
+	conversations.erase(conversation);
+}
+
+size_t ReminderScheduler::size() {
+	std::lock_guard<std::mutex> lock(mtx);
+	return conversations.size();
+}
+
+void ReminderScheduler::run() {
+	std::unique_lock<std::mutex> lock(mtx);
+	while (!stopping) {
+		if (deadlines.empty()) {
+			cv.wait(lock, [this] { return stopping || !deadlines.empty(); });
+			continue;
+		}
+
+		const Deadline next = deadlines.top();
+		auto it = conversations.find(next.conversation);
+		if (it == conversations.end() || it->second.generation != next.generation) {
+			deadlines.pop();  // беседу сбросили или отменили
+			continue;
+		}
+		if (Clock::now() < next.at) {
+			// Проснёмся по дедлайну, по stop() или по более раннему touch()
+			cv.wait_until(lock, next.at);
+			continue;
+		}
+		deadlines.pop();
+
+		const auto now = Clock::now();
+		const auto idle = now - it->second.last_activity;
+		const uint64_t generation = it->second.generation;
+
+		// Колбэк может надолго уйти в сеть — без нашего мьютекса
+		lock.unlock();
+		on_fire(next.conversation, idle);
+		lock.lock();
+
+		// Пока шёл колбэк, пользователь мог написать — тогда touch() уже
+		// поставил новый дедлайн
+		it = conversations.find(next.conversation);
+		if (it != conversations.end() && it->second.generation == generation) {
+			it->second.generation = next_generation++;
+			deadlines.push({now + it->second.interval, it->second.generation, next.conversation});
+		}
+	}
+}
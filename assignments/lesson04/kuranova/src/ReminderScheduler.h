@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+// Напоминания по беседам без опроса по таймеру.
+//
+// У каждой беседы свой дедлайн: touch() (новое сообщение пользователя)
+// сдвигает его на interval вперёд. Поток планировщика спит на условной
+// переменной ровно до ближайшего дедлайна, а если бесед нет — до
+// следующего touch(), так что в простое он не просыпается вовсе.
+// Сработавшее напоминание взводится снова через тот же interval, пока
+// пользователь молчит.
+//
+// Дедлайны лежат в куче; устаревшие записи (после touch/cancel) не
+// удаляются из неё сразу, а пропускаются по номеру поколения.
+class ReminderScheduler {
+public:
+	using Clock = std::chrono::steady_clock;
+	// conversation — id беседы, idle — сколько прошло с последнего touch()
+	using Callback = std::function<void(const std::string& conversation, Clock::duration idle)>;
+
+	explicit ReminderScheduler(Callback on_fire);
+	~ReminderScheduler();
+
+	ReminderScheduler(const ReminderScheduler&) = delete;
+	ReminderScheduler& operator=(const ReminderScheduler&) = delete;
+
+	void start();
+	// Остановить поток; уже начатый вызов on_fire дорабатывает
+	void stop();
+
+	// Пользователь активен: напомнить через interval, если он замолчит
+	void touch(const std::string& conversation, Clock::duration interval);
+	// Больше не напоминать этой беседе
+	void cancel(const std::string& conversation);
+
+	size_t size();
+
+private:
+	struct Conversation {
+		Clock::duration interval;
+		Clock::time_point last_activity;
+		uint64_t generation = 0;
+	};
+
+	struct Deadline {
+		Clock::time_point at;
+		uint64_t generation;
+		std::string conversation;
+		bool operator>(const Deadline& o) const { return at > o.at; }
+	};
+
+	void run();
+
+	Callback on_fire;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::unordered_map<std::string, Conversation> conversations;
+	std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+	uint64_t next_generation = 1;
+	bool stopping = false;
+	std::thread worker;
+};
@@ -1,358 +1,247 @@
 
 #include "AiAgent.h"
+#include "MessageStore.h"
+#include "PromptTemplates.h"
+#include "ReminderScheduler.h"
+#include "MpscQueue.h"
 #include <iostream>
 #include <fstream>
-#include <queue>   
 #include <unistd.h>
-#include <sys/syscall.h>
-#include <sys/types.h>
-#include <sqlite3.h>
+#include <poll.h>
 #include <chrono>
 #include <thread>
-
-using nlohmann::json;
+#include <atomic>
+#include <future>
+#include <vector>
+#include <algorithm>
 
 using std::string;
 using std::endl;
 
-int open_file(string path, string * err, string *data) {
-	std::ifstream f(path, std::ios::binary);
-    //std::cout << path;
-    if (!f) { if (err) *err = "Cannot open file: " + path; return false; }
-    std::ostringstream ss; ss << f.rdbuf();
-    *data = std::move(ss).str();
-    f.close();
-    return true;
-	
-	}
-	
-	
-class BD {
-	sqlite3* db;
-	char* err;
-	public:
-	BD() { //string bd_path) {
-
-		int result = sqlite3_open("my_db.db", &db);  // Поменять потом !!!!
-		    // Создание таблицы
-		const char* createTableSQL = 
-			"CREATE TABLE IF NOT EXISTS message ("
-			"id INTEGER PRIMARY KEY AUTOINCREMENT,"
-			"message_text TEXT NOT NULL,"
-			"date DATETIME DEFAULT CURRENT_TIMESTAMP,"
-			"user INTEGER DEFAULT 0,"
-			"type INTEGER CHECK (type IN (0, 1)) DEFAULT 0"
-			");";
-		
-		result = sqlite3_exec(db, createTableSQL, nullptr, nullptr, &err);
-		
-		if (result != SQLITE_OK) {
-			std::cerr << "Ошибка создания таблицы: " << err << std::endl;
-			sqlite3_free(err);
-		} else {
-			//std::cout << "Таблица 'message' создана успешно!" << std::endl;
-		}
-	}
-    
-		/*if (result != SQLITE_OK) {
-			*err =  "Не удалось открыть базу данных";
-		}*/
-		
-	~BD() {
-		sqlite3_close(db);
-		}
-		
-	int insert_text(string data, int tp) {
-		string q = 
-        "INSERT INTO message (message_text, type) VALUES ('" + data + "', " + std::to_string(tp) + ");";
-		
-		int result = sqlite3_exec(db, q.c_str(), nullptr, nullptr, &err);
-		if (result != SQLITE_OK) {
-			std::cerr << "Ошибка вставки сообщения" << err << std::endl;
-			sqlite3_free(err);
-        return -1;
-		} 
-		//else {
-			//std::cout << "Сообщние записано" << std::endl;
-		//}
-		return 0;
-	}
-	static int callback(void* data, int argc, char ** argv, char ** colName) {
-		string* result = static_cast<string*>(data);
-		string type = (string(argv[4]) == "1") ? "user" : "system";
-		string message = argv[1];
-		
-		if (!result->empty()) *result += ", ";
-		*result += type + ": " + message;
-		
-		return 0;
-	}
-	string get_lastN(int count) {
-		string result;
-		string sql = "SELECT * FROM ("
-					" SELECT * FROM message ORDER BY id DESC LIMIT " + std::to_string(count) +
-					" ) AS last_m" 
-					" ORDER BY id ASC;";
-		sqlite3_exec(db, sql.c_str(), callback, &result, NULL);
-		
-		// std::cout << "===========================================================================================================================================" +  result << std::endl;
-
-		return result;
-	}
-};
-	
-	
+string text_path = "../text.json", prompt_path = "../prompt.json";
+PromptTemplates templates;   // text.json, разобранный один раз при старте
+bool debug_dump = false;     // --dump-prompt: сохранять каждый промпт в prompt.json
 
-pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t db_mtx = PTHREAD_MUTEX_INITIALIZER;
 
-pthread_cond_t cv_in  = PTHREAD_COND_INITIALIZER;
-pthread_cond_t cv_out  = PTHREAD_COND_INITIALIZER;
-string text_path = "../text.json", prompt_path = "../prompt.json";
-string err, data;
+// Конвейер: ввод с stdin и планировщик кладут события в очередь, один
+// исполнитель владеет AiAgent и MessageStore и делает запросы к модели,
+// ответы печатает отдельный поток вывода. Ни один этап не держит
+// блокировку во время сетевого запроса: очереди без блокировок, у каждого
+// этапа свои данные.
+struct Event {
+	enum Kind { USER_MESSAGE, REMINDER, END_VERDICT, STOP };
+	Kind kind = STOP;
+	string conversation;
+	string text;                                   // USER_MESSAGE; END_VERDICT: "1" — закончить
+	std::chrono::steady_clock::duration idle{};    // REMINDER
+	};
 
+struct Output {
+	string text;
+	bool is_error = false;
+	bool stop = false;
+	};
 
 struct Param {
-	int * is_exit;
-	bool * is_input;
-	std::chrono::time_point<std::chrono::steady_clock> * last_time;
-	int * time;
+	string conversation;           // id беседы в планировщике
+	ReminderScheduler * scheduler;
+	int time;
 	int type;
-    AiAgent * agent;
-    BD * db;
-    pthread_mutex_t * mtx;
+    const AiAgent * agent;         // execute() потокобезопасен
+    MessageStore * db;             // только у исполнителя
+	MpscQueue<Event> * events;
+	MpscQueue<Output> * output;
+	int stop_fd[2];                // будит поток ввода при выходе
+	std::atomic<bool> stopping{false};
 	};
 
 
-/*
-void in_func(void * par){
-	struct Param * param = (struct Param *)par;
-	while (!param->is_exit){
-		pthread_mutex_lock(param->mtx);
-		while(!param->is_input){
-			pthread_cond_signal(&cv_in);
-			pthread_cond_wait(&cv_out, param->mtx);
-			
-			}
-		
-		pthread_cond_signal(&cv_in);
-		pthread_mutex_unlock(param->mtx);
+// prompt.json пишется только для отладки
+void dump_if_debug(const string& prompt) {
+	string dump_err;
+	if (debug_dump && !dump_prompt(prompt_path, prompt, &dump_err)) {
+		std::cerr << "Prompt dump error: " << dump_err << "\n";
 	}
 }
-	*/
-	
 
-void remember(string tp, int time, string last_str) {
-	json new_j;
-	auto j = json::parse(data);
-    string work1 = j.at("remember").get<std::string>();
-    
-    new_j["prompt"] = work1 + last_str + "| последнее сообщение было " + std::to_string(time) + tp + " назад.";
-    std::ofstream f(prompt_path);
-    f << new_j.dump(4);
-    f.close();
-	
+// Промпт едет в самом запросе — агент не меняется
+AiRequest make_request(const string& prompt) {
+	dump_if_debug(prompt);
+	return AiRequest(prompt);
+}
+
+AiRequest remember(string tp, long long time, const string& last_str) {
+	return make_request(templates.reminder(last_str, time, tp));
 	}
 
-void * out_f(void * par){
-	struct Param * param = (struct Param *)par;
-    
-	while (*(param->is_exit) != 1){
-        auto currentTime = std::chrono::steady_clock::now();
-        auto lastTime = *(param->last_time);
-        auto elapsed_h = std::chrono::duration_cast<std::chrono::hours>(currentTime - lastTime);
-		auto elapsed_m = std::chrono::duration_cast<std::chrono::minutes>(currentTime - lastTime);
-        auto elapsed_s = std::chrono::duration_cast<std::chrono::seconds>(currentTime - lastTime);
-
-		if ((param->type == 0) and (elapsed_h.count() >= *(param->time))) {
-			pthread_mutex_lock(param->mtx);
-			//std::cout << "№№№№№№№№№№№№№№DEADLOCK" << endl;
-			string last_message = (*(param->db)).get_lastN(20);
-			remember("часов", elapsed_h.count(), last_message);
-			if (!(*(param->agent)).loadPrompt(prompt_path, &err)) {
-				std::cerr << "Prompt error: " << err << "\n";
-				return 0;
-			}
-			auto resp = (*(param->agent)).ask(&err);
-			if (!resp) {
-				std::cerr << "Request failed: " << err << "\n";
-				return 0;
-			}
-			std::cout << endl << "<system>" << *resp << endl;
-			
-			*(param ->last_time) = currentTime;
-			//pthread_mutex_lock(&db_mtx);
-			(*(param->db)).insert_text(*resp, 1);
-			//pthread_mutex_unlock(&db_mtx);
-			pthread_mutex_unlock(param->mtx);
-				
-			fflush(stdout);
-		} else if ((param->type == 1) and (elapsed_m.count() >= *(param->time))) {
-			pthread_mutex_lock(param->mtx);
-			string last_message = (*(param->db)).get_lastN(20);
-			remember("минут", elapsed_m.count(), last_message);
-			if (!(*(param->agent)).loadPrompt(prompt_path, &err)) {
-				std::cerr << "Prompt error: " << err << "\n";
-				return 0;
-			}
-			auto resp = (*(param->agent)).ask(&err);
-			if (!resp) {
-				std::cerr << "Request failed: " << err << "\n";
-				return 0;
-			}
-			std::cout << endl << "<system>" << *resp << endl;
-			
-			*(param ->last_time) = currentTime;
-			//std::cout << "+++++++++++++++++++++++++++++++DEADLOCK" << endl;
-			pthread_mutex_lock(&db_mtx);
-			//std::cout << "______________________________+++++++++++++++++++++++++++++++DEADLOCK" << endl;
-			(*(param->db)).insert_text(*resp, 1);
-			pthread_mutex_unlock(&db_mtx);
-			pthread_mutex_unlock(param->mtx);
-			std::cout << "end!!!" << endl;
-			fflush(stdout);
-		} else if ((param->type > 1) and (elapsed_s.count() >= *(param->time))) {
-			pthread_mutex_lock(param->mtx);
-			//std::cout << ";;;;;;;;;;;;;;;;;;;;DEADLOCK" << endl;
-			string last_message = (*(param->db)).get_lastN(20);
-
-			remember("секунд", elapsed_h.count(), last_message);
-			if (!(*(param->agent)).loadPrompt(prompt_path, &err)) {
-				std::cerr << "Prompt error: " << err << "\n";
-				return 0;
-			}
-			auto resp = (*(param->agent)).ask(&err);
-			if (!resp) {
-				std::cerr << "Request failed: " << err << "\n";
-				return 0;
-			}
-			std::cout << endl << "<system>" << *resp << endl;
-			
-			*(param ->last_time) = currentTime;
-			pthread_mutex_lock(&db_mtx);
-			(*(param->db)).insert_text(*resp, 1);
-			pthread_mutex_unlock(&db_mtx);
-			pthread_mutex_unlock(param->mtx);
-				
-			fflush(stdout);
-		}
-	
-        std::this_thread::sleep_for(std::chrono::seconds(15));
-        //std::cout << "type: " << (param->type == 1) << " exit " << *(param->is_exit) << " " << (elapsed_m.count() >= *(param->time)) << " " << elapsed_m.count() << (*(param->time)) <<endl;
-		fflush(stdout);
-    }
-    
-    return 0;
-}
+// Единица напоминаний: type 0 — часы, 1 — минуты, иначе секунды
+struct ReminderUnit {
+	const char * name;
+	std::chrono::seconds length;
+	};
 
-void write_prompt(string cur_str, string last = ""){
-	json new_j;
-	auto j = json::parse(data);
-    string work1 = j.at("work1").get<std::string>();
-    string work2 = j.at("work1").get<std::string>();
-    
-    new_j["prompt"] = work1 + last + work2 + cur_str;
-    std::ofstream f(prompt_path);
-    f << new_j.dump(4);
-    f.close();
+ReminderUnit reminder_unit(int type) {
+	if (type == 0) return {"часов", std::chrono::hours(1)};
+	if (type == 1) return {"минут", std::chrono::minutes(1)};
+	return {"секунд", std::chrono::seconds(1)};
+	}
+
+std::chrono::seconds reminder_interval(struct Param * param) {
+	return reminder_unit(param->type).length * param->time;
+	}
+
+AiRequest write_prompt(const string& cur_str, const string& last = ""){
+	return make_request(templates.reply(last, cur_str));
 	}
 	
 	
-void is_end(string cur_str) {
-	json new_j;
-	auto j = json::parse(data);
-    string work1 = j.at("is_end").get<std::string>();
-    new_j["prompt"] = cur_str + "|" + work1;
-    std::ofstream f(prompt_path);
-    f << new_j.dump(4);
-    f.close();
+// Проверка «пользователь хочет закончить?» идёт параллельно с ответом и
+// приходит исполнителю отдельным событием END_VERDICT, так что
+// отрицательный вердикт ничего не задерживает. Сообщения без признаков
+// прощания (may_end_dialog) модели вообще не отправляются.
+void start_end_check(struct Param * param, const string& user_answer, std::vector<std::future<void>>& checks) {
+	if (!may_end_dialog(user_answer)) return;
+
+	AiRequest req = make_request(templates.end_check(user_answer));
+
+	checks.erase(std::remove_if(checks.begin(), checks.end(), [](std::future<void>& f) {
+		return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), checks.end());
+
+	checks.push_back(std::async(std::launch::async, [param, req] {
+		string ask_err;
+		auto resp = param->agent->execute(req, &ask_err);
+		Event e;
+		e.kind = Event::END_VERDICT;
+		e.conversation = param->conversation;
+		// Ошибка проверки — не повод обрывать разговор
+		e.text = (resp && atoi(resp->c_str()) == 1) ? "1" : "0";
+		param->events->push(std::move(e));
+	}));
+}
+
+
+// Запрос к модели; ответ или ошибка уходят на вывод
+std::optional<string> ask_and_report(struct Param * param, const AiRequest& req) {
+	string ask_err;
+	auto resp = param->agent->execute(req, &ask_err);
+	if (!resp) param->output->push({"Request failed: " + ask_err, true});
+	return resp;
+}
+
+// Вызывается исполнителем, когда пользователь молчит дольше интервала
+void remind(struct Param * param, std::chrono::steady_clock::duration idle) {
+	ReminderUnit unit = reminder_unit(param->type);
+	string last_message = param->db->get_lastN(20);
+	if (auto resp = ask_and_report(param, remember(unit.name, idle / unit.length, last_message))) {
+		param->db->insert_text(*resp, MessageStore::SYSTEM);
+		param->output->push({*resp});
 	}
+}
+
+// Сообщение пользователя; false — запрос не удался
+bool reply(struct Param * param, const string& user_answer) {
+	string last_message = param->db->get_lastN(20);
+	param->db->insert_text(user_answer, MessageStore::USER);
+	auto resp = ask_and_report(param, write_prompt(user_answer, last_message));
+	if (!resp) return false;
+	param->db->insert_text(*resp, MessageStore::SYSTEM);
+	param->output->push({*resp});
+	return true;
+}
 
+void request_stop(struct Param * param) {
+	if (param->stopping.exchange(true)) return;
+	char c = 0;
+	(void)!write(param->stop_fd[1], &c, 1);
+}
 
 
-void * func(void * par){
+// Поток ввода: строки stdin -> события. poll() вместо getline, чтобы
+// исполнитель мог разбудить поток при выходе
+void * input_f(void * par){
 	struct Param * param = (struct Param *)par;
-	auto currentTime = std::chrono::steady_clock::now();
-    AiAgent * agent = param->agent;
-    int is_exit = 0;
-    
-	pthread_mutex_lock(param->mtx);
-	*(param->is_exit) = is_exit;
-	*(param->last_time) = currentTime;
-	pthread_mutex_unlock(param->mtx);
-    
-    string user_answer;
-    string last_message;
-    
-    std::cout << "<user> ";
-    std::getline(std::cin, user_answer);
-       
-    
-    while (is_exit != 1) {
-		
-		pthread_mutex_lock(param->mtx);
-		pthread_mutex_lock(&db_mtx);
-		last_message = (*(param->db)).get_lastN(20);
-		(*(param->db)).insert_text(user_answer, 1);
-		pthread_mutex_unlock(&db_mtx);
-		write_prompt(user_answer, last_message);
-		if (!(*agent).loadPrompt(prompt_path, &err)) {
-			std::cerr << "Prompt error: " << err << "\n";
-			return 0;
-		}
-		auto resp = (*agent).ask(&err);
-		if (!resp) {
-			std::cerr << "Request failed: " << err << "\n";
-			return 0;
-		}
-	    std::cout << endl << "<system>" << *resp << endl;
-	    
-		//pthread_mutex_lock(&db_mtx);
-		(*(param->db)).insert_text(*resp, 1);
-		//pthread_mutex_unlock(&db_mtx);
-		
-		//std::cout << "-------------test" << endl << endl << endl;
-		fflush(stdout);
-		pthread_mutex_unlock(param->mtx);
-		
-		
-		std::cout << "<user> ";
-		std::getline(std::cin, user_answer);
-		//std::cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!test" << endl << endl << endl;
-		
-		pthread_mutex_lock(param->mtx);
-		currentTime = std::chrono::steady_clock::now();
-		*(param->last_time) = currentTime;
-		is_end(user_answer);
-		if (!(*agent).loadPrompt(prompt_path, &err)) {
-			std::cerr << "Prompt error: " << err << "\n";
-			return 0;
+	string buffer;
+	char chunk[4096];
+
+	while (!param->stopping) {
+		struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {param->stop_fd[0], POLLIN, 0}};
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) continue;
+			break;
 		}
-		resp = (*agent).ask(&err);
-		if (!resp) {
-			std::cerr << "Request failed: " << err << "\n";
-			return 0;
+		if (fds[1].revents) break;
+
+		ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;   // EOF — выходим
+		buffer.append(chunk, n);
+
+		size_t pos;
+		while ((pos = buffer.find('\n')) != string::npos) {
+			Event e;
+			e.kind = Event::USER_MESSAGE;
+			e.conversation = param->conversation;
+			e.text = buffer.substr(0, pos);
+			buffer.erase(0, pos + 1);
+			// Пользователь ответил — отсчёт до напоминания начинается заново
+			param->scheduler->touch(param->conversation, reminder_interval(param));
+			param->events->push(std::move(e));
 		}
-		//std::cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!test" << endl << endl << endl;
-		is_exit = atoi((*resp).c_str());
-		*(param->is_exit) = is_exit;
-		pthread_mutex_unlock(param->mtx);
 	}
 
-	*(param->is_exit) = 1;
-	fflush(stdout);
+	param->events->push(Event{});   // STOP
 	return 0;
 }
 
+// Поток вывода: печать не задерживает ни ввод, ни запросы
+void * output_f(void * par){
+	struct Param * param = (struct Param *)par;
+	Output out;
+	while (true) {
+		param->output->pop(out);
+		if (out.stop) break;
+		if (out.is_error) {
+			std::cerr << out.text << "\n";
+		} else {
+			std::cout << endl << "<system>" << out.text << endl;
+		}
+		std::cout << "<user> ";
+		fflush(stdout);
+	}
+	return 0;
+}
+
+// Исполнитель: единственный владелец AiAgent и MessageStore
+void executor(struct Param * param) {
+	bool first = true;
+	std::vector<std::future<void>> checks;   // идущие проверки конца диалога
+	Event e;
+	while (true) {
+		param->events->pop(e);
+		if (e.kind == Event::STOP) break;
+		if (param->stopping) continue;
+
+		if (e.kind == Event::REMINDER) {
+			remind(param, e.idle);
+		} else if (e.kind == Event::END_VERDICT) {
+			if (e.text == "1") request_stop(param);
+		} else {
+			// Первое сообщение — ответ на приветствие, его не проверяем
+			if (!first) start_end_check(param, e.text, checks);
+			if (!reply(param, e.text)) request_stop(param);
+			first = false;
+		}
+	}
+}
+
 
 
 int main(int argc, char **argv)
 {
     AiAgent agent;
-	string cur_str;
-	BD db;
-	
-	bool is_input = false;
+	MessageStore db;
+	string err;
 	
     if (!agent.loadConfig("../config.json", &err)) {
         std::cerr << "Config error: " << err << "\n";
@@ -360,59 +249,68 @@ int main(int argc, char **argv)
     }
 
 	
-	if (!open_file(text_path, &err, &data)) {
+	for (int i = 1; i < argc; ++i) {
+		if (string(argv[i]) == "--dump-prompt") debug_dump = true;
+	}
+
+	if (!templates.load(text_path, &err)) {
 		std::cout << err;
 		return 0;
 		}
 
-	auto j = json::parse(data);
-    cur_str = j.at("start").get<std::string>();
-    json new_j;
-    new_j["prompt"] = cur_str;
-    std::ofstream f(prompt_path);
-    f << new_j.dump(4);
-    f.close();
-    
-   // std::cout << "!!!" << endl;
-    
-    
-	if (!agent.loadPrompt(prompt_path, &err)) {
-		std::cerr << "Prompt error: " << err << "\n";
-		return 1;
-    }
-    auto resp = agent.ask(&err);
+    auto resp = agent.execute(make_request(templates.start), &err);
     if (!resp) {
         std::cerr << "Request failed: " << err << "\n";
         return 2;
     }
 	
-	db.insert_text(*resp, 0);
+	db.insert_text(*resp, MessageStore::SYSTEM);
     std::cout << "<system>" << *resp << "\n";
+    std::cout << "<user> ";
+    fflush(stdout);
     
-    pthread_t in_th, out_th;
-    
-    int ex = 0;
-    auto currentTime = std::chrono::steady_clock::now();
-    int tim = 2;
+    MpscQueue<Event> events;
+    MpscQueue<Output> output;
     struct Param m;
-    m.is_exit = &ex;
     m.type = 1;
-    m.last_time = &currentTime;
-    m.time = &tim;
+    m.time = 2;
+    m.conversation = "default";
     m.agent = &agent;
     m.db = &db;
-    m.mtx = &mtx;
-    
-    
-	pthread_create(&in_th, NULL, func, &m);
-	pthread_create(&out_th, NULL, out_f, &m);
-    
+    m.events = &events;
+    m.output = &output;
+    if (pipe(m.stop_fd) != 0) {
+        std::cerr << "pipe failed\n";
+        return 1;
+    }
     
-	pthread_join(in_th, NULL);	
-	pthread_join(out_th, NULL);	
+    // Планировщик только кладёт событие в очередь — запрос сделает исполнитель
+    ReminderScheduler scheduler([&m](const string& conversation, ReminderScheduler::Clock::duration idle) {
+		Event e;
+		e.kind = Event::REMINDER;
+		e.conversation = conversation;
+		e.idle = idle;
+		m.events->push(std::move(e));
+	});
+    m.scheduler = &scheduler;
+    scheduler.touch(m.conversation, reminder_interval(&m));
+    scheduler.start();
     
+    pthread_t in_th, out_th;
+	pthread_create(&in_th, NULL, input_f, &m);
+	pthread_create(&out_th, NULL, output_f, &m);
     
+	executor(&m);
+	
+	request_stop(&m);
+	scheduler.stop();
+	pthread_join(in_th, NULL);
+	Output last;
+	last.stop = true;
+	output.push(last);
+	pthread_join(out_th, NULL);
 	
+	close(m.stop_fd[0]);
+	close(m.stop_fd[1]);
 	return 0;
 }
-
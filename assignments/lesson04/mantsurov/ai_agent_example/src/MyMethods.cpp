@@ -44,15 +44,17 @@ void AiAgent::addMessageToDialog(std::string& message) {
         context_.dialog += "\n";
     }
 
+    // Инструкция (prompt_) + диалог едут в запросе; prompt_ не перезаписываем,
+    // иначе на следующем шаге он вкладывался бы сам в себя
+    AiRequest req;
     try {
-        json full = createFullJson();
-        prompt_ = full.dump();
+        req.prompt = createFullJson().dump();
     } catch (...) {
-        prompt_.clear();
+        req.prompt.clear();
     }
 
     std::string localErr;
-    auto resp = ask(&localErr);
+    auto resp = execute(req, &localErr);
     if (!resp) {
         std::cerr << "Request failed: " << localErr << "\n";
         return;
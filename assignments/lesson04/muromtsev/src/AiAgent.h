@@ -2,6 +2,7 @@
 #include <string>
 #include <optional>
 #include <nlohmann/json.hpp>
+#include "AiRequest.h"
 
 struct AiConfig {
     std::string host;
@@ -10,6 +11,8 @@ struct AiConfig {
     std::optional<std::string> history_path = std::nullopt;
     std::optional<size_t> max_requests = std::nullopt;
     std::optional<size_t> max_history_bytes = std::nullopt;
+    std::optional<std::string> journal_fsync = std::nullopt;   // always / interval / never
+    std::optional<size_t> snapshot_every = std::nullopt;       // записей журнала между снимками
 };
 
 class AiAgent {
@@ -20,8 +23,13 @@ public:
     // Загрузить промпт из JSON-файла (принимает либо строку, либо объект с ключом "prompt")
     bool loadPrompt(const std::string& path, std::string* err = nullptr);
 
-    // Выполнить запрос и вернуть распарсенный "text" из ответа
-    // Возвращает std::nullopt при ошибке (описание в outErr, если передан)
+    // Выполнить запрос и вернуть распарсенный "text" из ответа.
+    // Возвращает std::nullopt при ошибке (описание в outErr, если передан).
+    // Агент не меняется, так что execute() можно вызывать одновременно из
+    // нескольких потоков.
+    std::optional<std::string> execute(const AiRequest& req, std::string* outErr = nullptr) const;
+
+    // execute() с промптом из loadPrompt()/setPrompt()
     std::optional<std::string> ask(std::string* outErr = nullptr) const;
 
     // Явно задать промпт программно (не из файла)
@@ -31,7 +39,8 @@ public:
 protected:
     // ---- низкоуровневые помощники ----
     static std::optional<std::string> httpsPostGenerate(
-        const AiConfig& cfg, const std::string& jsonBody, std::string* err);
+        const AiConfig& cfg, const std::string& jsonBody, std::string* err,
+        const std::atomic<bool>* cancel = nullptr);
 
     // Простой разбор JSON: ожидаем { "text": "<строка>" }
     static std::string extractTextFromJsonBody(const std::string& body);
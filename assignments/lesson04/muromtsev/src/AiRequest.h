@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+
+// Один запрос к модели: промпт, история и отмена.
+// Всё, что нужно для ответа, едет в самом запросе, поэтому
+// AiAgent::execute() не трогает состояние агента — один агент можно
+// звать из нескольких потоков без внешних блокировок.
+struct AiRequest {
+    struct Message {
+        std::string role;      // "system" / "user" / "assistant"
+        std::string content;
+    };
+
+    std::string prompt;             // новое сообщение пользователя
+    std::vector<Message> messages;  // реплики до него; /api/generate берёт
+                                    // одну строку, они склеиваются перед prompt
+
+    // Отмена из любого потока: запрос прерывается при ближайшей проверке,
+    // в том числе пока ждём ответ сервера. Флагом владеет вызывающий.
+    const std::atomic<bool>* cancel = nullptr;
+
+    AiRequest() = default;
+    AiRequest(std::string p) : prompt(std::move(p)) {}
+
+    bool cancelled() const { return cancel && cancel->load(std::memory_order_relaxed); }
+
+    // Промпт одной строкой: история перед сообщением
+    std::string flatPrompt() const {
+        if (messages.empty()) return prompt;
+        std::string out;
+        for (const auto& m : messages) {
+            out += m.role;
+            out += ": ";
+            out += m.content;
+            out += '\n';
+        }
+        out += prompt;
+        return out;
+    }
+};
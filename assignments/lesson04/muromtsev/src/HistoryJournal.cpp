@@ -0,0 +1,236 @@
+#include "HistoryJournal.hpp"
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+bool writeAll(int fd, const std::string &data)
+{
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string sysError(const std::string &what, const std::string &path)
+{
+    return what + " " + path + ": " + std::strerror(errno);
+}
+}
+
+HistoryJournal::HistoryJournal(std::string dir, std::string user, SyncPolicy sync, size_t snapshot_every)
+    : snapshot_path_(dir + "/" + user + ".json"),
+      journal_path_(dir + "/" + user + ".jsonl"),
+      dir_(std::move(dir)),
+      sync_(sync),
+      snapshot_every_(snapshot_every ? snapshot_every : 1)
+{
+}
+
+HistoryJournal::~HistoryJournal()
+{
+    if (fd_ >= 0) {
+        sync();
+        ::close(fd_);
+    }
+}
+
+HistoryJournal::SyncPolicy HistoryJournal::parseSyncPolicy(const std::string &name)
+{
+    if (name == "interval") return SyncPolicy::INTERVAL;
+    if (name == "never") return SyncPolicy::NEVER;
+    return SyncPolicy::ALWAYS;
+}
+
+json HistoryJournal::emptyHistory()
+{
+    return json{{"requests", json::array()}, {"context", ""}};
+}
+
+void HistoryJournal::apply(json &history, const json &record)
+{
+    const std::string op = record.at("op").get<std::string>();
+    if (op == "request") {
+        history["requests"].push_back({record.at("request").get<std::string>(),
+                                       record.at("answer").get<std::string>()});
+    } else if (op == "compression") {
+        history["context"] = record.at("context").get<std::string>();
+        history["requests"] = json::array();
+    }
+}
+
+bool HistoryJournal::openJournal(std::string *err)
+{
+    if (fd_ >= 0) return true;
+    fd_ = ::open(journal_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        if (err) *err = sysError("Cannot open journal", journal_path_);
+        return false;
+    }
+    return true;
+}
+
+bool HistoryJournal::load(json &history, std::string *err)
+{
+    history = emptyHistory();
+    bool found = false;
+    uint64_t snapshot_seq = 0;
+
+    std::ifstream snap(snapshot_path_, std::ios::binary);
+    if (snap) {
+        try {
+            json j = json::parse(snap);
+            if (j.contains("requests")) history["requests"] = j.at("requests");
+            if (j.contains("context")) history["context"] = j.at("context");
+            snapshot_seq = j.value("seq", uint64_t{0});
+            found = true;
+        } catch (const std::exception &e) {
+            if (err) *err = std::string("History parse error: ") + e.what();
+            history = emptyHistory();
+            return false;
+        }
+    }
+    next_seq_ = snapshot_seq + 1;
+
+    // Хвост журнала: всё, что записано после снимка.
+    // Строка, оборванная сбоем, отбрасывается вместе со всем, что за ней
+    std::ifstream journal(journal_path_, std::ios::binary);
+    if (journal) {
+        std::string line;
+        std::streamoff good_end = 0;
+        size_t replayed = 0;
+        bool broken = false;
+        while (std::getline(journal, line)) {
+            if (journal.eof()) {
+                // Последняя строка без '\n' — запись не завершилась
+                if (!line.empty()) broken = true;
+                break;
+            }
+            if (!line.empty()) {
+                try {
+                    const json record = json::parse(line);
+                    const uint64_t seq = record.at("seq").get<uint64_t>();
+                    if (seq > snapshot_seq) {
+                        apply(history, record);
+                        ++replayed;
+                    }
+                    next_seq_ = std::max(next_seq_, seq + 1);
+                } catch (const std::exception &) {
+                    broken = true;
+                    break;
+                }
+            }
+            good_end = journal.tellg();
+        }
+        journal.close();
+
+        if (broken) {
+            std::cerr << "History journal " << journal_path_ << " is damaged after byte " << good_end
+                      << ", dropping the rest" << '\n';
+            if (::truncate(journal_path_.c_str(), good_end) != 0) {
+                std::cerr << sysError("Cannot truncate journal", journal_path_) << '\n';
+            }
+        }
+        records_since_snapshot_ = replayed;
+        found = found || replayed > 0;
+    }
+
+    if (!openJournal(err)) return false;
+    return found;
+}
+
+bool HistoryJournal::append(json record, std::string *err)
+{
+    if (!openJournal(err)) return false;
+    record["seq"] = next_seq_;
+    // Одна запись — одна строка; write с O_APPEND не перемежается с другими
+    if (!writeAll(fd_, record.dump() + '\n')) {
+        if (err) *err = sysError("Cannot write journal", journal_path_);
+        return false;
+    }
+    ++next_seq_;
+    ++records_since_snapshot_;
+    dirty_ = true;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (sync_ == SyncPolicy::ALWAYS ||
+        (sync_ == SyncPolicy::INTERVAL && now - last_sync_ >= std::chrono::seconds(1))) {
+        sync();
+    }
+    return true;
+}
+
+bool HistoryJournal::appendRequest(const std::string &request, const std::string &answer, std::string *err)
+{
+    return append({{"op", "request"}, {"request", request}, {"answer", answer}}, err);
+}
+
+bool HistoryJournal::appendCompression(const std::string &context, std::string *err)
+{
+    return append({{"op", "compression"}, {"context", context}}, err);
+}
+
+void HistoryJournal::sync()
+{
+    if (fd_ < 0 || !dirty_) return;
+    if (::fdatasync(fd_) != 0) {
+        std::cerr << sysError("Cannot sync journal", journal_path_) << '\n';
+        return;
+    }
+    dirty_ = false;
+    last_sync_ = std::chrono::steady_clock::now();
+}
+
+bool HistoryJournal::snapshot(const json &history, std::string *err)
+{
+    json snap = history;
+    snap["seq"] = next_seq_ - 1;
+
+    const std::string tmp_path = snapshot_path_ + ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        if (err) *err = sysError("Cannot create snapshot", tmp_path);
+        return false;
+    }
+    const bool written = writeAll(fd, snap.dump(4)) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!written) {
+        if (err) *err = sysError("Cannot write snapshot", tmp_path);
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    if (std::rename(tmp_path.c_str(), snapshot_path_.c_str()) != 0) {
+        if (err) *err = sysError("Cannot replace snapshot", snapshot_path_);
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    // rename становится постоянным только после fsync каталога
+    const int dir_fd = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+
+    // Всё из журнала уже в снимке (seq <= снимка пропускаются при загрузке),
+    // так что сбой до обнуления ничего не ломает
+    if (fd_ >= 0 && ::ftruncate(fd_, 0) != 0) {
+        std::cerr << sysError("Cannot truncate journal", journal_path_) << '\n';
+    }
+    dirty_ = false;
+    records_since_snapshot_ = 0;
+    return true;
+}
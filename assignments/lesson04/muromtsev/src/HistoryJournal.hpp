@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// История пользователя на диске:
+//   <user>.json  — снимок { "requests": [...], "context": "...", "seq": N };
+//   <user>.jsonl — журнал: по строке JSON на каждое изменение после снимка.
+// Сохранение дописывает одну строку, загрузка читает снимок и хвост журнала.
+// Снимок пишется через tmp + rename, после чего журнал обнуляется,
+// поэтому при сбое теряется не больше недописанной последней строки.
+class HistoryJournal {
+public:
+enum class SyncPolicy {
+    ALWAYS,    // fsync после каждой записи
+    INTERVAL,  // не чаще раза в секунду
+    NEVER      // на усмотрение ОС
+};
+
+HistoryJournal(std::string dir, std::string user,
+               SyncPolicy sync = SyncPolicy::ALWAYS, size_t snapshot_every = 50);
+~HistoryJournal();
+HistoryJournal(const HistoryJournal&) = delete;
+HistoryJournal& operator=(const HistoryJournal&) = delete;
+
+// "always" / "interval" / "never"; неизвестное значение — ALWAYS
+static SyncPolicy parseSyncPolicy(const std::string &name);
+
+// Восстановить историю: снимок + записи журнала после него.
+// false — истории нет (history пустая) или она не читается (см. err)
+bool load(nlohmann::json &history, std::string *err = nullptr);
+
+// Записать пару запрос/ответ
+bool appendRequest(const std::string &request, const std::string &answer, std::string *err = nullptr);
+// Записать сжатие: context заменяет контекст, список запросов очищается
+bool appendCompression(const std::string &context, std::string *err = nullptr);
+
+// Атомарно записать снимок и очистить журнал
+bool snapshot(const nlohmann::json &history, std::string *err = nullptr);
+// Набралось ли в журнале достаточно записей для нового снимка
+bool needsSnapshot() const { return records_since_snapshot_ >= snapshot_every_; }
+bool hasPendingRecords() const { return records_since_snapshot_ > 0; }
+
+// Сбросить журнал на диск независимо от политики
+void sync();
+
+private:
+bool openJournal(std::string *err);
+bool append(nlohmann::json record, std::string *err);
+static void apply(nlohmann::json &history, const nlohmann::json &record);
+static nlohmann::json emptyHistory();
+
+std::string snapshot_path_;
+std::string journal_path_;
+std::string dir_;
+SyncPolicy sync_;
+size_t snapshot_every_;
+
+int fd_ = -1;
+uint64_t next_seq_ = 1;
+size_t records_since_snapshot_ = 0;
+bool dirty_ = false;  // есть записи без fsync
+std::chrono::steady_clock::time_point last_sync_ = std::chrono::steady_clock::now();
+};
@@ -19,41 +19,28 @@ void PM::printInfo()
 }
 bool PM::loadHistory(std::string *err) 
 {
+    history_ = json::parse(R"({ "requests": [], "context": ""})");
     if (!cfg_.history_path.has_value()) return false;
-    std::string s;
-    const std::string full_path = cfg_.history_path.value() + "/" + username_ + ".json";
-    if (!readWholeFile(full_path, s, err)) {
-        std::ofstream histfile {full_path};
-        histfile << R"({ "requests": [], "context": ""})";
-        histfile.close();
-        history_ = json::parse(R"({ "requests": [], "context": ""})");
-        return false;
-    }
-    try {
-        history_ = json::parse(s);
-        return true;
-    } catch (const std::exception& e) {
-        if (err) *err = std::string("History parse error: ") + e.what();
-        history_ = json::parse(R"({ "requests": [], "context": ""})");
-        return false;
-    }
-    return false;
+    journal_ = std::make_unique<HistoryJournal>(cfg_.history_path.value(), username_,
+        HistoryJournal::parseSyncPolicy(cfg_.journal_fsync.value_or("always")),
+        cfg_.snapshot_every.value_or(50));
+    return journal_->load(history_, err);
 }
 
-void PM::determineRequestType(const std::string &request, std::string *err)
+AiRequest PM::determineRequestType(const std::string &request, std::string *err)
 {
-    promptBuilder(request, PM::REQUEST_TYPE::REQUEST_TYPE_DETERMINATION, err);
-    auto resp = ask(err);
+    auto resp = execute(AiRequest(promptBuilder(request, PM::REQUEST_TYPE::REQUEST_TYPE_DETERMINATION, err)), err);
     if (!resp || resp->empty()) {
+        // Тип не определили — отвечаем как на нестандартный запрос
         if (err && !err->empty()) std::cerr << "Request failed: " << *err << '\n';
-        return;
+        return AiRequest(promptBuilder(request, PM::REQUEST_TYPE::UNKNOWN, err));
     }
     std::string key = *resp;
     auto it = inner_converter_.find(key);
     const auto type = (it != inner_converter_.end()) ? it->second : PM::REQUEST_TYPE::UNKNOWN;
     if (shouldCompress(type)) compressHistory(err);
     last_type_ = type;
-    promptBuilder(request, type, err);
+    return AiRequest(promptBuilder(request, type, err));
 }
 
 void PM::userIntroduction(std::string *err)
@@ -81,7 +68,7 @@ std::string PM::getUserRequest(std::string *err)
     return "";
 }
 
-std::string PM::promptBuilder(const std::string& request, PM::REQUEST_TYPE type,  std::string *err)
+std::string PM::promptBuilder(const std::string& request, PM::REQUEST_TYPE type,  std::string *err) const
 {
     std::stringstream ss;
     if ((type != PM::REQUEST_TYPE::REQUEST_TYPE_DETERMINATION) &&
@@ -198,32 +185,37 @@ std::string PM::promptBuilder(const std::string& request, PM::REQUEST_TYPE type,
         }
         default: break;
     }
-    prompt_ = ss.str();
-    return prompt_;
+    return ss.str();
 }
 
 void PM::saveSession()
 {
-    if (!cfg_.history_path) return;
-    const std::string full_path = *cfg_.history_path + "/" + username_ + ".json";
-    std::ofstream histfile(full_path, std::ios::trunc);
-    if (!histfile) {
-        std::cerr << "Failed to open history file: " << full_path << '\n';
-        return;
+    if (!journal_) return;
+    // Перед выходом сворачиваем журнал в снимок, чтобы следующий вход не переигрывал его
+    std::string err;
+    if (journal_->hasPendingRecords() && !journal_->snapshot(history_, &err)) {
+        std::cerr << "Failed to save history: " << err << '\n';
     }
-    histfile << history_.dump(4);
+    journal_->sync();
 }
 
 void PM::saveHistory(const std::optional<std::string>& answer, const std::string &request)
 {
     history_["requests"].push_back({request, answer.value_or("")});
+    if (journal_) {
+        std::string err;
+        if (!journal_->appendRequest(request, answer.value_or(""), &err)) {
+            std::cerr << "Failed to save history: " << err << '\n';
+        } else if (journal_->needsSnapshot() && !journal_->snapshot(history_, &err)) {
+            std::cerr << "Failed to save history snapshot: " << err << '\n';
+        }
+    }
     if (shouldCompress(std::nullopt)) compressHistory(nullptr);
 }
 
 void PM::compressHistory(std::string *err)
 {
-    promptBuilder(" ", PM::inner_converter_.at("compression"), err);
-    auto resp = ask(err);
+    auto resp = execute(AiRequest(promptBuilder(" ", PM::inner_converter_.at("compression"), err)), err);
     if (!resp || resp->empty()) {
         if (err && !err->empty()) std::cerr << "Request failed: " << *err << '\n';
         return;
@@ -232,7 +224,14 @@ void PM::compressHistory(std::string *err)
     if (compressed_history.size()) {
         history_["context"] = compressed_history;
         history_["requests"] = std::vector<std::vector<std::string>>();
-        saveSession();
+        // После сжатия история маленькая — сразу делаем снимок
+        if (journal_) {
+            std::string journal_err;
+            if (!journal_->appendCompression(compressed_history, &journal_err) ||
+                !journal_->snapshot(history_, &journal_err)) {
+                std::cerr << "Failed to save history: " << journal_err << '\n';
+            }
+        }
     }
 }
 
@@ -2,8 +2,10 @@
 #include <string>
 #include <optional>
 #include <unordered_map>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include "AiAgent.h"
+#include "HistoryJournal.hpp"
 
 using json = nlohmann::json;
 
@@ -22,8 +24,9 @@ const static std::unordered_map<std::string, REQUEST_TYPE> inner_converter_;
 public:
 void printInfo();
 void userIntroduction(std::string *err = nullptr);
-void determineRequestType(const std::string &request, std::string *err  = nullptr);
-std::string promptBuilder(const std::string &request, PM::REQUEST_TYPE type,  std::string *err  = nullptr);
+// Определить тип запроса и собрать по нему запрос к модели
+AiRequest determineRequestType(const std::string &request, std::string *err  = nullptr);
+std::string promptBuilder(const std::string &request, PM::REQUEST_TYPE type,  std::string *err  = nullptr) const;
 std::string getUserRequest(std::string *err  = nullptr);
 void saveSession();
 void saveHistory(const std::optional<std::string> &answer, const std::string &request);
@@ -33,5 +36,6 @@ void compressHistory(std::string *err = nullptr);
 bool shouldCompress(std::optional<PM::REQUEST_TYPE> nextType);
 std::string username_;
 json history_;
+std::unique_ptr<HistoryJournal> journal_;
 std::optional<PM::REQUEST_TYPE> last_type_ = std::nullopt;
 };
\ No newline at end of file
@@ -21,8 +21,8 @@ int main(int argc, char **argv) {
     agent.userIntroduction(&err);
     std::string request = agent.getUserRequest(&err);
     while (request.size()) {
-        agent.determineRequestType(request, &err);
-        auto resp = agent.ask(&err);
+        auto req = agent.determineRequestType(request, &err);
+        auto resp = agent.execute(req, &err);
         if (!resp) {
             std::cerr << "Request failed: " << err << "\n";
             return 2;
@@ -185,8 +185,21 @@ std::optional<std::string> AiAgent::analyzeCodeString(const std::string& code,
         return std::nullopt;
     }
     
-    // Парсим и форматируем ответ
-    auto issues = parseAnalysisResponse(*response);
+    // Парсим и форматируем ответ. Ответ не по формату отправляем на
+    // исправление один раз: это дешевле, чем повторять весь анализ
+    std::vector<CodeIssue> issues;
+    std::string parse_err;
+    if (!parseAnalysisResponse(*response, issues, &parse_err)) {
+        json repair = { {"prompt", createRepairPrompt(*response, parse_err)} };
+        std::string repair_err;
+        auto fixed = httpsPostGenerate(cfg_, repair.dump(), &repair_err);
+        if (!fixed || !parseAnalysisResponse(*fixed, issues)) {
+            CodeIssue issue;
+            issue.type = "info";
+            issue.message = "JSON parsing failed (" + parse_err + "): " + *response;
+            issues.assign(1, issue);
+        }
+    }
     return formatAnalysisReport(issues);
 }
 
@@ -214,35 +227,67 @@ std::string AiAgent::createAnalysisPrompt(const std::string& code, const std::st
     return prompt.str();
 }
 
-std::vector<CodeIssue> AiAgent::parseAnalysisResponse(const std::string& response) const {
-    std::vector<CodeIssue> issues;
-    
-    try {
-        // Пытаемся распарсить JSON ответ
-        auto j = json::parse(response);
-        
-        if (j.is_array()) {
-            for (const auto& item : j) {
-                CodeIssue issue;
-                issue.type = item.value("type", "");
-                issue.message = item.value("message", "");
-                issue.line = item.value("line", -1);
-                issue.context = item.value("context", "");
-                
-                if (!issue.type.empty() && !issue.message.empty()) {
-                    issues.push_back(issue);
-                }
-            }
+bool AiAgent::parseAnalysisResponse(const std::string& response, std::vector<CodeIssue>& issues,
+                                    std::string* err) const {
+    // Модель часто оборачивает массив в ```json или добавляет фразу перед ним
+    const size_t open = response.find('[');
+    const size_t close = response.rfind(']');
+    if (open == std::string::npos || close == std::string::npos || close < open) {
+        if (err) *err = "в ответе нет JSON-массива";
+        return false;
+    }
+
+    json j = json::parse(response.begin() + open, response.begin() + close + 1, nullptr, false);
+    if (j.is_discarded()) {
+        if (err) *err = "массив не разбирается как JSON";
+        return false;
+    }
+
+    std::vector<CodeIssue> parsed;
+    for (size_t i = 0; i < j.size(); ++i) {
+        const auto& item = j[i];
+        const std::string where = "элемент " + std::to_string(i);
+        if (!item.is_object()) {
+            if (err) *err = where + ": ожидался объект";
+            return false;
         }
-    } catch (const std::exception& e) {
-        // Если не удалось распарсить JSON
         CodeIssue issue;
-        issue.type = "info";
-        issue.message = "JSON parsing failed" + response;
-        issues.push_back(issue);
+        if (!item.contains("type") || !item["type"].is_string() || !item.contains("message") ||
+            !item["message"].is_string()) {
+            if (err) *err = where + ": нужны строковые поля type и message";
+            return false;
+        }
+        issue.type = item["type"].get<std::string>();
+        issue.message = item["message"].get<std::string>();
+        if (issue.type != "error" && issue.type != "warning" && issue.type != "suggestion") {
+            if (err) *err = where + ": type должен быть error, warning или suggestion";
+            return false;
+        }
+        if (item.contains("line") && !item["line"].is_null()) {
+            if (!item["line"].is_number_integer()) {
+                if (err) *err = where + ": line должен быть целым числом";
+                return false;
+            }
+            issue.line = item["line"].get<int>();
+        }
+        if (item.contains("context") && item["context"].is_string()) {
+            issue.context = item["context"].get<std::string>();
+        }
+        if (!issue.message.empty()) parsed.push_back(std::move(issue));
     }
-    
-    return issues;
+    issues = std::move(parsed);
+    return true;
+}
+
+std::string AiAgent::createRepairPrompt(const std::string& response, const std::string& error) const {
+    std::ostringstream prompt;
+    prompt << "Ответ ниже должен быть JSON-массивом объектов с полями "
+           << "\"type\" (\"error\"|\"warning\"|\"suggestion\"), \"message\" (строка), "
+           << "\"line\" (целое число, если известно), \"context\" (строка, если уместно), "
+           << "но не проходит проверку: " << error << ".\n"
+           << "Исправь только формат, не меняя смысла замечаний. Верни ТОЛЬКО JSON-массив.\n\n"
+           << "Ответ:\n" << response.substr(0, 16 * 1024);
+    return prompt.str();
 }
 
 std::string AiAgent::formatAnalysisReport(const std::vector<CodeIssue>& issues) const {
@@ -56,7 +56,12 @@ private:
 
     std::string createAnalysisPrompt(const std::string& code, const std::string& language) const;
     std::string formatAnalysisReport(const std::vector<CodeIssue>& issues) const;
-    std::vector<CodeIssue> parseAnalysisResponse(const std::string& response) const;
+    // Разбор и проверка JSON-массива замечаний (текст вокруг и ```json
+    // допускаются). false — ответ не по формату, причина в err
+    bool parseAnalysisResponse(const std::string& response, std::vector<CodeIssue>& issues,
+                               std::string* err = nullptr) const;
+    // Просьба исправить формат ответа, не прошедшего проверку (код не повторяется)
+    std::string createRepairPrompt(const std::string& response, const std::string& error) const;
 
 private:
     AiConfig cfg_;